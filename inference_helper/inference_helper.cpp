@@ -23,10 +23,17 @@ limitations under the License.
 #include <array>
 #include <algorithm>
 #include <chrono>
+#include <map>
+#include <mutex>
+#include <fstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /* for My modules */
 #include "inference_helper_log.h"
 #include "inference_helper.h"
+#include "inference_helper_kernel.h"
 
 #ifdef INFERENCE_HELPER_ENABLE_OPENCV
 #include "inference_helper_opencv.h"
@@ -209,12 +216,47 @@ InferenceHelper* InferenceHelper::Create(const InferenceHelper::HelperType helpe
     return p;
 }
 
+std::shared_ptr<const std::vector<char>> InferenceHelper::LoadModelBuffer(const std::string& model_filename)
+{
+    static std::mutex s_mutex;
+    static std::map<std::string, std::weak_ptr<const std::vector<char>>> s_model_buffer_map;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto model_buffer = s_model_buffer_map[model_filename].lock();
+    if (model_buffer) {
+        return model_buffer;
+    }
+
+    std::ifstream ifs(model_filename, std::ios::binary | std::ios::ate);
+    if (!ifs) {
+        PRINT_E("Failed to read model (%s)\n", model_filename.c_str());
+        return nullptr;
+    }
+    const std::streamoff size = ifs.tellg();
+    if (size < 0) {
+        PRINT_E("Failed to get model size (%s)\n", model_filename.c_str());
+        return nullptr;
+    }
+    std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>(static_cast<size_t>(size));
+    ifs.seekg(0);
+    if (!ifs.read(buffer->data(), buffer->size())) {
+        PRINT_E("Failed to read model (%s)\n", model_filename.c_str());
+        return nullptr;
+    }
+    s_model_buffer_map[model_filename] = buffer;
+    return buffer;
+}
+
+static void ConvertNormalizeParameters(const InputTensorInfo& input_tensor_info, float* mean, float* norm);
+static void CalculateImageTransform(int32_t dst_width, int32_t dst_height, const InputTensorInfo::ImageInfo& image_info, InputTensorInfo::ImageTransform& image_transform);
+
 #ifdef INFERENCE_HELPER_ENABLE_PRE_PROCESS_BY_OPENCV
 #include <opencv2/opencv.hpp>
 void InferenceHelper::PreProcessByOpenCV(const InputTensorInfo& input_tensor_info, bool is_nchw, cv::Mat& img_blob)
 {
     /* Generate mat from original data */
-    cv::Mat img_src = cv::Mat(cv::Size(input_tensor_info.image_info.width, input_tensor_info.image_info.height), (input_tensor_info.image_info.channel == 3) ? CV_8UC3 : CV_8UC1, input_tensor_info.data);
+    const size_t step = (input_tensor_info.image_info.stride > 0) ? input_tensor_info.image_info.stride : cv::Mat::AUTO_STEP;
+    cv::Mat img_src = cv::Mat(cv::Size(input_tensor_info.image_info.width, input_tensor_info.image_info.height), (input_tensor_info.image_info.channel == 3) ? CV_8UC3 : CV_8UC1, input_tensor_info.data, step);
 
     /* Crop image */
     if (input_tensor_info.image_info.width == input_tensor_info.image_info.crop_width && input_tensor_info.image_info.height == input_tensor_info.image_info.crop_height) {
@@ -224,10 +266,18 @@ void InferenceHelper::PreProcessByOpenCV(const InputTensorInfo& input_tensor_inf
     }
 
     /* Resize image */
-    if (input_tensor_info.image_info.crop_width == input_tensor_info.GetWidth() && input_tensor_info.image_info.crop_height == input_tensor_info.GetHeight()) {
+    CalculateImageTransform(input_tensor_info.GetWidth(), input_tensor_info.GetHeight(), input_tensor_info.image_info, input_tensor_info.image_transform);
+    const auto& image_transform = input_tensor_info.image_transform;
+    if (input_tensor_info.image_info.crop_width == image_transform.width && input_tensor_info.image_info.crop_height == image_transform.height) {
         /* do nothing */
     } else {
-        cv::resize(img_src, img_src, cv::Size(input_tensor_info.GetWidth(), input_tensor_info.GetHeight()));
+        cv::resize(img_src, img_src, cv::Size(image_transform.width, image_transform.height));
+    }
+
+    /* Letterbox */
+    if (image_transform.width != input_tensor_info.GetWidth() || image_transform.height != input_tensor_info.GetHeight()) {
+        cv::copyMakeBorder(img_src, img_src, image_transform.offset_y, input_tensor_info.GetHeight() - image_transform.offset_y - image_transform.height,
+            image_transform.offset_x, input_tensor_info.GetWidth() - image_transform.offset_x - image_transform.width, cv::BORDER_CONSTANT, cv::Scalar::all(input_tensor_info.image_info.letterbox_pad));
     }
 
     /* Convert color type */
@@ -243,11 +293,14 @@ void InferenceHelper::PreProcessByOpenCV(const InputTensorInfo& input_tensor_inf
 
     if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
         /* Normalize image */
+        float mean[4];
+        float norm[4];
+        ConvertNormalizeParameters(input_tensor_info, mean, norm);
         if (input_tensor_info.GetChannel() == 3) {
 #if 1
             img_src.convertTo(img_src, CV_32FC3);
-            cv::subtract(img_src, cv::Scalar(cv::Vec<float, 3>(input_tensor_info.normalize.mean)), img_src);
-            cv::multiply(img_src, cv::Scalar(cv::Vec<float, 3>(input_tensor_info.normalize.norm)), img_src);
+            cv::subtract(img_src, cv::Scalar(cv::Vec<float, 3>(mean)), img_src);
+            cv::multiply(img_src, cv::Scalar(cv::Vec<float, 3>(norm)), img_src);
 #else
             img_src.convertTo(img_src, CV_32FC3, 1.0 / 255);
             cv::subtract(img_src, cv::Scalar(cv::Vec<float, 3>(input_tensor_info.normalize.mean)), img_src);
@@ -256,8 +309,8 @@ void InferenceHelper::PreProcessByOpenCV(const InputTensorInfo& input_tensor_inf
         } else {
 #if 1
             img_src.convertTo(img_src, CV_32FC1);
-            cv::subtract(img_src, cv::Scalar(cv::Vec<float, 1>(input_tensor_info.normalize.mean)), img_src);
-            cv::multiply(img_src, cv::Scalar(cv::Vec<float, 1>(input_tensor_info.normalize.norm)), img_src);
+            cv::subtract(img_src, cv::Scalar(cv::Vec<float, 1>(mean)), img_src);
+            cv::multiply(img_src, cv::Scalar(cv::Vec<float, 1>(norm)), img_src);
 #else
             img_src.convertTo(img_src, CV_32FC1, 1.0 / 255);
             cv::subtract(img_src, cv::Scalar(cv::Vec<float, 1>(input_tensor_info.normalize.mean)), img_src);
@@ -289,132 +342,1024 @@ void InferenceHelper::PreProcessByOpenCV(const InputTensorInfo& input_tensor_inf
 
 
 
-void InferenceHelper::ConvertNormalizeParameters(InputTensorInfo& tensor_info)
+/* Convert to speeden up normalization:  ((src / 255) - mean) / norm = (src  - (mean * 255))  * (1 / (255 * norm))
+ * mean and norm have 4 elements. The 4th channel (e.g. alpha) uses mean = 0, norm = 1
+ */
+static void ConvertNormalizeParameters(const InputTensorInfo& input_tensor_info, float* mean, float* norm)
 {
-    if (tensor_info.data_type != InputTensorInfo::kDataTypeImage) return;
-
-#if 0
-    /* Convert to speeden up normalization:  ((src / 255) - mean) / norm  = src * 1 / (255 * norm) - (mean / norm) */
     for (int32_t i = 0; i < 3; i++) {
-        tensor_info.normalize.mean[i] /= tensor_info.normalize.norm[i];
-        tensor_info.normalize.norm[i] *= 255.0f;
-        tensor_info.normalize.norm[i] = 1.0f / tensor_info.normalize.norm[i];
+        mean[i] = input_tensor_info.normalize.mean[i] * 255.0f;
+        norm[i] = 1.0f / (input_tensor_info.normalize.norm[i] * 255.0f);
     }
-#endif
-#if 1
-    /* Convert to speeden up normalization:  ((src / 255) - mean) / norm = (src  - (mean * 255))  * (1 / (255 * norm)) */
-    for (int32_t i = 0; i < 3; i++) {
-        tensor_info.normalize.mean[i] *= 255.0f;
-        tensor_info.normalize.norm[i] *= 255.0f;
-        tensor_info.normalize.norm[i] = 1.0f / tensor_info.normalize.norm[i];
+    mean[3] = 0.0f;
+    norm[3] = 1.0f / 255.0f;
+}
+
+/* Create table to normalize and quantize pixel value at once:  q = round(((src - mean) * norm) / scale) + zero_point
+ * The table has 4 channels. The 4th channel uses quantization parameters of the 3rd channel
+ */
+static void CreateQuantTable(const InputTensorInfo& input_tensor_info, PreProcessPlan& plan)
+{
+    plan.quant_table.clear();
+    if (input_tensor_info.is_quantize && (plan.tensor_type == TensorInfo::kTensorTypeUint8 || plan.tensor_type == TensorInfo::kTensorTypeInt8)) {
+        const int32_t q_min = (plan.tensor_type == TensorInfo::kTensorTypeUint8) ? 0 : -128;
+        const int32_t q_max = (plan.tensor_type == TensorInfo::kTensorTypeUint8) ? 255 : 127;
+        for (int32_t c = 0; c < 4; c++) {
+            const float scale = input_tensor_info.quant.scale[(std::min)(c, 2)];
+            const int32_t zero_point = input_tensor_info.quant.zero_point[(std::min)(c, 2)];
+            if (scale <= 0.0f) {
+                PRINT_E("[WARNING] Quantization parameter is not available (%s). Pixel value is used without quantization\n", input_tensor_info.name.c_str());
+                plan.quant_table.clear();
+                return;
+            }
+            for (int32_t i = 0; i < 256; i++) {
+                const float val_float = (i - plan.mean[c]) * plan.norm[c];
+                int32_t val_quant = static_cast<int32_t>(std::round(val_float / scale)) + zero_point;
+                val_quant = (std::max)(q_min, (std::min)(q_max, val_quant));
+                plan.quant_table.push_back(static_cast<uint8_t>(val_quant));
+            }
+        }
     }
-#endif
 }
 
 
-void InferenceHelper::PreProcessImage(int32_t num_thread, const InputTensorInfo& input_tensor_info, float* dst)
+/* Store num pixels (packed, after resize and color conversion) into (x, y) of the tensor
+ * kChannel > 0: channel is fixed at compile time (plan.channel is not used), 0: any channel. kIsNchw is the same as plan.is_nchw
+ */
+template<int32_t kChannel, bool kIsNchw>
+static void StoreImageRow(const PreProcessPlan& plan, const uint8_t* src, int32_t x, int32_t num, int32_t y, float* dst)
 {
-    const int32_t img_width = input_tensor_info.GetWidth();
-    const int32_t img_height = input_tensor_info.GetHeight();
-    const int32_t img_channel = input_tensor_info.GetChannel();
-    uint8_t* src = (uint8_t*)(input_tensor_info.data);
-    if (input_tensor_info.is_nchw == true) {
+    const int32_t width = plan.width;
+    const int32_t height = plan.height;
+    const int32_t channel = (kChannel > 0) ? kChannel : plan.channel;
+    if (kIsNchw) {
         /* convert NHWC to NCHW */
-#pragma omp parallel for num_threads(num_thread)
-        for (int32_t c = 0; c < img_channel; c++) {
-            for (int32_t i = 0; i < img_width * img_height; i++) {
-                dst[c * img_width * img_height + i] = (src[i * img_channel + c] - input_tensor_info.normalize.mean[c]) * input_tensor_info.normalize.norm[c];
-            }
+        float* dst_plane[4];
+        for (int32_t c = 0; c < channel; c++) {
+            dst_plane[c] = dst + c * width * height + y * width + x;
         }
+        InferenceHelperKernel::NormalizePlanar(src, channel, num, plan.mean, plan.norm, dst_plane);
     } else {
         /* convert NHWC to NHWC */
-#pragma omp parallel for num_threads(num_thread)
-        for (int32_t i = 0; i < img_width * img_height; i++) {
-            for (int32_t c = 0; c < img_channel; c++) {
-#if 1
-                dst[i * img_channel + c] = (src[i * img_channel + c] - input_tensor_info.normalize.mean[c]) * input_tensor_info.normalize.norm[c];
-#else
-                dst[i * img_channel + c] = (src[i * img_channel + c] / 255.0f - input_tensor_info.normalize.mean[c]) / input_tensor_info.normalize.norm[c];
-#endif
-            }
+        InferenceHelperKernel::NormalizeInterleaved(src, channel, num, plan.mean, plan.norm, dst + (y * width + x) * channel);
+    }
+}
+
+/* fp16 tensor (uint16_t is the bit pattern) */
+template<int32_t kChannel, bool kIsNchw>
+static void StoreImageRow(const PreProcessPlan& plan, const uint8_t* src, int32_t x, int32_t num, int32_t y, uint16_t* dst)
+{
+    const int32_t width = plan.width;
+    const int32_t height = plan.height;
+    const int32_t channel = (kChannel > 0) ? kChannel : plan.channel;
+    if (kIsNchw) {
+        /* convert NHWC to NCHW */
+        uint16_t* dst_plane[4];
+        for (int32_t c = 0; c < channel; c++) {
+            dst_plane[c] = dst + c * width * height + y * width + x;
         }
+        InferenceHelperKernel::NormalizePlanarFp16(src, channel, num, plan.mean, plan.norm, dst_plane);
+    } else {
+        /* convert NHWC to NHWC */
+        InferenceHelperKernel::NormalizeInterleavedFp16(src, channel, num, plan.mean, plan.norm, dst + (y * width + x) * channel);
     }
 }
 
-void InferenceHelper::PreProcessImage(int32_t num_thread, const InputTensorInfo& input_tensor_info, uint8_t* dst)
+/* uint8 tensor (also used for int8 tensor with quant_table) */
+template<int32_t kChannel, bool kIsNchw>
+static void StoreImageRow(const PreProcessPlan& plan, const uint8_t* src, int32_t x, int32_t num, int32_t y, uint8_t* dst)
 {
-    const int32_t img_width = input_tensor_info.GetWidth();
-    const int32_t img_height = input_tensor_info.GetHeight();
-    const int32_t img_channel = input_tensor_info.GetChannel();
-    uint8_t* src = (uint8_t*)(input_tensor_info.data);
-    if (input_tensor_info.is_nchw == true) {
+    const int32_t width = plan.width;
+    const int32_t height = plan.height;
+    const int32_t channel = (kChannel > 0) ? kChannel : plan.channel;
+    const uint8_t* table = plan.quant_table.empty() ? nullptr : plan.quant_table.data();
+    if (kIsNchw) {
         /* convert NHWC to NCHW */
-#pragma omp parallel for num_threads(num_thread)
-        for (int32_t c = 0; c < img_channel; c++) {
-            for (int32_t i = 0; i < img_width * img_height; i++) {
-                dst[c * img_width * img_height + i] = src[i * img_channel + c];
+        uint8_t* dst_plane[4];
+        for (int32_t c = 0; c < channel; c++) {
+            dst_plane[c] = dst + c * width * height + y * width + x;
+        }
+        if (table) {
+            for (int32_t c = 0; c < channel; c++) {
+                const uint8_t* table_channel = table + c * 256;
+                for (int32_t i = 0; i < num; i++) {
+                    dst_plane[c][i] = table_channel[src[i * channel + c]];
+                }
             }
+        } else {
+            InferenceHelperKernel::Deinterleave(src, channel, num, dst_plane);
         }
     } else {
         /* convert NHWC to NHWC */
-        std::copy(src, src + input_tensor_info.GetElementNum(), dst);
+        uint8_t* dst_row = dst + (y * width + x) * channel;
+        if (table) {
+            for (int32_t i = 0; i < num; i++) {
+                for (int32_t c = 0; c < channel; c++) {
+                    dst_row[i * channel + c] = table[c * 256 + src[i * channel + c]];
+                }
+            }
+        } else {
+            std::copy(src, src + num * channel, dst_row);
+        }
     }
 }
 
-void InferenceHelper::PreProcessImage(int32_t num_thread, const InputTensorInfo& input_tensor_info, int8_t* dst)
+template<int32_t kChannel, bool kIsNchw>
+static void StoreImageRow(const PreProcessPlan& plan, const uint8_t* src, int32_t x, int32_t num, int32_t y, int8_t* dst)
 {
-    const int32_t img_width = input_tensor_info.GetWidth();
-    const int32_t img_height = input_tensor_info.GetHeight();
-    const int32_t img_channel = input_tensor_info.GetChannel();
-    uint8_t* src = (uint8_t*)(input_tensor_info.data);
-    if (input_tensor_info.is_nchw == true) {
+    if (!plan.quant_table.empty()) {
+        /* the table already has int8 value */
+        StoreImageRow<kChannel, kIsNchw>(plan, src, x, num, y, reinterpret_cast<uint8_t*>(dst));
+        return;
+    }
+
+    const int32_t width = plan.width;
+    const int32_t height = plan.height;
+    const int32_t channel = (kChannel > 0) ? kChannel : plan.channel;
+    if (kIsNchw) {
         /* convert NHWC to NCHW */
-#pragma omp parallel for num_threads(num_thread)
-        for (int32_t c = 0; c < img_channel; c++) {
-            for (int32_t i = 0; i < img_width * img_height; i++) {
-                dst[c * img_width * img_height + i] = src[i * img_channel + c] - 128;
+        for (int32_t c = 0; c < channel; c++) {
+            int8_t* dst_plane = dst + c * width * height + y * width + x;
+            for (int32_t i = 0; i < num; i++) {
+                dst_plane[i] = src[i * channel + c] - 128;
             }
         }
     } else {
-#pragma omp parallel for num_threads(num_thread)
-        for (int32_t i = 0; i < img_width * img_height; i++) {
-            for (int32_t c = 0; c < img_channel; c++) {
-                dst[i * img_channel + c] = src[i * img_channel + c] - 128;
+        /* convert NHWC to NHWC */
+        int8_t* dst_row = dst + (y * width + x) * channel;
+        for (int32_t i = 0; i < num * channel; i++) {
+            dst_row[i] = src[i] - 128;
+        }
+    }
+}
+
+/* Decide where the crop area is stored in the tensor */
+static void CalculateImageTransform(int32_t dst_width, int32_t dst_height, const InputTensorInfo::ImageInfo& image_info, InputTensorInfo::ImageTransform& image_transform)
+{
+    if (image_info.letterbox == InputTensorInfo::kLetterboxNone) {
+        image_transform.width = dst_width;
+        image_transform.height = dst_height;
+    } else {
+        const float scale = (std::min)(static_cast<float>(dst_width) / image_info.crop_width, static_cast<float>(dst_height) / image_info.crop_height);
+        image_transform.width = (std::max)(1, (std::min)(dst_width, static_cast<int32_t>(std::round(image_info.crop_width * scale))));
+        image_transform.height = (std::max)(1, (std::min)(dst_height, static_cast<int32_t>(std::round(image_info.crop_height * scale))));
+    }
+    if (image_info.letterbox == InputTensorInfo::kLetterboxCenter) {
+        image_transform.offset_x = (dst_width - image_transform.width) / 2;
+        image_transform.offset_y = (dst_height - image_transform.height) / 2;
+    } else {
+        image_transform.offset_x = 0;
+        image_transform.offset_y = 0;
+    }
+    image_transform.scale_x = static_cast<float>(image_transform.width) / image_info.crop_width;
+    image_transform.scale_y = static_cast<float>(image_transform.height) / image_info.crop_height;
+}
+
+/* Layout needs to be rebuilt only when these parameters are changed. Data pointers and stride can be changed for each frame */
+static bool IsSameGeometry(const InputTensorInfo::ImageInfo& a, const InputTensorInfo::ImageInfo& b)
+{
+    return (a.width == b.width) && (a.height == b.height) && (a.channel == b.channel)
+        && (a.crop_x == b.crop_x) && (a.crop_y == b.crop_y) && (a.crop_width == b.crop_width) && (a.crop_height == b.crop_height)
+        && (a.is_bgr == b.is_bgr) && (a.swap_color == b.swap_color) && (a.letterbox == b.letterbox) && (a.letterbox_pad == b.letterbox_pad);
+}
+
+/* Check the image and decide color conversion, area in the tensor and resize table. Work buffers are allocated for num_thread threads */
+static int32_t CreateImageLayout(int32_t num_thread, const PreProcessPlan& plan, const InputTensorInfo::ImageInfo& image_info, PreProcessPlan::ImageLayout& layout)
+{
+    const int32_t src_channel = (plan.data_type == InputTensorInfo::kDataTypeImage) ? image_info.channel : 3;
+    const int32_t dst_channel = plan.channel;
+    layout.is_valid = false;
+
+    if ((image_info.crop_x < 0) || (image_info.crop_y < 0) || (image_info.crop_width <= 0) || (image_info.crop_height <= 0)
+        || (image_info.crop_x + image_info.crop_width > image_info.width) || (image_info.crop_y + image_info.crop_height > image_info.height)) {
+        PRINT_E("Invalid crop area (%d, %d, %d, %d)\n", image_info.crop_x, image_info.crop_y, image_info.crop_width, image_info.crop_height);
+        return InferenceHelper::kRetErr;
+    }
+
+    if ((src_channel == 3) && (dst_channel == 3)) {
+        layout.color_conversion = (image_info.swap_color) ? InferenceHelperKernel::kColorConversionSwapRb : InferenceHelperKernel::kColorConversionNone;
+    } else if ((src_channel == 1) && (dst_channel == 1)) {
+        layout.color_conversion = InferenceHelperKernel::kColorConversionNone;
+    } else if ((src_channel == 3) && (dst_channel == 1)) {
+        layout.color_conversion = (image_info.is_bgr && plan.data_type == InputTensorInfo::kDataTypeImage) ? InferenceHelperKernel::kColorConversionBgrToGray : InferenceHelperKernel::kColorConversionRgbToGray;
+    } else if ((src_channel == 1) && (dst_channel == 3)) {
+        layout.color_conversion = InferenceHelperKernel::kColorConversionGrayToRgb;
+    } else if ((src_channel == 4) && (dst_channel == 4) && !image_info.swap_color) {
+        layout.color_conversion = InferenceHelperKernel::kColorConversionNone;
+    } else {
+        PRINT_E("Unsupported color conversion (%d, %d)\n", src_channel, dst_channel);
+        return InferenceHelper::kRetErr;
+    }
+
+    if ((image_info.letterbox != InputTensorInfo::kLetterboxNone) && (image_info.letterbox != InputTensorInfo::kLetterboxCenter) && (image_info.letterbox != InputTensorInfo::kLetterboxTopLeft)) {
+        PRINT_E("Unsupported letterbox mode (%d)\n", image_info.letterbox);
+        return InferenceHelper::kRetErr;
+    }
+
+    /* Area in the tensor to store the image */
+    CalculateImageTransform(plan.width, plan.height, image_info, layout.image_transform);
+    const int32_t area_width = layout.image_transform.width;
+    const int32_t area_height = layout.image_transform.height;
+
+    /* Resize table (x: offset in byte from the left of the crop area, y: row in the crop area) */
+    layout.is_resize = (image_info.crop_width != area_width) || (image_info.crop_height != area_height);
+    if (layout.is_resize) {
+        layout.x_offset0.resize(area_width);
+        layout.x_offset1.resize(area_width);
+        layout.x_weight.resize(area_width);
+        layout.y_offset0.resize(area_height);
+        layout.y_offset1.resize(area_height);
+        layout.y_weight.resize(area_height);
+        InferenceHelperKernel::CalculateResizeTable(image_info.crop_width, area_width, src_channel, layout.x_offset0.data(), layout.x_offset1.data(), layout.x_weight.data());
+        InferenceHelperKernel::CalculateResizeTable(image_info.crop_height, area_height, 1, layout.y_offset0.data(), layout.y_offset1.data(), layout.y_weight.data());
+    }
+
+    /* Padding pixels (one row). Padding is stored in the same way as image pixels, so normalize is also applied */
+    const bool is_padding = (area_width != plan.width) || (area_height != plan.height);
+    layout.pad_row.assign(is_padding ? plan.width * dst_channel : 0, image_info.letterbox_pad);
+
+    /* YUV rows are converted into RGB (3 channels) */
+    const bool is_yuv = (plan.data_type != InputTensorInfo::kDataTypeImage);
+    layout.thread_buffer_list.resize((std::max)(static_cast<int32_t>(layout.thread_buffer_list.size()), (std::max)(num_thread, 1)));
+    for (auto& thread_buffer : layout.thread_buffer_list) {
+        for (int32_t i = 0; i < 2; i++) {
+            thread_buffer.row_cache[i].resize(is_yuv ? image_info.crop_width * 3 : 0);
+        }
+        thread_buffer.resize.resize(layout.is_resize ? area_width * src_channel : 0);
+        thread_buffer.color.resize((layout.color_conversion != InferenceHelperKernel::kColorConversionNone) ? area_width * dst_channel : 0);
+    }
+
+    layout.image_info = image_info;
+    layout.is_valid = true;
+    return InferenceHelper::kRetOk;
+}
+
+/* Rows of the crop area. Packed image is read directly, and YUV image is converted into RGB only for the rows used */
+class ImageSource {
+public:
+    ImageSource(int32_t data_type, const void* data, const InputTensorInfo::ImageInfo& image_info)
+        : data_type_(data_type)
+        , image_info_(image_info)
+        , src_y_(static_cast<const uint8_t*>(data))
+        , src_u_(nullptr)
+        , src_v_(nullptr)
+        , stride_uv_(0)
+        , uv_step_(0)
+    {
+        is_yuv_ = (data_type_ != InputTensorInfo::kDataTypeImage);
+        channel_ = is_yuv_ ? 3 : image_info_.channel;
+        if (is_yuv_) {
+            const int32_t chroma_width = (image_info_.width + 1) / 2;
+            const int32_t chroma_height = (image_info_.height + 1) / 2;
+            stride_ = (image_info_.stride > 0) ? image_info_.stride : image_info_.width;
+            if (data_type_ == InputTensorInfo::kDataTypeImageI420) {
+                stride_uv_ = (image_info_.stride_uv > 0) ? image_info_.stride_uv : chroma_width;
+                uv_step_ = 1;
+            } else {
+                stride_uv_ = (image_info_.stride_uv > 0) ? image_info_.stride_uv : chroma_width * 2;
+                uv_step_ = 2;
             }
+            src_u_ = image_info_.data_u ? static_cast<const uint8_t*>(image_info_.data_u) : src_y_ + stride_ * image_info_.height;
+            src_v_ = image_info_.data_v ? static_cast<const uint8_t*>(image_info_.data_v) : src_u_ + stride_uv_ * chroma_height;
+            if (data_type_ == InputTensorInfo::kDataTypeImageNv12) {
+                src_v_ = src_u_ + 1;
+            } else if (data_type_ == InputTensorInfo::kDataTypeImageNv21) {
+                src_v_ = src_u_;
+                src_u_ = src_u_ + 1;
+            }
+        } else {
+            stride_ = (image_info_.stride > 0) ? image_info_.stride : image_info_.width * channel_;
+        }
+    }
+
+    int32_t GetChannel() const { return channel_; }
+
+    void InitializeCache(PreProcessPlan::ThreadBuffer& cache) const
+    {
+        cache.row_cache_row[0] = -1;
+        cache.row_cache_row[1] = -1;
+    }
+
+    /* Get the top of the row (row is the position in the crop area). The row in cache for keep_row is not overwritten */
+    const uint8_t* GetRow(int32_t row, int32_t keep_row, PreProcessPlan::ThreadBuffer& cache) const
+    {
+        const int32_t y = image_info_.crop_y + row;
+        if (!is_yuv_) {
+            return src_y_ + y * stride_ + image_info_.crop_x * channel_;
+        }
+        for (int32_t i = 0; i < 2; i++) {
+            if (cache.row_cache_row[i] == row) return cache.row_cache[i].data();
+        }
+        const int32_t i = (cache.row_cache_row[0] == keep_row) ? 1 : 0;
+        const int32_t uv_offset = (y / 2) * stride_uv_;
+        InferenceHelperKernel::ConvertYuv420ToRgb(src_y_ + y * stride_, src_u_ + uv_offset, src_v_ + uv_offset, uv_step_, image_info_.crop_x, image_info_.crop_width, cache.row_cache[i].data());
+        cache.row_cache_row[i] = row;
+        return cache.row_cache[i].data();
+    }
+
+private:
+    int32_t data_type_;
+    const InputTensorInfo::ImageInfo& image_info_;
+    bool is_yuv_;
+    int32_t channel_;
+    const uint8_t* src_y_;
+    const uint8_t* src_u_;
+    const uint8_t* src_v_;
+    int32_t stride_;
+    int32_t stride_uv_;
+    int32_t uv_step_;
+};
+
+/* Crop -> Resize (bilinear) -> Color conversion -> Normalize -> NCHW/NHWC in one pass for one batch slot. Each row is processed in a small buffer, so no full size intermediate image is created
+ * In letterbox mode, only the padding area (border rows and columns) is filled with letterbox_pad
+ */
+template<typename T, int32_t kChannel, bool kIsNchw>
+static int32_t PreProcessImageSlot(int32_t num_thread, const PreProcessPlan& plan, const void* data, const InputTensorInfo::ImageInfo& image_info, PreProcessPlan::ImageLayout& layout, InputTensorInfo::ImageTransform& image_transform, T* dst)
+{
+    if (!layout.is_valid || !IsSameGeometry(layout.image_info, image_info) || static_cast<int32_t>(layout.thread_buffer_list.size()) < num_thread) {
+        if (CreateImageLayout(num_thread, plan, image_info, layout) != InferenceHelper::kRetOk) {
+            return InferenceHelper::kRetErr;
+        }
+    }
+    image_transform = layout.image_transform;
+
+    const int32_t dst_width = plan.width;
+    const int32_t dst_height = plan.height;
+    const ImageSource image_source(plan.data_type, data, image_info);
+    const int32_t src_channel = image_source.GetChannel();
+    std::vector<PreProcessPlan::ThreadBuffer>& thread_buffer_list = layout.thread_buffer_list;
+    const int32_t area_x = layout.image_transform.offset_x;
+    const int32_t area_y = layout.image_transform.offset_y;
+    const int32_t area_width = layout.image_transform.width;
+    const int32_t area_height = layout.image_transform.height;
+    const bool is_resize = layout.is_resize;
+    const int32_t color_conversion = layout.color_conversion;
+
+#pragma omp parallel num_threads(num_thread)
+    {
+#ifdef _OPENMP
+        PreProcessPlan::ThreadBuffer& thread_buffer = thread_buffer_list[omp_get_thread_num()];
+#else
+        PreProcessPlan::ThreadBuffer& thread_buffer = thread_buffer_list[0];
+#endif
+        image_source.InitializeCache(thread_buffer);
+#pragma omp for
+        for (int32_t y = 0; y < dst_height; y++) {
+            const int32_t area_row = y - area_y;
+            if ((area_row < 0) || (area_row >= area_height)) {
+                StoreImageRow<kChannel, kIsNchw>(plan, layout.pad_row.data(), 0, dst_width, y, dst);
+                continue;
+            }
+            const uint8_t* row;
+            if (is_resize) {
+                const uint8_t* src_row0 = image_source.GetRow(layout.y_offset0[area_row], layout.y_offset1[area_row], thread_buffer);
+                const uint8_t* src_row1 = image_source.GetRow(layout.y_offset1[area_row], layout.y_offset0[area_row], thread_buffer);
+                InferenceHelperKernel::ResizeBilinearRow(src_row0, src_row1, src_channel, area_width, layout.x_offset0.data(), layout.x_offset1.data(), layout.x_weight.data(), layout.y_weight[area_row], thread_buffer.resize.data());
+                row = thread_buffer.resize.data();
+            } else {
+                row = image_source.GetRow(area_row, area_row, thread_buffer);
+            }
+            if (color_conversion != InferenceHelperKernel::kColorConversionNone) {
+                InferenceHelperKernel::ConvertColor(row, color_conversion, area_width, thread_buffer.color.data());
+                row = thread_buffer.color.data();
+            }
+            StoreImageRow<kChannel, kIsNchw>(plan, row, area_x, area_width, y, dst);
+            if (area_x > 0) {
+                StoreImageRow<kChannel, kIsNchw>(plan, layout.pad_row.data(), 0, area_x, y, dst);
+            }
+            if (area_x + area_width < dst_width) {
+                StoreImageRow<kChannel, kIsNchw>(plan, layout.pad_row.data(), area_x + area_width, dst_width - area_x - area_width, y, dst);
+            }
+        }
+    }
+    return InferenceHelper::kRetOk;
+}
+
+/* Fill each batch slot of the tensor (N x C x H x W or N x H x W x C) with image */
+template<typename T, int32_t kChannel, bool kIsNchw>
+static int32_t PreProcessImage(int32_t num_thread, const InputTensorInfo& input_tensor_info, PreProcessPlan& plan, void* dst_tensor)
+{
+    T* dst = static_cast<T*>(dst_tensor);
+    if (input_tensor_info.batch_list.empty()) {
+        return PreProcessImageSlot<T, kChannel, kIsNchw>(num_thread, plan, input_tensor_info.data, input_tensor_info.image_info, plan.image_layout_list[0], input_tensor_info.image_transform, dst);
+    }
+
+    if (static_cast<int32_t>(input_tensor_info.batch_list.size()) > plan.batch) {
+        PRINT_E("Too many images for batch (%d > %d)\n", static_cast<int32_t>(input_tensor_info.batch_list.size()), plan.batch);
+        return InferenceHelper::kRetErr;
+    }
+    for (size_t i = 0; i < input_tensor_info.batch_list.size(); i++) {
+        const auto& batch_data = input_tensor_info.batch_list[i];
+        if (PreProcessImageSlot<T, kChannel, kIsNchw>(num_thread, plan, batch_data.data, batch_data.image_info, plan.image_layout_list[i], batch_data.image_transform, dst + i * plan.element_num_per_batch) != InferenceHelper::kRetOk) {
+            return InferenceHelper::kRetErr;
         }
     }
+    return InferenceHelper::kRetOk;
 }
 
+/* Transpose (rows x cols -> cols x rows) block by block, so that both read and write stay in cache. Blocks are processed in parallel */
 template<typename T>
-void InferenceHelper::PreProcessBlob(int32_t num_thread, const InputTensorInfo& input_tensor_info, T* dst)
-{
-    const int32_t img_width = input_tensor_info.GetWidth();
-    const int32_t img_height = input_tensor_info.GetHeight();
-    const int32_t img_channel = input_tensor_info.GetChannel();
-    T* src = static_cast<T*>(input_tensor_info.data);
-    if ((input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw && input_tensor_info.is_nchw) || (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc && !input_tensor_info.is_nchw)) {
-        std::copy(src, src + input_tensor_info.GetElementNum(), dst);
-    } else if (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw) {
-        /* NCHW -> NHWC */
+static void TransposeParallel(int32_t num_thread, const T* src, int32_t rows, int32_t cols, T* dst)
+{
+#ifndef _OPENMP
+    (void)num_thread;
+#endif
+    /* Square block in general. When one side is short (e.g. channel = 3), the other side becomes long to keep the block size */
+    static constexpr int32_t kBlockSize = 64;
+    static constexpr int32_t kBlockElementNum = kBlockSize * kBlockSize;
+    int32_t block_rows = (std::min)(rows, kBlockSize);
+    int32_t block_cols = (std::min)(cols, kBlockSize);
+    if (block_rows < kBlockSize) {
+        block_cols = (std::min)(cols, (kBlockElementNum / block_rows) & ~15);
+    } else if (block_cols < kBlockSize) {
+        block_rows = (std::min)(rows, (kBlockElementNum / block_cols) & ~15);
+    }
+    if (block_rows <= 0 || block_cols <= 0) return;
+
+    const int32_t block_num_x = (cols + block_cols - 1) / block_cols;
+    const int32_t block_num_y = (rows + block_rows - 1) / block_rows;
 #pragma omp parallel for num_threads(num_thread)
-        for (int32_t i = 0; i < img_width * img_height; i++) {
-            for (int32_t c = 0; c < img_channel; c++) {
-                dst[i * img_channel + c] = src[c * (img_width * img_height) + i];
-            }
+    for (int32_t b = 0; b < block_num_x * block_num_y; b++) {
+        const int32_t row = (b / block_num_x) * block_rows;
+        const int32_t col = (b % block_num_x) * block_cols;
+        InferenceHelperKernel::TransposeBlock(src + row * cols + col, cols, (std::min)(block_rows, rows - row), (std::min)(block_cols, cols - col), sizeof(T), dst + col * rows + row, rows);
+    }
+}
+
+/* Copy one batch slot with NCHW <-> NHWC conversion */
+template<typename T>
+static void PreProcessBlobSlot(int32_t num_thread, const PreProcessPlan& plan, const T* src, T* dst)
+{
+    if ((plan.data_type == InputTensorInfo::kDataTypeBlobNchw && plan.is_nchw) || (plan.data_type == InputTensorInfo::kDataTypeBlobNhwc && !plan.is_nchw)) {
+        std::copy(src, src + plan.element_num_per_batch, dst);
+    } else if (plan.data_type == InputTensorInfo::kDataTypeBlobNchw) {
+        /* NCHW -> NHWC (C x HW -> HW x C) */
+        TransposeParallel(num_thread, src, plan.channel, plan.width * plan.height, dst);
+    } else {
+        /* NHWC -> NCHW (HW x C -> C x HW) */
+        TransposeParallel(num_thread, src, plan.width * plan.height, plan.channel, dst);
+    }
+}
+
+/* Copy blob for all batch slots */
+template<typename T>
+static int32_t PreProcessBlob(int32_t num_thread, const InputTensorInfo& input_tensor_info, PreProcessPlan& plan, void* dst_tensor)
+{
+    T* dst = static_cast<T*>(dst_tensor);
+    if (!input_tensor_info.batch_list.empty()) {
+        /* Each blob in batch_list is one batch slot */
+        const int32_t batch_num = (std::min)(static_cast<int32_t>(input_tensor_info.batch_list.size()), plan.batch);
+        for (int32_t i = 0; i < batch_num; i++) {
+            PreProcessBlobSlot(num_thread, plan, static_cast<const T*>(input_tensor_info.batch_list[i].data), dst + i * plan.element_num_per_batch);
         }
-    } else if (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) {
-        /* NHWC -> NCHW */
-#pragma omp parallel for num_threads(num_thread)
-        for (int32_t i = 0; i < img_width * img_height; i++) {
-            for (int32_t c = 0; c < img_channel; c++) {
-                dst[c * (img_width * img_height) + i] = src[i * img_channel + c];
+    } else {
+        /* data has all batch slots */
+        const T* src = static_cast<const T*>(input_tensor_info.data);
+        for (int32_t i = 0; i < plan.batch; i++) {
+            PreProcessBlobSlot(num_thread, plan, src + i * plan.element_num_per_batch, dst + i * plan.element_num_per_batch);
+        }
+    }
+    return InferenceHelper::kRetOk;
+}
+
+/* Specialized by channel (1, 3, 4) and layout for the common tensors. Other channels use the generic one */
+template<typename T>
+static PreProcessPlan::Function SelectPreProcessImage(int32_t channel, bool is_nchw)
+{
+    switch (channel) {
+    case 1:
+        return is_nchw ? PreProcessImage<T, 1, true> : PreProcessImage<T, 1, false>;
+    case 3:
+        return is_nchw ? PreProcessImage<T, 3, true> : PreProcessImage<T, 3, false>;
+    case 4:
+        return is_nchw ? PreProcessImage<T, 4, true> : PreProcessImage<T, 4, false>;
+    default:
+        return is_nchw ? PreProcessImage<T, 0, true> : PreProcessImage<T, 0, false>;
+    }
+}
+
+static int32_t PreProcessUnsupported(int32_t, const InputTensorInfo&, PreProcessPlan& plan, void*)
+{
+    PRINT_E("Unsupported data_type (%d) or tensor_type (%d)\n", plan.data_type, plan.tensor_type);
+    return InferenceHelper::kRetErr;
+}
+
+/* Resolve everything which doesn't depend on each frame */
+static void CompilePreProcessPlan(const InputTensorInfo& input_tensor_info, void* dst, PreProcessPlan& plan)
+{
+    plan = PreProcessPlan();
+    plan.dst = dst;
+    plan.data_type = input_tensor_info.data_type;
+    plan.tensor_type = input_tensor_info.tensor_type;
+    plan.is_nchw = input_tensor_info.is_nchw;
+    plan.batch = (std::max)(1, input_tensor_info.GetBatch());
+    plan.width = input_tensor_info.GetWidth();
+    plan.height = input_tensor_info.GetHeight();
+    plan.channel = input_tensor_info.GetChannel();
+    plan.element_num_per_batch = input_tensor_info.GetElementNum() / plan.batch;
+    plan.tensor_dims = input_tensor_info.tensor_dims;
+
+    plan.function = PreProcessUnsupported;
+    if (input_tensor_info.IsImage()) {
+        ConvertNormalizeParameters(input_tensor_info, plan.mean, plan.norm);
+        CreateQuantTable(input_tensor_info, plan);
+        plan.image_layout_list.resize(plan.batch);
+        switch (plan.tensor_type) {
+        case TensorInfo::kTensorTypeFp32:
+            plan.function = SelectPreProcessImage<float>(plan.channel, plan.is_nchw);
+            break;
+        case TensorInfo::kTensorTypeUint8:
+            plan.function = SelectPreProcessImage<uint8_t>(plan.channel, plan.is_nchw);
+            break;
+        case TensorInfo::kTensorTypeInt8:
+            plan.function = SelectPreProcessImage<int8_t>(plan.channel, plan.is_nchw);
+            break;
+        case TensorInfo::kTensorTypeFp16:
+            plan.function = SelectPreProcessImage<uint16_t>(plan.channel, plan.is_nchw);
+            break;
+        default:
+            break;
+        }
+    } else if ((input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) || (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw)) {
+        switch (plan.tensor_type) {
+        case TensorInfo::kTensorTypeFp32:
+            plan.function = PreProcessBlob<float>;
+            break;
+        case TensorInfo::kTensorTypeUint8:
+        case TensorInfo::kTensorTypeInt8:
+            plan.function = PreProcessBlob<uint8_t>;
+            break;
+        case TensorInfo::kTensorTypeFp16:
+        case TensorInfo::kTensorTypeBf16:
+            /* Blob is in the same type as the tensor (copied as bit pattern) */
+            plan.function = PreProcessBlob<uint16_t>;
+            break;
+        case TensorInfo::kTensorTypeInt32:
+            plan.function = PreProcessBlob<int32_t>;
+            break;
+        case TensorInfo::kTensorTypeInt64:
+            plan.function = PreProcessBlob<int64_t>;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void InferenceHelper::CreatePreProcessPlan(const InputTensorInfo& input_tensor_info, void* dst)
+{
+    PreProcessPlan plan;
+    CompilePreProcessPlan(input_tensor_info, dst, plan);
+    pre_process_plan_list_.push_back(plan);
+    ResizeStagingBuffer();
+}
+
+/* Bytes written by the plan function (the tensor size at Initialize) */
+static size_t GetPlanByteSize(const PreProcessPlan& plan)
+{
+    return static_cast<size_t>(plan.element_num_per_batch) * plan.batch * TensorInfo::GetElementSize(plan.tensor_type);
+}
+
+void InferenceHelper::ResizeStagingBuffer(void)
+{
+    for (auto& staging_list : staging_list_) {
+        staging_list.resize(pre_process_plan_list_.size());
+        for (size_t i = 0; i < pre_process_plan_list_.size(); i++) {
+            const auto& plan = pre_process_plan_list_[i];
+            staging_list[i].dst = plan.dst;
+            staging_list[i].buffer.resize(GetPlanByteSize(plan));
+        }
+    }
+}
+
+int32_t InferenceHelper::RunPreProcessPlan(int32_t num_thread, const std::vector<InputTensorInfo>& input_tensor_info_list)
+{
+    if (input_tensor_info_list.size() != pre_process_plan_list_.size()) {
+        PRINT_E("The number of input tensors is different from Initialize (%zu != %zu)\n", input_tensor_info_list.size(), pre_process_plan_list_.size());
+        return kRetErr;
+    }
+    for (size_t i = 0; i < input_tensor_info_list.size(); i++) {
+        const auto& input_tensor_info = input_tensor_info_list[i];
+        auto& plan = pre_process_plan_list_[i];
+        if (!input_tensor_info.tensor_dims.empty() && input_tensor_info.tensor_dims != plan.tensor_dims) {
+            /* The tensor buffer is allocated for the dims at Initialize */
+            PRINT_E("Tensor dims are different from Initialize (%s)\n", input_tensor_info.name.c_str());
+            return kRetErr;
+        }
+        if (plan.data_type != input_tensor_info.data_type) {
+            /* The caller changed data type (e.g. image -> blob). Compile again for the new type with the tensor of Initialize (image geometry is handled by the layout) */
+            InputTensorInfo plan_tensor_info = input_tensor_info;
+            plan_tensor_info.tensor_type = plan.tensor_type;
+            plan_tensor_info.is_nchw = plan.is_nchw;
+            plan_tensor_info.tensor_dims = plan.tensor_dims;
+            CompilePreProcessPlan(plan_tensor_info, plan.dst, plan);
+        }
+        if (plan.dst == nullptr) {
+            PRINT_E("Tensor buffer is not set (%s)\n", input_tensor_info.name.c_str());
+            return kRetErr;
+        }
+        void* dst = plan.dst;
+        if (pre_process_slot_ >= 0) {
+            /* Called from PreProcessToSlot. The input tensor is not touched until CommitPreProcess */
+            auto& staging = staging_list_[pre_process_slot_][i];
+            staging.dst = plan.dst;
+            dst = staging.buffer.data();
+        }
+        if (plan.function(num_thread, input_tensor_info, plan, dst) != kRetOk) {
+            return kRetErr;
+        }
+    }
+    return kRetOk;
+}
+
+int32_t InferenceHelper::SetPreProcessSlotNum(int32_t slot_num)
+{
+    if (slot_num < 1) {
+        PRINT_E("Invalid slot num (%d)\n", slot_num);
+        return kRetErr;
+    }
+    staging_list_.resize(slot_num);
+    ResizeStagingBuffer();
+    return kRetOk;
+}
+
+int32_t InferenceHelper::PreProcessToSlot(int32_t slot, const std::vector<InputTensorInfo>& input_tensor_info_list)
+{
+    if (slot < 0 || slot >= GetPreProcessSlotNum()) {
+        PRINT_E("Invalid slot (%d)\n", slot);
+        return kRetErr;
+    }
+    if (!is_pre_process_stageable_) {
+        /* PreProcess runs at CommitPreProcess */
+        return kRetOk;
+    }
+    pre_process_slot_ = slot;
+    const int32_t ret = PreProcess(input_tensor_info_list);
+    pre_process_slot_ = -1;
+    return ret;
+}
+
+int32_t InferenceHelper::CommitPreProcess(int32_t slot, const std::vector<InputTensorInfo>& input_tensor_info_list)
+{
+    if (slot < 0 || slot >= GetPreProcessSlotNum()) {
+        PRINT_E("Invalid slot (%d)\n", slot);
+        return kRetErr;
+    }
+    if (!is_pre_process_stageable_) {
+        return PreProcess(input_tensor_info_list);
+    }
+    for (size_t i = 0; i < staging_list_[slot].size(); i++) {
+        const auto& staging = staging_list_[slot][i];
+        std::memcpy(staging.dst, staging.buffer.data(), GetPlanByteSize(pre_process_plan_list_[i]));
+    }
+    return kRetOk;
+}
+
+void InferenceHelper::IncrementOutputGeneration(std::vector<OutputTensorInfo>& output_tensor_info_list)
+{
+    for (auto& output_tensor_info : output_tensor_info_list) {
+        output_tensor_info.generation++;
+    }
+}
+
+int32_t InferenceHelper::ConvertOutputLayout(int32_t num_thread, bool is_model_nchw, std::vector<OutputTensorInfo>& output_tensor_info_list)
+{
+    for (int32_t i = 0; i < static_cast<int32_t>(output_tensor_info_list.size()); i++) {
+        if (ConvertOutputLayout(num_thread, is_model_nchw, i, output_tensor_info_list[i]) != kRetOk) {
+            return kRetErr;
+        }
+    }
+    return kRetOk;
+}
+
+int32_t InferenceHelper::ConvertOutputLayout(int32_t num_thread, bool is_model_nchw, int32_t index, OutputTensorInfo& output_tensor_info)
+{
+    if (index >= static_cast<int32_t>(output_layout_list_.size())) {
+        output_layout_list_.resize(index + 1);
+    }
+    auto& layout = output_layout_list_[index];
+
+    /* Restore the model output if the framework left the converted one of the previous frame (e.g. data and dims are set only at Initialize) */
+    if (layout.is_converted) {
+        if (output_tensor_info.data == layout.buffer.data()) output_tensor_info.data = layout.model_data;
+        if (output_tensor_info.tensor_dims == layout.converted_dims) output_tensor_info.tensor_dims = layout.model_dims;
+        output_tensor_info.quant.axis = layout.model_quant_axis;
+        layout.is_converted = false;
+    }
+
+    if (!output_tensor_info.convert_layout || output_tensor_info.is_nchw == is_model_nchw
+        || output_tensor_info.tensor_dims.size() != 4 || output_tensor_info.data == nullptr) {
+        return kRetOk;
+    }
+
+    const int32_t element_size = TensorInfo::GetElementSize(output_tensor_info.tensor_type);
+    if (element_size != 1 && element_size != 2 && element_size != 4 && element_size != 8) {
+        PRINT_E("Unsupported tensor type for layout conversion (%s)\n", output_tensor_info.name.c_str());
+        return kRetErr;
+    }
+
+    /* Each batch is seen as rows x cols and transposed. NCHW -> NHWC: C x HW -> HW x C, NHWC -> NCHW: HW x C -> C x HW */
+    const auto& dims = output_tensor_info.tensor_dims;
+    const int32_t batch = dims[0];
+    TensorDims converted_dims;
+    int32_t rows;
+    int32_t cols;
+    int32_t axis_table[4];
+    if (is_model_nchw) {
+        converted_dims = { dims[0], dims[2], dims[3], dims[1] };
+        rows = dims[1];
+        cols = dims[2] * dims[3];
+        axis_table[0] = 0; axis_table[1] = 3; axis_table[2] = 1; axis_table[3] = 2;
+    } else {
+        converted_dims = { dims[0], dims[3], dims[1], dims[2] };
+        rows = dims[1] * dims[2];
+        cols = dims[3];
+        axis_table[0] = 0; axis_table[1] = 2; axis_table[2] = 3; axis_table[3] = 1;
+    }
+    const int32_t element_num_per_batch = rows * cols;
+    layout.buffer.resize(static_cast<size_t>(batch) * element_num_per_batch * element_size);
+
+    for (int32_t b = 0; b < batch; b++) {
+        const uint8_t* src = static_cast<const uint8_t*>(output_tensor_info.data) + static_cast<size_t>(b) * element_num_per_batch * element_size;
+        uint8_t* dst = layout.buffer.data() + static_cast<size_t>(b) * element_num_per_batch * element_size;
+        switch (element_size) {
+        case 1:
+            TransposeParallel(num_thread, src, rows, cols, dst);
+            break;
+        case 2:
+            TransposeParallel(num_thread, reinterpret_cast<const uint16_t*>(src), rows, cols, reinterpret_cast<uint16_t*>(dst));
+            break;
+        case 4:
+            TransposeParallel(num_thread, reinterpret_cast<const uint32_t*>(src), rows, cols, reinterpret_cast<uint32_t*>(dst));
+            break;
+        default:
+            TransposeParallel(num_thread, reinterpret_cast<const uint64_t*>(src), rows, cols, reinterpret_cast<uint64_t*>(dst));
+            break;
+        }
+    }
+
+    layout.is_converted = true;
+    layout.model_data = output_tensor_info.data;
+    layout.model_dims = output_tensor_info.tensor_dims;
+    layout.model_quant_axis = output_tensor_info.quant.axis;
+    layout.converted_dims = converted_dims;
+    output_tensor_info.data = layout.buffer.data();
+    output_tensor_info.tensor_dims = converted_dims;
+    if (output_tensor_info.quant.axis >= 0 && output_tensor_info.quant.axis < 4) {
+        output_tensor_info.quant.axis = axis_table[output_tensor_info.quant.axis];
+    }
+    return kRetOk;
+}
+
+
+/*** Dequantize output tensor ***/
+/* Elements processed by one thread at a time. Small tensors are processed by one thread without fork/join */
+static constexpr int32_t kDequantizeBlockSize = 16 * 1024;
+
+/* Per axis quantization: the tensor is seen as [outer, channel, inner] and channel selects scale / zero point. channel = 0: per tensor */
+static bool GetQuantizationShape(const OutputTensorInfo& info, int32_t& channel, int32_t& inner)
+{
+    channel = 0;
+    inner = 1;
+    if (info.quant.axis < 0 || info.quant.scale_list.empty()) {
+        return true;
+    }
+    if (info.quant.axis >= static_cast<int32_t>(info.tensor_dims.size())
+        || static_cast<int32_t>(info.quant.scale_list.size()) != info.tensor_dims[info.quant.axis]
+        || (!info.quant.zero_point_list.empty() && info.quant.zero_point_list.size() != info.quant.scale_list.size())) {
+        PRINT_E("Invalid per axis quantization parameters (%s)\n", info.name.c_str());
+        return false;
+    }
+    channel = info.tensor_dims[info.quant.axis];
+    for (size_t i = info.quant.axis + 1; i < info.tensor_dims.size(); i++) {
+        inner *= info.tensor_dims[i];
+    }
+    return true;
+}
+
+/* dst[i] = dequantized src[start + i * step]  (i < num) */
+template<typename T>
+static void DequantizeRange(const OutputTensorInfo& info, const T* src, int32_t start, int32_t num, int32_t step, int32_t channel, int32_t inner, float* dst)
+{
+    if (step == 1 && channel == 0) {
+        InferenceHelperKernel::Dequantize(src + start, num, info.quant.zero_point, info.quant.scale, dst);
+        return;
+    }
+
+    const auto& scale_list = info.quant.scale_list;
+    const auto& zero_point_list = info.quant.zero_point_list;
+    if (step == 1 && inner > 1) {
+        /* Scale is the same in each run of inner elements */
+        int32_t i = 0;
+        while (i < num) {
+            const int32_t segment = (start + i) / inner;
+            const int32_t c = segment % channel;
+            const int32_t segment_end = (std::min)(num, (segment + 1) * inner - start);
+            const int32_t zero_point = zero_point_list.empty() ? info.quant.zero_point : zero_point_list[c];
+            InferenceHelperKernel::Dequantize(src + start + i, segment_end - i, zero_point, scale_list[c], dst + i);
+            i = segment_end;
+        }
+        return;
+    }
+
+    /* Scale may change every element (the innermost dimension is quantized per channel (e.g. NHWC), or strided access) */
+    for (int32_t i = 0; i < num; i++) {
+        const int32_t index = start + i * step;
+        float scale = info.quant.scale;
+        int32_t zero_point = info.quant.zero_point;
+        if (channel > 0) {
+            const int32_t c = (index / inner) % channel;
+            scale = scale_list[c];
+            if (!zero_point_list.empty()) zero_point = zero_point_list[c];
+        }
+        dst[i] = (src[index] - zero_point) * scale;
+    }
+}
+
+static void DequantizeRange(const OutputTensorInfo&, const float* src, int32_t start, int32_t num, int32_t step, int32_t, int32_t, float* dst)
+{
+    if (step == 1) {
+        std::memcpy(dst, src + start, sizeof(float) * num);
+    } else {
+        for (int32_t i = 0; i < num; i++) {
+            dst[i] = src[start + i * step];
+        }
+    }
+}
+
+/* dst[i] = src[start + i * step] converted to float (fp16, bf16, int32 and int64 are not quantized) */
+template<typename T>
+static void ConvertRange(const T* src, int32_t start, int32_t num, int32_t step, void (*convert)(const T*, int32_t, float*), float* dst)
+{
+    if (step == 1) {
+        convert(src + start, num, dst);
+    } else {
+        for (int32_t i = 0; i < num; i++) {
+            convert(src + start + i * step, 1, dst + i);
+        }
+    }
+}
+
+static void DequantizeRange(const OutputTensorInfo& info, int32_t start, int32_t num, int32_t step, int32_t channel, int32_t inner, float* dst)
+{
+    switch (info.tensor_type) {
+    case TensorInfo::kTensorTypeUint8:
+        DequantizeRange(info, static_cast<const uint8_t*>(info.data), start, num, step, channel, inner, dst);
+        break;
+    case TensorInfo::kTensorTypeInt8:
+        DequantizeRange(info, static_cast<const int8_t*>(info.data), start, num, step, channel, inner, dst);
+        break;
+    case TensorInfo::kTensorTypeFp32:
+        DequantizeRange(info, static_cast<const float*>(info.data), start, num, step, channel, inner, dst);
+        break;
+    case TensorInfo::kTensorTypeFp16:
+        ConvertRange(static_cast<const uint16_t*>(info.data), start, num, step, InferenceHelperKernel::ConvertFp16ToFp32, dst);
+        break;
+    case TensorInfo::kTensorTypeBf16:
+        ConvertRange(static_cast<const uint16_t*>(info.data), start, num, step, InferenceHelperKernel::ConvertBf16ToFp32, dst);
+        break;
+    case TensorInfo::kTensorTypeInt32:
+        ConvertRange(static_cast<const int32_t*>(info.data), start, num, step, InferenceHelperKernel::ConvertInt32ToFp32, dst);
+        break;
+    case TensorInfo::kTensorTypeInt64:
+        ConvertRange(static_cast<const int64_t*>(info.data), start, num, step, InferenceHelperKernel::ConvertInt64ToFp32, dst);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Check the tensor can be read by GetDataAsFloat, GetChannelAsFloat, etc. */
+static bool IsReadableAsFloat(const OutputTensorInfo& info)
+{
+    if (info.data == nullptr) return false;
+    switch (info.tensor_type) {
+    case TensorInfo::kTensorTypeUint8:
+    case TensorInfo::kTensorTypeInt8:
+    case TensorInfo::kTensorTypeFp32:
+    case TensorInfo::kTensorTypeFp16:
+    case TensorInfo::kTensorTypeBf16:
+    case TensorInfo::kTensorTypeInt32:
+    case TensorInfo::kTensorTypeInt64:
+        return true;
+    default:
+        return false;
+    }
+}
+
+float* OutputTensorInfo::GetDataAsFloat()
+{
+    if (tensor_type == kTensorTypeFp32) {
+        return static_cast<float*>(data);
+    } else if (!IsReadableAsFloat(*this)) {
+        return nullptr;
+    }
+
+    const int32_t element_num = GetElementNum();
+    if (static_cast<int32_t>(data_fp32_.size()) == element_num && data_fp32_source_ == data && data_fp32_generation_ == generation) {
+        /* Already dequantized after the last Process */
+        return data_fp32_.data();
+    }
+
+    int32_t channel;
+    int32_t inner;
+    if (!GetQuantizationShape(*this, channel, inner)) {
+        return nullptr;
+    }
+
+    data_fp32_.resize(element_num);
+    float* dst = data_fp32_.data();
+    const int32_t block_num = (element_num + kDequantizeBlockSize - 1) / kDequantizeBlockSize;
+#pragma omp parallel for if (block_num > 1)
+    for (int32_t block = 0; block < block_num; block++) {
+        const int32_t start = block * kDequantizeBlockSize;
+        const int32_t num = (std::min)(element_num - start, kDequantizeBlockSize);
+        DequantizeRange(*this, start, num, 1, channel, inner, dst + start);
+    }
+    data_fp32_source_ = data;
+    data_fp32_generation_ = generation;
+    return dst;
+}
+
+bool OutputTensorInfo::GetDataAsFloat(int32_t start, int32_t num, float* dst) const
+{
+    int32_t channel;
+    int32_t inner;
+    if (!IsReadableAsFloat(*this) || !GetQuantizationShape(*this, channel, inner)) return false;
+    if (start < 0 || num < 0 || start + num > GetElementNum()) {
+        PRINT_E("Invalid range [%d, %d) (%s)\n", start, start + num, name.c_str());
+        return false;
+    }
+    DequantizeRange(*this, start, num, 1, channel, inner, dst);
+    return true;
+}
+
+bool OutputTensorInfo::GetChannelAsFloat(int32_t batch, int32_t channel_index, float* dst) const
+{
+    int32_t channel;
+    int32_t inner;
+    if (!IsReadableAsFloat(*this) || !GetQuantizationShape(*this, channel, inner)) return false;
+    const int32_t tensor_channel = GetChannel();
+    const int32_t plane_size = GetHeight() * GetWidth();
+    if (tensor_dims.size() != 4 || batch < 0 || batch >= GetBatch() || channel_index < 0 || channel_index >= tensor_channel) {
+        PRINT_E("Invalid batch / channel (%d, %d) (%s)\n", batch, channel_index, name.c_str());
+        return false;
+    }
+    if (is_nchw) {
+        DequantizeRange(*this, (batch * tensor_channel + channel_index) * plane_size, plane_size, 1, channel, inner, dst);
+    } else {
+        DequantizeRange(*this, batch * plane_size * tensor_channel + channel_index, plane_size, tensor_channel, channel, inner, dst);
+    }
+    return true;
+}
+
+bool OutputTensorInfo::GetRoiAsFloat(int32_t batch, int32_t x, int32_t y, int32_t width, int32_t height, float* dst) const
+{
+    int32_t channel;
+    int32_t inner;
+    if (!IsReadableAsFloat(*this) || !GetQuantizationShape(*this, channel, inner)) return false;
+    const int32_t tensor_channel = GetChannel();
+    const int32_t tensor_height = GetHeight();
+    const int32_t tensor_width = GetWidth();
+    if (tensor_dims.size() != 4 || batch < 0 || batch >= GetBatch()
+        || x < 0 || y < 0 || width < 0 || height < 0 || x + width > tensor_width || y + height > tensor_height) {
+        PRINT_E("Invalid ROI (%d, %d, %d, %d, %d) (%s)\n", batch, x, y, width, height, name.c_str());
+        return false;
+    }
+    if (is_nchw) {
+        for (int32_t c = 0; c < tensor_channel; c++) {
+            for (int32_t row = 0; row < height; row++) {
+                const int32_t start = ((batch * tensor_channel + c) * tensor_height + y + row) * tensor_width + x;
+                DequantizeRange(*this, start, width, 1, channel, inner, dst + (c * height + row) * width);
             }
         }
+    } else {
+        for (int32_t row = 0; row < height; row++) {
+            const int32_t start = ((batch * tensor_height + y + row) * tensor_width + x) * tensor_channel;
+            DequantizeRange(*this, start, width * tensor_channel, 1, channel, inner, dst + row * width * tensor_channel);
+        }
     }
+    return true;
 }
 
-template void InferenceHelper::PreProcessBlob<float>(int32_t num_thread, const InputTensorInfo& input_tensor_info, float* dst);
-template void InferenceHelper::PreProcessBlob<int32_t>(int32_t num_thread, const InputTensorInfo& input_tensor_info, int32_t* dst);
-template void InferenceHelper::PreProcessBlob<int64_t>(int32_t num_thread, const InputTensorInfo& input_tensor_info, int64_t* dst);
-template void InferenceHelper::PreProcessBlob<uint8_t>(int32_t num_thread, const InputTensorInfo& input_tensor_info, uint8_t* dst);
-template void InferenceHelper::PreProcessBlob<int8_t>(int32_t num_thread, const InputTensorInfo& input_tensor_info, int8_t* dst);
+int32_t OutputTensorInfo::QuantizeThreshold(float threshold, int32_t index) const
+{
+    int32_t q_min = 0;
+    int32_t q_max = 255;
+    if (tensor_type == kTensorTypeInt8) {
+        q_min = -128;
+        q_max = 127;
+    }
+    const float scale = GetScale(index);
+    const int32_t zero_point = GetZeroPoint(index);
+    if (scale <= 0.0f) {
+        return q_min;
+    }
+    /* The smallest q satisfying (q - zero_point) * scale >= threshold. Adjusted so that the result is the same as dequantization in float */
+    double q_double = std::ceil(static_cast<double>(threshold) / scale + zero_point);
+    q_double = (std::max)(static_cast<double>(q_min), (std::min)(static_cast<double>(q_max + 1), q_double));
+    int32_t q = static_cast<int32_t>(q_double);
+    while (q > q_min && (q - 1 - zero_point) * scale >= threshold) q--;
+    while (q <= q_max && (q - zero_point) * scale < threshold) q++;
+    return q;
+}
@@ -22,6 +22,107 @@ limitations under the License.
 #include <vector>
 #include <array>
 #include <memory>
+#include <initializer_list>
+
+/* Dimensions of tensor stored in the object (no heap allocation, up to kMaxSize dimensions)
+ * It can be used in the same way as std::vector<int32_t> (clear, push_back, [], range-based for, = { 1, 224, 224, 3 }, etc.)
+ * The number of elements is cached and calculated again only after the dimensions are modified
+ */
+class TensorDims {
+public:
+    static constexpr int32_t kMaxSize = 8;
+    typedef int32_t value_type;
+    typedef int32_t* iterator;
+    typedef const int32_t* const_iterator;
+
+public:
+    TensorDims()
+        : dims_{}
+        , size_(0)
+        , element_num_(1)
+    {}
+
+    TensorDims(std::initializer_list<int32_t> dims)
+        : TensorDims()
+    {
+        Assign(dims.begin(), dims.end());
+    }
+
+    TensorDims(const std::vector<int32_t>& dims)
+        : TensorDims()
+    {
+        Assign(dims.data(), dims.data() + dims.size());
+    }
+
+    operator std::vector<int32_t>() const { return std::vector<int32_t>(begin(), end()); }
+
+    size_t size() const { return static_cast<size_t>(size_); }
+    bool empty() const { return size_ == 0; }
+    void clear()
+    {
+        size_ = 0;
+        element_num_ = 1;
+    }
+    void push_back(int32_t dim)     // ignored if kMaxSize dimensions are set already
+    {
+        if (size_ >= kMaxSize) return;
+        dims_[size_++] = dim;
+        element_num_ = -1;
+    }
+    void resize(size_t size, int32_t dim = 0)
+    {
+        while (size_ < static_cast<int32_t>(size) && size_ < kMaxSize) dims_[size_++] = dim;
+        if (static_cast<int32_t>(size) < size_) size_ = static_cast<int32_t>(size);
+        element_num_ = -1;
+    }
+
+    /* Non-const access may modify the dimensions, so the cached number of elements is calculated again */
+    const int32_t& operator[](size_t index) const { return dims_[index]; }
+    int32_t& operator[](size_t index) { element_num_ = -1; return dims_[index]; }
+    const int32_t& back() const { return dims_[size_ - 1]; }
+    int32_t& back() { element_num_ = -1; return dims_[size_ - 1]; }
+    const int32_t* begin() const { return dims_; }
+    const int32_t* end() const { return dims_ + size_; }
+    int32_t* begin() { element_num_ = -1; return dims_; }
+    int32_t* end() { element_num_ = -1; return dims_ + size_; }
+    const int32_t* data() const { return dims_; }
+
+    int32_t GetElementNum() const
+    {
+        if (element_num_ < 0) {
+            element_num_ = 1;
+            for (int32_t i = 0; i < size_; i++) {
+                element_num_ *= dims_[i];
+            }
+        }
+        return element_num_;
+    }
+
+    friend bool operator==(const TensorDims& a, const TensorDims& b)
+    {
+        if (a.size_ != b.size_) return false;
+        for (int32_t i = 0; i < a.size_; i++) {
+            if (a.dims_[i] != b.dims_[i]) return false;
+        }
+        return true;
+    }
+    friend bool operator!=(const TensorDims& a, const TensorDims& b) { return !(a == b); }
+
+private:
+    void Assign(const int32_t* first, const int32_t* last)
+    {
+        size_ = 0;
+        for (; first != last && size_ < kMaxSize; first++) {
+            dims_[size_++] = *first;
+        }
+        element_num_ = -1;
+    }
+
+private:
+    int32_t dims_[kMaxSize];
+    int32_t size_;
+    mutable int32_t element_num_;   // -1: not calculated yet
+};
 
 class TensorInfo {
 public:
@@ -32,6 +133,8 @@ public:
         kTensorTypeFp32,
         kTensorTypeInt32,
         kTensorTypeInt64,
+        kTensorTypeFp16,    // IEEE half precision. Data is uint16_t (bit pattern)
+        kTensorTypeBf16,    // bfloat16. Data is uint16_t (bit pattern)
     };
 
 public:
@@ -41,15 +144,34 @@ public:
         , tensor_type(kTensorTypeNone)
         , is_nchw(true)
     {}
-    ~TensorInfo() {}
 
     int32_t GetElementNum() const
     {
-        int32_t element_num = 1;
-        for (const auto& dim : tensor_dims) {
-            element_num *= dim;
+        return tensor_dims.GetElementNum();
+    }
+
+    int32_t GetByteSize() const
+    {
+        return GetElementNum() * GetElementSize(tensor_type);
+    }
+
+    static int32_t GetElementSize(int32_t tensor_type)
+    {
+        switch (tensor_type) {
+        case kTensorTypeUint8:
+        case kTensorTypeInt8:
+            return 1;
+        case kTensorTypeFp16:
+        case kTensorTypeBf16:
+            return 2;
+        case kTensorTypeFp32:
+        case kTensorTypeInt32:
+            return 4;
+        case kTensorTypeInt64:
+            return 8;
+        default:
+            return 0;
         }
-        return element_num;
     }
 
     int32_t GetBatch() const
@@ -95,7 +217,7 @@ public:
     std::string          name;           // [In] Set the name_ of tensor
     int32_t              id;             // [Out] Do not modify (Used in InferenceHelper)
     int32_t              tensor_type;    // [In] The type of tensor (e.g. kTensorTypeFp32)
-    std::vector<int32_t> tensor_dims;    // InputTensorInfo:   [In] The dimentions of tensor. (If empty at initialize, the size is updated from model info.)
+    TensorDims           tensor_dims;    // InputTensorInfo:   [In] The dimentions of tensor. (If empty at initialize, the size is updated from model info.)
                                          // OutputTensorInfo: [Out] The dimentions of tensor is set from model information
     bool                 is_nchw;        // [IN] NCHW or NHWC
 };
@@ -106,14 +228,26 @@ public:
         kDataTypeImage,
         kDataTypeBlobNhwc,  // data_ which already finished preprocess(color conversion, resize, normalize_, etc.)
         kDataTypeBlobNchw,
+        kDataTypeImageNv12, // YUV420 (Y plane + interleaved UV plane). Converted to RGB in pre-process
+        kDataTypeImageNv21, // YUV420 (Y plane + interleaved VU plane). Converted to RGB in pre-process
+        kDataTypeImageI420, // YUV420 (Y plane + U plane + V plane). Converted to RGB in pre-process
+    };
+
+    enum {
+        kLetterboxNone,     // resize crop area to the tensor size (aspect ratio is not kept)
+        kLetterboxCenter,   // keep aspect ratio and put the image at the center
+        kLetterboxTopLeft,  // keep aspect ratio and put the image at the top left
     };
 
 public:
     InputTensorInfo()
         : data(nullptr)
         , data_type(kDataTypeImage)
-        , image_info({ -1, -1, -1, -1, -1, -1, -1, true, false })
+        , image_info({ -1, -1, -1, -1, -1, -1, -1, true, false, kLetterboxNone, 0, 0, nullptr, nullptr, 0 })
         , normalize({ 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f })
+        , is_quantize(false)
+        , quant({ 0.0f, 0.0f, 0.0f, 0, 0, 0 })
+        , image_transform({ 1.0f, 1.0f, 0, 0, -1, -1 })
     {}
 
     InputTensorInfo(std::string name_, int32_t tensor_type_, bool is_nchw_ = true)
@@ -124,28 +258,62 @@ public:
         is_nchw = is_nchw_;
     }
 
-    ~InputTensorInfo() {}
+    bool IsImage() const
+    {
+        return (data_type == kDataTypeImage) || (data_type == kDataTypeImageNv12) || (data_type == kDataTypeImageNv21) || (data_type == kDataTypeImageI420);
+    }
 
 public:
     void*   data;      // [In] Set the pointer to image/blob
     int32_t data_type; // [In] Set the type of data_ (e.g. kDataTypeImage)
 
-    struct {
+    struct ImageInfo {
         int32_t width;
         int32_t height;
-        int32_t channel;
+        int32_t channel;       // 1, 3 or 4 (4: e.g. RGBA. Used as it is for 4 channel tensor. The 4th channel is normalized with mean = 0, norm = 1)
         int32_t crop_x;
         int32_t crop_y;
         int32_t crop_width;
         int32_t crop_height;
         bool    is_bgr;        // used when channel == 3 (true: BGR, false: RGB)
         bool    swap_color;
-    } image_info;              // [In] used when data_type_ == kDataTypeImage
+        int32_t letterbox;     // kLetterboxNone, kLetterboxCenter, kLetterboxTopLeft
+        uint8_t letterbox_pad; // pixel value (before normalize) for padding area
+        int32_t stride;        // bytes per row (Y plane for YUV). 0: tightly packed (width * channel, width for YUV)
+        void*   data_u;        // YUV: U plane (I420), UV plane (NV12), VU plane (NV21). nullptr: follows Y plane
+        void*   data_v;        // YUV: V plane (I420). nullptr: follows U plane
+        int32_t stride_uv;     // YUV: bytes per row of U and V plane (UV plane). 0: tightly packed
+    } image_info;              // [In] used when data_type_ == kDataTypeImage (kDataTypeImageNv12, etc.). data is Y plane and channel is ignored for YUV
 
     struct {
         float mean[3];
         float norm[3];
     } normalize;              // [In] used when data_type_ == kDataTypeImage
+
+    bool is_quantize;         // [In] used when data_type_ == kDataTypeImage and tensor_type is kTensorTypeUint8/kTensorTypeInt8
+                              //      true: quantize the normalized value using quant, false: pixel value (uint8), pixel value - 128 (int8)
+
+    struct {
+        float   scale[3];
+        int32_t zero_point[3];
+    } quant;                  // [Out] Parameters for quantization (convert float to uint8/int8) for each channel. Set from model information
+
+    /* tensor_x = (image_x - crop_x) * scale_x + offset_x. The image is stored in (offset_x, offset_y, width, height) of the tensor */
+    mutable struct ImageTransform {
+        float   scale_x;
+        float   scale_y;
+        int32_t offset_x;
+        int32_t offset_y;
+        int32_t width;
+        int32_t height;
+    } image_transform;        // [Out] set by PreProcess when data_type_ == kDataTypeImage
+
+    struct BatchData {
+        void*                  data;
+        ImageInfo              image_info;
+        mutable ImageTransform image_transform;
+    };
+    std::vector<BatchData> batch_list;  // [In] Set data (and image_info) for each batch slot to fill N dimension. If empty, data (and image_info) above is used for batch 0
 };
 
 
@@ -153,8 +321,11 @@ class OutputTensorInfo : public TensorInfo {
 public:
     OutputTensorInfo()
         : data(nullptr)
-        , quant({ 1.0f, 0 })
-        , data_fp32_(nullptr)
+        , quant({ 1.0f, 0, -1, {}, {} })
+        , generation(0)
+        , convert_layout(false)
+        , data_fp32_source_(nullptr)
+        , data_fp32_generation_(0)
     {}
 
     OutputTensorInfo(std::string name_, int32_t tensor_type_, bool is_nchw_ = true)
@@ -164,50 +335,126 @@ public:
         tensor_type = tensor_type_;
         is_nchw = is_nchw_;
     }
-    
-    ~OutputTensorInfo() {
-        if (data_fp32_ != nullptr) {
-            delete[] data_fp32_;
-        }
-    }
 
-    float* GetDataAsFloat() {       /* Returned pointer should be with const, but returning pointer without const is convenient to create cv::Mat */
-        if (tensor_type == kTensorTypeUint8 || tensor_type == kTensorTypeInt8) {
-            if (data_fp32_ == nullptr) {
-                data_fp32_ = new float[GetElementNum()];
-            }
-            if (tensor_type == kTensorTypeUint8) {
-#pragma omp parallel
-                for (int32_t i = 0; i < GetElementNum(); i++) {
-                    const uint8_t* val_uint8 = static_cast<const uint8_t*>(data);
-                    float val_float = (val_uint8[i] - quant.zero_point) * quant.scale;
-                    data_fp32_[i] = val_float;
-                }
-            } else {
-#pragma omp parallel
-                for (int32_t i = 0; i < GetElementNum(); i++) {
-                    const int8_t* val_int8 = static_cast<const int8_t*>(data);
-                    float val_float = (val_int8[i] - quant.zero_point) * quant.scale;
-                    data_fp32_[i] = val_float;
-                }
-            }
-            return data_fp32_;
-        } else if (tensor_type == kTensorTypeFp32) {
-            return static_cast<float*>(data);
-        } else {
-            return nullptr;
-        }
+    /* Returned pointer should be with const, but returning pointer without const is convenient to create cv::Mat
+     * Quantized data (uint8 / int8) is dequantized, and fp16 / bf16 / int32 / int64 data is converted to float
+     * The conversion is done only once per generation (the result is cached until Process updates the output)
+     */
+    float* GetDataAsFloat();
+
+    /* Dequantize (convert) only a part of the tensor into dst prepared by the caller (fp32 data is copied). Returns false for invalid region or type
+     * These read data directly without using the buffer of GetDataAsFloat(), so that only the required region is processed
+     */
+    bool GetDataAsFloat(int32_t start, int32_t num, float* dst) const;                                           // elements [start, start + num)
+    bool GetChannelAsFloat(int32_t batch, int32_t channel, float* dst) const;                                   // height x width plane of the channel
+    bool GetRoiAsFloat(int32_t batch, int32_t x, int32_t y, int32_t width, int32_t height, float* dst) const;   // all channels in the same layout as the tensor
+
+    /* Quantized data as it is (nullptr if the tensor is not the type) and its parameters, to process data in integer domain (e.g. threshold, argmax)
+     * index is the index along quant.axis for per axis quantization, and ignored for per tensor quantization
+     */
+    const uint8_t* GetDataAsUint8() const { return (tensor_type == kTensorTypeUint8) ? static_cast<const uint8_t*>(data) : nullptr; }
+    const int8_t* GetDataAsInt8() const { return (tensor_type == kTensorTypeInt8) ? static_cast<const int8_t*>(data) : nullptr; }
+    float GetScale(int32_t index = 0) const
+    {
+        if (quant.axis < 0 || index < 0 || index >= static_cast<int32_t>(quant.scale_list.size())) return quant.scale;
+        return quant.scale_list[index];
+    }
+    int32_t GetZeroPoint(int32_t index = 0) const
+    {
+        if (quant.axis < 0 || index < 0 || index >= static_cast<int32_t>(quant.zero_point_list.size())) return quant.zero_point;
+        return quant.zero_point_list[index];
     }
+    /* The smallest quantized value q where dequantized q >= threshold. (q_raw >= QuantizeThreshold(th)) is the same as (dequantized >= th)
+     * Returns max + 1 of the type (e.g. 256 for uint8) if no value satisfies
+     */
+    int32_t QuantizeThreshold(float threshold, int32_t index = 0) const;
 
 public:
     void* data;     // [Out] Pointer to the output data_
     struct {
         float   scale;
         int32_t zero_point;
+        int32_t axis;                           // dimension of tensor_dims for scale_list and zero_point_list. -1: per tensor (scale, zero_point are used)
+        std::vector<float>   scale_list;        // per axis (channel) quantization. size = tensor_dims[axis]
+        std::vector<int32_t> zero_point_list;   // per axis (channel) quantization. size = tensor_dims[axis], or empty to use zero_point for all
     } quant;        // [Out] Parameters for dequantization (convert uint8 to float)
+    uint32_t generation;    // [Out] Incremented by Process each time data is updated
+    bool convert_layout;    // [In] true: 4 dimension output is provided in the layout of is_nchw (data, tensor_dims and quant.axis are converted by Process)
+                            //      The data is used as it is if the model output is in the layout already, otherwise transposed into a buffer owned by InferenceHelper
+                            //      false: the model output is provided as it is (is_nchw should be the layout of the model output)
 
 private:
-    float* data_fp32_;
+    std::vector<float> data_fp32_;      // dequantized data. Copied and moved with the object (no destructor, so that the implicit move is used)
+    const void* data_fp32_source_;      // data and generation which data_fp32_ is calculated from
+    uint32_t    data_fp32_generation_;
+};
+
+
+/* Pre-process of one input tensor compiled from InputTensorInfo at Initialize, so that PreProcess only calls function for each tensor
+ * Parameters derived from InputTensorInfo are kept here, and InputTensorInfo set by the caller is not modified
+ */
+class PreProcessPlan {
+public:
+    typedef int32_t (*Function)(int32_t num_thread, const InputTensorInfo& input_tensor_info, PreProcessPlan& plan, void* dst);   // dst: plan.dst, or staging buffer
+
+    /* Work buffers of a pre-process thread (sized when the layout is built, so that no allocation happens for each frame) */
+    struct ThreadBuffer {
+        std::vector<uint8_t> row_cache[2];      // rows converted from YUV. Bilinear resize uses two rows, and the next output row often uses the same rows
+        int32_t              row_cache_row[2];
+        std::vector<uint8_t> resize;
+        std::vector<uint8_t> color;
+    };
+
+    /* Resize table, etc. for one batch slot. Rebuilt only when the caller changes the geometry of the image */
+    struct ImageLayout {
+        bool                            is_valid;
+        InputTensorInfo::ImageInfo      image_info;        // geometry used to build this layout (data pointers and stride are not used)
+        int32_t                         color_conversion;
+        InputTensorInfo::ImageTransform image_transform;
+        bool                            is_resize;
+        std::vector<int32_t>            x_offset0;
+        std::vector<int32_t>            x_offset1;
+        std::vector<int16_t>            x_weight;
+        std::vector<int32_t>            y_offset0;
+        std::vector<int32_t>            y_offset1;
+        std::vector<int16_t>            y_weight;
+        std::vector<uint8_t>            pad_row;
+        std::vector<ThreadBuffer>       thread_buffer_list;     // for each thread
+    };
+
+public:
+    PreProcessPlan()
+        : function(nullptr)
+        , dst(nullptr)
+        , data_type(-1)
+        , tensor_type(TensorInfo::kTensorTypeNone)
+        , is_nchw(true)
+        , batch(-1)
+        , width(-1)
+        , height(-1)
+        , channel(-1)
+        , element_num_per_batch(0)
+        , mean{ 0.0f, 0.0f, 0.0f, 0.0f }
+        , norm{ 1.0f, 1.0f, 1.0f, 1.0f }
+    {}
+    ~PreProcessPlan() {}
+
+public:
+    Function function;              // specialized for data_type, tensor_type and layout
+    void*    dst;                   // tensor buffer to store the result. Update it if the buffer is allocated for each frame
+    int32_t  data_type;
+    int32_t  tensor_type;
+    bool     is_nchw;
+    int32_t  batch;
+    int32_t  width;
+    int32_t  height;
+    int32_t  channel;
+    int32_t  element_num_per_batch;
+    TensorDims tensor_dims;         // dims of the tensor at Initialize. The buffers (tensor and staging) are sized for it
+    float    mean[4];               // mean * 255 (4th channel: 0)
+    float    norm[4];               // 1 / (norm * 255) (4th channel: 1 / 255)
+    std::vector<uint8_t> quant_table;               // normalize + quantize table (256 entries for each channel). empty: not quantized
+    std::vector<ImageLayout> image_layout_list;     // for each batch slot
 };
 
 
@@ -251,7 +498,13 @@ public:
     static InferenceHelper* Create(const HelperType helper_type);
     static void PreProcessByOpenCV(const InputTensorInfo& input_tensor_info, bool is_nchw, cv::Mat& img_blob);   // use this if the selected inference engine doesn't support pre-process
 
+    /* Read the model file. The bytes are shared by the instances reading the same file while any of them keeps it (e.g. InferenceHelperPool)
+     * Use this for frameworks which refer to the model bytes without copy. Returns nullptr for error
+     */
+    static std::shared_ptr<const std::vector<char>> LoadModelBuffer(const std::string& model_filename);
+
 public:
+    InferenceHelper() : is_pre_process_stageable_(false), pre_process_slot_(-1), staging_list_(kPreProcessSlotNum) {}
     virtual ~InferenceHelper() {}
     virtual int32_t SetNumThreads(const int32_t num_threads) = 0;
     virtual int32_t SetCustomOps(const std::vector<std::pair<const char*, const void*>>& custom_ops) = 0;
@@ -260,18 +513,65 @@ public:
     virtual int32_t PreProcess(const std::vector<InputTensorInfo>& input_tensor_info_list) = 0;
     virtual int32_t Process(std::vector<OutputTensorInfo>& output_tensor_info_list) = 0;
 
+    /* Pipelining (used by InferenceHelperPipeline). PreProcessToSlot + CommitPreProcess is the same as PreProcess
+     * PreProcessToSlot stores the result into the staging buffer of the slot without touching the input tensors, so it can run on another thread while Process runs
+     * CommitPreProcess copies the staging buffer into the input tensors (call it right before Process on the thread calling Process)
+     * Frameworks whose PreProcess doesn't only use the pre-process plan (e.g. framework's pre-process is used) run PreProcess at CommitPreProcess
+     * The number of slots is kPreProcessSlotNum by default. SetPreProcessSlotNum changes it (call before using slots)
+     */
+    static constexpr int32_t kPreProcessSlotNum = 2;
+    int32_t SetPreProcessSlotNum(int32_t slot_num);
+    int32_t GetPreProcessSlotNum() const { return static_cast<int32_t>(staging_list_.size()); }
+    int32_t PreProcessToSlot(int32_t slot, const std::vector<InputTensorInfo>& input_tensor_info_list);
+    int32_t CommitPreProcess(int32_t slot, const std::vector<InputTensorInfo>& input_tensor_info_list);
+
 protected:
-    void ConvertNormalizeParameters(InputTensorInfo& tensor_info);
+    /* Compile pre-process of the input tensor and append it to pre_process_plan_list_ (call at the end of Initialize in the order of input_tensor_info_list)
+     * dst is the tensor buffer to store the result (nullptr if the buffer is allocated later, or the framework's pre-process is used)
+     */
+    void CreatePreProcessPlan(const InputTensorInfo& input_tensor_info, void* dst);
+
+    /* Allocate the staging buffers of every slot for the pre-process plans (called when plans or slots are added, not for each frame) */
+    void ResizeStagingBuffer(void);
+
+    /* Crop, resize, color conversion and normalize (image), or copy with NCHW <-> NHWC conversion (blob) for each tensor using the plan
+     * Returns kRetErr for unsupported conversion
+     */
+    int32_t RunPreProcessPlan(int32_t num_thread, const std::vector<InputTensorInfo>& input_tensor_info_list);
 
-    void PreProcessImage(int32_t num_thread, const InputTensorInfo& input_tensor_info, float* dst);
-    void PreProcessImage(int32_t num_thread, const InputTensorInfo& input_tensor_info, uint8_t* dst);
-    void PreProcessImage(int32_t num_thread, const InputTensorInfo& input_tensor_info, int8_t* dst);
+    /* Increment generation of each output tensor (call at the end of Process when the output data is updated) */
+    static void IncrementOutputGeneration(std::vector<OutputTensorInfo>& output_tensor_info_list);
 
-    template<typename T>
-    void PreProcessBlob(int32_t num_thread, const InputTensorInfo& input_tensor_info, T *dst);
+    /* Convert outputs with convert_layout to the layout of is_nchw (call at the end of Process, after data and tensor_dims are set)
+     * is_model_nchw is the layout of the model output. The single tensor version is for frameworks whose layout differs for each output
+     */
+    int32_t ConvertOutputLayout(int32_t num_thread, bool is_model_nchw, std::vector<OutputTensorInfo>& output_tensor_info_list);
+    int32_t ConvertOutputLayout(int32_t num_thread, bool is_model_nchw, int32_t index, OutputTensorInfo& output_tensor_info);
+
+protected:
+    /* Output converted by ConvertOutputLayout. The model output is kept to restore it at the next frame when the framework doesn't set it every frame */
+    struct OutputLayout {
+        bool                 is_converted;
+        void*                model_data;
+        TensorDims           model_dims;
+        int32_t              model_quant_axis;
+        TensorDims           converted_dims;
+        std::vector<uint8_t> buffer;
+    };
+
+    /* Result of PreProcessToSlot for an input tensor */
+    struct StagingBuffer {
+        void*                dst;       // plan.dst
+        std::vector<uint8_t> buffer;
+    };
 
 protected:
     HelperType helper_type_;
+    std::vector<PreProcessPlan> pre_process_plan_list_;
+    std::vector<OutputLayout> output_layout_list_;      // for each output tensor
+    bool is_pre_process_stageable_;     // set true at Initialize if PreProcess does nothing but RunPreProcessPlan
+    int32_t pre_process_slot_;          // >= 0 while PreProcessToSlot runs
+    std::vector<std::vector<StagingBuffer>> staging_list_;          // [slot][input tensor]
 };
 
 #endif
@@ -184,6 +184,15 @@ public:
             if (AllocateBuffer(armnn_tensor_info, list_buffer_in_) != InferenceHelper::kRetOk) {
                 return InferenceHelper::kRetErr;
             }
+
+            /* Quantization parameters (per tensor or per channel) */
+            if (armnn_tensor_info.IsQuantized()) {
+                const std::vector<float> scales = armnn_tensor_info.GetQuantizationScales();
+                for (int32_t c = 0; c < 3; c++) {
+                    tensor_info.quant.scale[c] = scales.empty() ? 0.0f : scales[(std::min)(c, static_cast<int32_t>(scales.size()) - 1)];
+                    tensor_info.quant.zero_point[c] = armnn_tensor_info.GetQuantizationOffset();
+                }
+            }
             list_armnntensor_in_.push_back(std::make_pair(armnn_info.first, armnn::Tensor(armnn_info.second, list_buffer_in_.back())));
         }
  
@@ -208,7 +217,17 @@ public:
 
             tensor_info.data = list_buffer_out_.back();
             tensor_info.quant.zero_point = armnn_tensor_info.GetQuantizationOffset();
-            tensor_info.quant.scale = armnn_tensor_info.GetQuantizationScale();
+            tensor_info.quant.axis = -1;
+            tensor_info.quant.scale_list.clear();
+            tensor_info.quant.zero_point_list.clear();
+            if (armnn_tensor_info.HasMultipleQuantizationScales() && armnn_tensor_info.GetQuantizationDim().has_value()) {
+                /* Per axis quantization. GetQuantizationScale can't be used */
+                tensor_info.quant.scale = 1.0f;
+                tensor_info.quant.axis = armnn_tensor_info.GetQuantizationDim().value();
+                tensor_info.quant.scale_list = armnn_tensor_info.GetQuantizationScales();
+            } else {
+                tensor_info.quant.scale = armnn_tensor_info.GetQuantizationScale();
+            }
         }
 
         return InferenceHelper::kRetOk;
@@ -410,11 +429,15 @@ int32_t InferenceHelperArmnn::Initialize(const std::string& model_filename, std:
         return InferenceHelper::kRetErr;
     }
 
-    /* Convert normalize parameter to speed up */
-    for (auto& tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(tensor_info);
+    /* Compile pre-process for each input tensor (normalize parameters are converted to speed up) */
+    pre_process_plan_list_.clear();
+    for (size_t i = 0; i < input_tensor_info_list.size(); i++) {
+        CreatePreProcessPlan(input_tensor_info_list[i], (i < armnn_wrapper_->list_buffer_in_.size()) ? armnn_wrapper_->list_buffer_in_[i] : nullptr);
     }
 
+    /* PreProcess runs only the plan, so that it can be pipelined (PreProcessToSlot) */
+    is_pre_process_stageable_ = true;
+
     return InferenceHelper::kRetOk;
 
 }
@@ -426,67 +449,18 @@ int InferenceHelperArmnn::Finalize(void)
 
 int32_t InferenceHelperArmnn::PreProcess(const std::vector<InputTensorInfo>& input_tensor_info_list)
 {
-    int32_t buffer_index = 0;
-    for (const auto& input_tensor_info : input_tensor_info_list) {
-        const int32_t img_width = input_tensor_info.GetWidth();
-        const int32_t img_height = input_tensor_info.GetHeight();
-        const int32_t img_channel = input_tensor_info.GetChannel();
-        if (input_tensor_info.data_type == InputTensorInfo::kDataTypeImage) {
-            if ((input_tensor_info.image_info.width != input_tensor_info.image_info.crop_width) || (input_tensor_info.image_info.height != input_tensor_info.image_info.crop_height)) {
-                PRINT_E("Crop is not supported\n");
-                return  kRetErr;
-            }
-            if ((input_tensor_info.image_info.crop_width != img_width) || (input_tensor_info.image_info.crop_height != img_height)) {
-                PRINT_E("Resize is not supported\n");
-                return  kRetErr;
-            }
-            if (input_tensor_info.image_info.channel != img_channel) {
-                PRINT_E("Color conversion is not supported\n");
-                return  kRetErr;
-            }
-
-            /* Normalize image */
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float *dst = (float*)(armnn_wrapper_->list_buffer_in_[buffer_index]);
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8) {
-                uint8_t *dst = (uint8_t*)(armnn_wrapper_->list_buffer_in_[buffer_index]);
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                int8_t *dst = (int8_t*)(armnn_wrapper_->list_buffer_in_[buffer_index]);
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else if ((input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) || (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw)) {
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float *dst = (float*)(armnn_wrapper_->list_buffer_in_[buffer_index]);
-                PreProcessBlob<float>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8 || input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                uint8_t *dst = (uint8_t*)(armnn_wrapper_->list_buffer_in_[buffer_index]);
-                PreProcessBlob<uint8_t>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt32) {
-                int32_t *dst = (int32_t*)(armnn_wrapper_->list_buffer_in_[buffer_index]);
-                PreProcessBlob<int32_t>(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else {
-            PRINT_E("Unsupported data_type (%d)\n", input_tensor_info.data_type);
-            return kRetErr;
-        }
-
-        buffer_index++;
-    }
-    return kRetOk;
+    /* Crop, resize, color conversion and normalize (image), or copy (blob) by the plan compiled at Initialize */
+    return RunPreProcessPlan(num_threads_, input_tensor_info_list);
 }
 
 int32_t InferenceHelperArmnn::Process(std::vector<OutputTensorInfo>& output_tensor_info_list)
 {
     armnn_wrapper_->Process();
     (void)output_tensor_info_list;	// no need to set output data, because the ptr to output data is already set at initialize
+    if (ConvertOutputLayout(num_threads_, false, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
 
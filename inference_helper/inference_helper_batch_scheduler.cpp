@@ -0,0 +1,258 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* for My modules */
+#include "inference_helper_log.h"
+#include "inference_helper.h"
+#include "inference_helper_batch_scheduler.h"
+
+/*** Macro ***/
+#define TAG "InferenceHelperBatchScheduler"
+#define PRINT(...)   INFERENCE_HELPER_LOG_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) INFERENCE_HELPER_LOG_PRINT_E(TAG, __VA_ARGS__)
+
+
+/*** Function ***/
+InferenceHelperBatchScheduler::InferenceHelperBatchScheduler()
+    : inference_helper_(nullptr)
+    , model_batch_(0)
+    , submit_num_(0)
+    , is_exit_(true)
+{
+}
+
+InferenceHelperBatchScheduler::~InferenceHelperBatchScheduler()
+{
+    Finalize();
+}
+
+int32_t InferenceHelperBatchScheduler::Initialize(InferenceHelper* inference_helper, const std::vector<InputTensorInfo>& input_tensor_info_list, const std::vector<OutputTensorInfo>& output_tensor_info_list, const Parameter& parameter)
+{
+    Finalize();
+    if (inference_helper == nullptr || input_tensor_info_list.empty() || parameter.max_batch < 1 || parameter.max_queue_delay_us < 0) {
+        PRINT_E("Invalid parameter (max_batch = %d, max_queue_delay_us = %d)\n", parameter.max_batch, parameter.max_queue_delay_us);
+        return InferenceHelper::kRetErr;
+    }
+    model_batch_ = input_tensor_info_list[0].GetBatch();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        if (input_tensor_info.GetBatch() != model_batch_ || model_batch_ < parameter.max_batch) {
+            PRINT_E("Batch of the model (%d) must be max_batch (%d) or larger (%s)\n", input_tensor_info.GetBatch(), parameter.max_batch, input_tensor_info.name.c_str());
+            return InferenceHelper::kRetErr;
+        }
+    }
+
+    inference_helper_ = inference_helper;
+    parameter_ = parameter;
+    input_tensor_info_list_ = input_tensor_info_list;
+    output_tensor_info_list_ = output_tensor_info_list;
+    submit_num_ = 0;
+    is_exit_ = false;
+    ResetStatistics();
+    thread_batch_ = std::thread(&InferenceHelperBatchScheduler::ThreadBatch, this);
+    return InferenceHelper::kRetOk;
+}
+
+int32_t InferenceHelperBatchScheduler::Finalize(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_exit_ = true;
+    }
+    cond_queue_.notify_all();
+    cond_done_.notify_all();
+    if (thread_batch_.joinable()) thread_batch_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.clear();
+    request_map_.clear();
+    inference_helper_ = nullptr;
+    return InferenceHelper::kRetOk;
+}
+
+int64_t InferenceHelperBatchScheduler::SubmitAsync(const std::vector<InputTensorInfo>& input_tensor_info_list)
+{
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->ret = InferenceHelper::kRetErr;
+    request->is_done = false;
+    request->result.input_tensor_info_list = input_tensor_info_list;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (is_exit_ || input_tensor_info_list.size() != input_tensor_info_list_.size()) {
+        PRINT_E("Not initialized, or the number of input tensors is different (%zu)\n", input_tensor_info_list.size());
+        return -1;
+    }
+    const int64_t handle = submit_num_++;
+    request->submit_time = std::chrono::steady_clock::now();
+    request_map_[handle] = request;
+    queue_.push_back(request);
+    lock.unlock();
+    cond_queue_.notify_one();
+    return handle;
+}
+
+bool InferenceHelperBatchScheduler::Poll(int64_t handle)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = request_map_.find(handle);
+    return it != request_map_.end() && it->second->is_done;
+}
+
+int32_t InferenceHelperBatchScheduler::Wait(int64_t handle, Result& result)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto it = request_map_.find(handle);
+    if (it == request_map_.end()) {
+        PRINT_E("Invalid handle (%lld)\n", static_cast<long long>(handle));
+        return InferenceHelper::kRetErr;
+    }
+    std::shared_ptr<Request> request = it->second;
+    cond_done_.wait(lock, [&] { return is_exit_ || request->is_done; });
+    if (!request->is_done || request_map_.erase(handle) == 0) {
+        PRINT_E("Request is discarded (%lld)\n", static_cast<long long>(handle));
+        return InferenceHelper::kRetErr;
+    }
+    result = std::move(request->result);
+    return request->ret;
+}
+
+InferenceHelperBatchScheduler::Statistics InferenceHelperBatchScheduler::GetStatistics(void)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statistics_;
+}
+
+void InferenceHelperBatchScheduler::ResetStatistics(void)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    statistics_.batch_size_histogram.assign(parameter_.max_batch + 1, 0);
+    statistics_.queue_delay_histogram.assign(kQueueDelayHistogramSize, 0);
+}
+
+void InferenceHelperBatchScheduler::PrintStatistics(void)
+{
+    const Statistics statistics = GetStatistics();
+    PRINT("Batch size:\n");
+    for (size_t i = 1; i < statistics.batch_size_histogram.size(); i++) {
+        PRINT("  %2zu: %lld\n", i, static_cast<long long>(statistics.batch_size_histogram[i]));
+    }
+    PRINT("Queue delay:\n");
+    for (size_t i = 0; i < statistics.queue_delay_histogram.size(); i++) {
+        if (statistics.queue_delay_histogram[i] == 0) continue;
+        PRINT("  < %lld us: %lld\n", 1LL << i, static_cast<long long>(statistics.queue_delay_histogram[i]));
+    }
+}
+
+void InferenceHelperBatchScheduler::ThreadBatch(void)
+{
+    std::vector<std::shared_ptr<Request>> request_list;
+    while (true) {
+        request_list.clear();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_queue_.wait(lock, [&] { return is_exit_ || !queue_.empty(); });
+            if (is_exit_) return;
+
+            /* Wait for max_batch requests until the deadline of the oldest one */
+            const auto deadline = queue_.front()->submit_time + std::chrono::microseconds(parameter_.max_queue_delay_us);
+            cond_queue_.wait_until(lock, deadline, [&] { return is_exit_ || static_cast<int32_t>(queue_.size()) >= parameter_.max_batch; });
+            if (is_exit_) return;
+
+            const auto now = std::chrono::steady_clock::now();
+            const int32_t batch = (std::min)(static_cast<int32_t>(queue_.size()), parameter_.max_batch);
+            for (int32_t i = 0; i < batch; i++) {
+                request_list.push_back(queue_.front());
+                queue_.pop_front();
+                const int64_t delay_us = std::chrono::duration_cast<std::chrono::microseconds>(now - request_list.back()->submit_time).count();
+                int32_t bucket = 0;
+                while (bucket < kQueueDelayHistogramSize - 1 && (delay_us >> bucket) > 0) bucket++;
+                statistics_.queue_delay_histogram[bucket]++;
+            }
+            statistics_.batch_size_histogram[batch]++;
+        }
+
+        ProcessBatch(request_list);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& request : request_list) {
+                request->is_done = true;
+            }
+        }
+        cond_done_.notify_all();
+    }
+}
+
+void InferenceHelperBatchScheduler::ProcessBatch(std::vector<std::shared_ptr<Request>>& request_list)
+{
+    /* Each request is a batch slot. Slots not used in a partial batch keep the data of the previous batch */
+    const int32_t batch = static_cast<int32_t>(request_list.size());
+    for (size_t t = 0; t < input_tensor_info_list_.size(); t++) {
+        auto& batch_list = input_tensor_info_list_[t].batch_list;
+        batch_list.resize(batch);
+        for (int32_t i = 0; i < batch; i++) {
+            const auto& input_tensor_info = request_list[i]->result.input_tensor_info_list[t];
+            batch_list[i].data = input_tensor_info.data;
+            batch_list[i].image_info = input_tensor_info.image_info;
+        }
+    }
+
+    int32_t ret = inference_helper_->PreProcess(input_tensor_info_list_);
+    if (ret == InferenceHelper::kRetOk) {
+        ret = inference_helper_->Process(output_tensor_info_list_);
+    }
+    for (int32_t i = 0; i < batch; i++) {
+        Request& request = *request_list[i];
+        request.ret = ret;
+        if (ret != InferenceHelper::kRetOk) continue;
+        for (size_t t = 0; t < input_tensor_info_list_.size(); t++) {
+            request.result.input_tensor_info_list[t].image_transform = input_tensor_info_list_[t].batch_list[i].image_transform;
+        }
+        ScatterOutput(i, request.result);
+    }
+}
+
+/* Copy the slice of the batch slot */
+void InferenceHelperBatchScheduler::ScatterOutput(int32_t batch, Result& result)
+{
+    result.output_tensor_info_list = output_tensor_info_list_;
+    result.buffer_list.resize(output_tensor_info_list_.size());
+    for (size_t i = 0; i < output_tensor_info_list_.size(); i++) {
+        auto& output_tensor_info = result.output_tensor_info_list[i];
+        if (output_tensor_info.data == nullptr) continue;
+        const uint8_t* src = static_cast<const uint8_t*>(output_tensor_info.data);
+        int32_t size = output_tensor_info.GetByteSize();
+        if (output_tensor_info.GetBatch() == model_batch_) {
+            size /= model_batch_;
+            src += static_cast<size_t>(size) * batch;
+            output_tensor_info.tensor_dims[0] = 1;
+        }
+        auto& buffer = result.buffer_list[i];
+        buffer.assign(src, src + size);
+        output_tensor_info.data = buffer.data();
+    }
+}
@@ -0,0 +1,112 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef INFERENCE_HELPER_BATCH_SCHEDULER_
+#define INFERENCE_HELPER_BATCH_SCHEDULER_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* for My modules */
+#include "inference_helper.h"
+#include "inference_helper_pool.h"
+
+/* Dynamic batching in front of an initialized InferenceHelper whose batch size (N of input tensors) is max_batch
+ * Single requests are collected, and a batch is run when max_batch requests are queued, or max_queue_delay passed since the oldest one was queued
+ * Each request is one batch slot (InputTensorInfo::batch_list), so pre-process and Process run once for the batch
+ * The output of each request is the slice of its batch slot (N = 1). Outputs without N dimension (N != max_batch) are copied as they are
+ * SubmitAsync, Poll and Wait can be called from any thread
+ */
+class InferenceHelperBatchScheduler {
+public:
+    typedef InferenceHelperPool::Result Result;
+
+    struct Parameter {
+        Parameter()
+            : max_batch(8)
+            , max_queue_delay_us(2000)
+        {}
+
+        int32_t max_batch;
+        int32_t max_queue_delay_us;
+    };
+
+    struct Statistics {
+        std::vector<int64_t> batch_size_histogram;      // [n]: the number of batches of size n (0 - max_batch)
+        std::vector<int64_t> queue_delay_histogram;     // [i]: the number of requests which waited for [2^(i-1), 2^i) us in the queue ([0]: < 1 us). The last one includes longer delays
+    };
+
+    static constexpr int32_t kQueueDelayHistogramSize = 24;
+
+public:
+    InferenceHelperBatchScheduler();
+    ~InferenceHelperBatchScheduler();
+    /* inference_helper must be initialized (not owned) with tensor info lists whose N is parameter.max_batch (or larger). The lists are the ones used for Initialize */
+    int32_t Initialize(InferenceHelper* inference_helper, const std::vector<InputTensorInfo>& input_tensor_info_list, const std::vector<OutputTensorInfo>& output_tensor_info_list, const Parameter& parameter);
+    /* Requests not processed yet are discarded */
+    int32_t Finalize(void);
+
+    /* Returns handle of the request (>= 0), or -1 for error. Every handle must be waited
+     * input_tensor_info_list is for one image (blob) of each input tensor (batch_list is not used). The data must be kept until the request is done
+     */
+    int64_t SubmitAsync(const std::vector<InputTensorInfo>& input_tensor_info_list);
+    /* true if the request is done (Wait doesn't block) */
+    bool Poll(int64_t handle);
+    /* Wait for the request and get the result. Returns kRetErr if PreProcess or Process failed, or handle is unknown */
+    int32_t Wait(int64_t handle, Result& result);
+
+    Statistics GetStatistics(void);
+    void ResetStatistics(void);
+    void PrintStatistics(void);
+
+private:
+    struct Request {
+        int32_t ret;
+        bool    is_done;
+        std::chrono::steady_clock::time_point submit_time;
+        Result  result;
+    };
+
+    void ThreadBatch(void);
+    void ProcessBatch(std::vector<std::shared_ptr<Request>>& request_list);
+    void ScatterOutput(int32_t batch, Result& result);
+
+private:
+    InferenceHelper* inference_helper_;
+    Parameter parameter_;
+    std::vector<InputTensorInfo> input_tensor_info_list_;       // batched input (batch_list is set for each batch)
+    std::vector<OutputTensorInfo> output_tensor_info_list_;     // used for Process
+    int32_t model_batch_;
+
+    std::deque<std::shared_ptr<Request>> queue_;
+    std::unordered_map<int64_t, std::shared_ptr<Request>> request_map_;    // requests not waited yet
+    int64_t submit_num_;
+    Statistics statistics_;
+    bool is_exit_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_queue_;    // a request is queued
+    std::condition_variable cond_done_;     // a request is done
+    std::thread thread_batch_;
+};
+
+#endif
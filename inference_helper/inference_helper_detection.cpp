@@ -0,0 +1,358 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+/* for My modules */
+#include "inference_helper_log.h"
+#include "inference_helper.h"
+#include "inference_helper_kernel.h"
+#include "inference_helper_detection.h"
+
+/*** Macro ***/
+#define TAG "DetectionPostProcess"
+#define PRINT(...)   INFERENCE_HELPER_LOG_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) INFERENCE_HELPER_LOG_PRINT_E(TAG, __VA_ARGS__)
+
+namespace InferenceHelperPostProcess {
+
+/*** Function ***/
+/* Value of the tensor as float (dequantized) */
+static float ToFloat(const OutputTensorInfo&, float value)
+{
+    return value;
+}
+
+template<typename T>
+static float ToFloat(const OutputTensorInfo& tensor, T value)
+{
+    return (value - tensor.quant.zero_point) * tensor.quant.scale;
+}
+
+static float GetValue(const OutputTensorInfo& tensor, int32_t index)
+{
+    switch (tensor.tensor_type) {
+    case TensorInfo::kTensorTypeFp32:
+        return static_cast<const float*>(tensor.data)[index];
+    case TensorInfo::kTensorTypeUint8:
+        return ToFloat(tensor, static_cast<const uint8_t*>(tensor.data)[index]);
+    case TensorInfo::kTensorTypeInt8:
+        return ToFloat(tensor, static_cast<const int8_t*>(tensor.data)[index]);
+    default:
+        return 0.0f;
+    }
+}
+
+/* Threshold to compare raw data directly (quantized value for quantized tensor) */
+static float RawThreshold(const OutputTensorInfo&, const float*, float threshold)
+{
+    return threshold;
+}
+
+template<typename T>
+static int32_t RawThreshold(const OutputTensorInfo& tensor, const T*, float threshold)
+{
+    if (threshold == -std::numeric_limits<float>::infinity()) return (std::numeric_limits<int32_t>::min)();
+    if (threshold == std::numeric_limits<float>::infinity()) return (std::numeric_limits<int32_t>::max)();
+    return tensor.QuantizeThreshold(threshold);
+}
+
+static float Activate(int32_t activation, float value)
+{
+    if (activation == DetectionPostProcess::kScoreActivationSigmoid) {
+        return 1.0f / (1.0f + std::exp(-value));
+    }
+    return value;
+}
+
+/* The inverse of Activate, so that threshold is applied before activation */
+static float InverseActivate(int32_t activation, float value)
+{
+    if (activation == DetectionPostProcess::kScoreActivationSigmoid) {
+        if (value <= 0.0f) return -std::numeric_limits<float>::infinity();
+        if (value >= 1.0f) return std::numeric_limits<float>::infinity();
+        return std::log(value / (1.0f - value));
+    }
+    return value;
+}
+
+static bool IsSupportedTensor(const OutputTensorInfo& tensor)
+{
+    if (tensor.data == nullptr || tensor.tensor_dims.empty()) {
+        PRINT_E("Data is not set (%s)\n", tensor.name.c_str());
+        return false;
+    }
+    if (tensor.tensor_type != TensorInfo::kTensorTypeFp32 && tensor.tensor_type != TensorInfo::kTensorTypeUint8 && tensor.tensor_type != TensorInfo::kTensorTypeInt8) {
+        PRINT_E("Unsupported tensor type (%s, %d)\n", tensor.name.c_str(), tensor.tensor_type);
+        return false;
+    }
+    if (tensor.tensor_type != TensorInfo::kTensorTypeFp32 && tensor.quant.axis >= 0 && !tensor.quant.scale_list.empty()) {
+        PRINT_E("Per axis quantization is not supported (%s)\n", tensor.name.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+DetectionPostProcess::DetectionPostProcess()
+{
+}
+
+DetectionPostProcess::~DetectionPostProcess()
+{
+}
+
+int32_t DetectionPostProcess::Initialize(const Parameter& parameter)
+{
+    parameter_ = parameter;
+    grid_list_.clear();
+
+    if (parameter_.class_num <= 0 || parameter_.max_candidate_num <= 0 || parameter_.max_detection_num <= 0) {
+        PRINT_E("Invalid parameter (class_num = %d, max_candidate_num = %d, max_detection_num = %d)\n", parameter_.class_num, parameter_.max_candidate_num, parameter_.max_detection_num);
+        return InferenceHelper::kRetErr;
+    }
+    if (parameter_.box_decode == kBoxDecodeAnchor && parameter_.anchor_list.empty()) {
+        PRINT_E("anchor_list is empty\n");
+        return InferenceHelper::kRetErr;
+    }
+    if (parameter_.box_decode == kBoxDecodeGrid) {
+        if (parameter_.stride_list.empty() || parameter_.input_width <= 0 || parameter_.input_height <= 0) {
+            PRINT_E("stride_list and input size are needed for grid\n");
+            return InferenceHelper::kRetErr;
+        }
+        for (const auto& stride : parameter_.stride_list) {
+            if (stride <= 0) {
+                PRINT_E("Invalid stride (%d)\n", stride);
+                return InferenceHelper::kRetErr;
+            }
+            const int32_t grid_width = parameter_.input_width / stride;
+            const int32_t grid_height = parameter_.input_height / stride;
+            for (int32_t y = 0; y < grid_height; y++) {
+                for (int32_t x = 0; x < grid_width; x++) {
+                    grid_list_.push_back({ static_cast<float>(x), static_cast<float>(y), static_cast<float>(stride) });
+                }
+            }
+        }
+    }
+
+    candidate_list_.reserve(parameter_.max_candidate_num);
+    candidate_bbox_list_.reserve(parameter_.max_candidate_num);
+    box_x0_.reserve(parameter_.max_candidate_num);
+    box_y0_.reserve(parameter_.max_candidate_num);
+    box_x1_.reserve(parameter_.max_candidate_num);
+    box_y1_.reserve(parameter_.max_candidate_num);
+    box_area_.reserve(parameter_.max_candidate_num);
+    suppressed_.reserve(parameter_.max_candidate_num);
+    return InferenceHelper::kRetOk;
+}
+
+template<typename T>
+void DetectionPostProcess::CollectCandidate(const OutputTensorInfo& score_tensor, const T* score, int32_t row_num, int32_t row_size, float threshold_raw)
+{
+    /* Raw values are compared with the threshold before dequantization and activation
+     * Scores after activation are assumed to be in [0, 1], so objectness * class score >= threshold requires both >= threshold
+     */
+    const auto threshold = RawThreshold(score_tensor, score, threshold_raw);
+    const int32_t activation = parameter_.score_activation;
+    for (int32_t n = 0; n < row_num; n++) {
+        const T* row = score + n * row_size;
+        float objectness = 1.0f;
+        if (parameter_.objectness_offset >= 0) {
+            if (!(row[parameter_.objectness_offset] >= threshold)) continue;
+            objectness = Activate(activation, ToFloat(score_tensor, row[parameter_.objectness_offset]));
+        }
+        const T* class_score = row + parameter_.score_offset;
+        if (parameter_.is_multi_label) {
+            for (int32_t c = 0; c < parameter_.class_num; c++) {
+                if (!(class_score[c] >= threshold)) continue;
+                const float s = objectness * Activate(activation, ToFloat(score_tensor, class_score[c]));
+                if (s >= parameter_.score_threshold) {
+                    candidate_list_.push_back({ n, c, s });
+                }
+            }
+        } else {
+            int32_t class_id = 0;
+            for (int32_t c = 1; c < parameter_.class_num; c++) {
+                if (class_score[c] > class_score[class_id]) class_id = c;
+            }
+            if (!(class_score[class_id] >= threshold)) continue;
+            const float s = objectness * Activate(activation, ToFloat(score_tensor, class_score[class_id]));
+            if (s >= parameter_.score_threshold) {
+                candidate_list_.push_back({ n, class_id, s });
+            }
+        }
+    }
+}
+
+void DetectionPostProcess::DecodeBox(const OutputTensorInfo& box_tensor, int32_t row_size, const Candidate& candidate, float* box) const
+{
+    const int32_t index = candidate.index * row_size + parameter_.box_offset;
+    const float v0 = GetValue(box_tensor, index + 0);
+    const float v1 = GetValue(box_tensor, index + 1);
+    const float v2 = GetValue(box_tensor, index + 2);
+    const float v3 = GetValue(box_tensor, index + 3);
+
+    float cx, cy, w, h;
+    switch (parameter_.box_decode) {
+    case kBoxDecodeAnchor:
+    {
+        const Anchor& anchor = parameter_.anchor_list[candidate.index];
+        cx = anchor.cx + v0 * parameter_.variance[0] * anchor.w;
+        cy = anchor.cy + v1 * parameter_.variance[1] * anchor.h;
+        w = anchor.w * std::exp(v2 * parameter_.variance[2]);
+        h = anchor.h * std::exp(v3 * parameter_.variance[3]);
+        break;
+    }
+    case kBoxDecodeGrid:
+    {
+        const Grid& grid = grid_list_[candidate.index];
+        cx = (v0 + grid.x) * grid.stride;
+        cy = (v1 + grid.y) * grid.stride;
+        w = std::exp(v2) * grid.stride;
+        h = std::exp(v3) * grid.stride;
+        break;
+    }
+    case kBoxDecodeNone:
+    default:
+        if (parameter_.box_format == kBoxFormatCorner) {
+            box[0] = v0 * parameter_.box_scale_x;
+            box[1] = v1 * parameter_.box_scale_y;
+            box[2] = v2 * parameter_.box_scale_x;
+            box[3] = v3 * parameter_.box_scale_y;
+            return;
+        }
+        cx = v0;
+        cy = v1;
+        w = v2;
+        h = v3;
+        break;
+    }
+    box[0] = (cx - w * 0.5f) * parameter_.box_scale_x;
+    box[1] = (cy - h * 0.5f) * parameter_.box_scale_y;
+    box[2] = (cx + w * 0.5f) * parameter_.box_scale_x;
+    box[3] = (cy + h * 0.5f) * parameter_.box_scale_y;
+}
+
+int32_t DetectionPostProcess::Process(const OutputTensorInfo& box_tensor, const OutputTensorInfo& score_tensor, std::vector<BoundingBox>& bbox_list)
+{
+    bbox_list.clear();
+    if (!IsSupportedTensor(box_tensor) || !IsSupportedTensor(score_tensor)) {
+        return InferenceHelper::kRetErr;
+    }
+    const int32_t box_row_size = box_tensor.tensor_dims.back();
+    const int32_t score_row_size = score_tensor.tensor_dims.back();
+    const int32_t row_num = (box_row_size > 0) ? box_tensor.GetElementNum() / box_row_size : 0;
+    if (parameter_.box_offset + 4 > box_row_size || parameter_.score_offset + parameter_.class_num > score_row_size || parameter_.objectness_offset >= score_row_size
+        || score_tensor.GetElementNum() / score_row_size != row_num) {
+        PRINT_E("Tensor size doesn't match the parameter (%s, %s)\n", box_tensor.name.c_str(), score_tensor.name.c_str());
+        return InferenceHelper::kRetErr;
+    }
+    if ((parameter_.box_decode == kBoxDecodeAnchor && static_cast<int32_t>(parameter_.anchor_list.size()) != row_num)
+        || (parameter_.box_decode == kBoxDecodeGrid && static_cast<int32_t>(grid_list_.size()) != row_num)) {
+        PRINT_E("The number of anchors is different from the tensor (%d)\n", row_num);
+        return InferenceHelper::kRetErr;
+    }
+
+    /* Score filter */
+    candidate_list_.clear();
+    const float threshold_raw = InverseActivate(parameter_.score_activation, parameter_.score_threshold);
+    switch (score_tensor.tensor_type) {
+    case TensorInfo::kTensorTypeFp32:
+        CollectCandidate(score_tensor, static_cast<const float*>(score_tensor.data), row_num, score_row_size, threshold_raw);
+        break;
+    case TensorInfo::kTensorTypeUint8:
+        CollectCandidate(score_tensor, static_cast<const uint8_t*>(score_tensor.data), row_num, score_row_size, threshold_raw);
+        break;
+    case TensorInfo::kTensorTypeInt8:
+        CollectCandidate(score_tensor, static_cast<const int8_t*>(score_tensor.data), row_num, score_row_size, threshold_raw);
+        break;
+    default:
+        break;
+    }
+
+    /* Keep the best candidates in score order (the smaller row first for ties) */
+    auto higher = [](const Candidate& a, const Candidate& b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (a.index != b.index) return a.index < b.index;
+        return a.class_id < b.class_id;
+    };
+    if (static_cast<int32_t>(candidate_list_.size()) > parameter_.max_candidate_num) {
+        std::nth_element(candidate_list_.begin(), candidate_list_.begin() + parameter_.max_candidate_num, candidate_list_.end(), higher);
+        candidate_list_.resize(parameter_.max_candidate_num);
+    }
+    std::sort(candidate_list_.begin(), candidate_list_.end(), higher);
+
+    /* Decode boxes of candidates only */
+    const int32_t candidate_num = static_cast<int32_t>(candidate_list_.size());
+    candidate_bbox_list_.resize(candidate_num);
+    for (int32_t i = 0; i < candidate_num; i++) {
+        float box[4];
+        DecodeBox(box_tensor, box_row_size, candidate_list_[i], box);
+        candidate_bbox_list_[i] = { candidate_list_[i].class_id, candidate_list_[i].score, box[0], box[1], box[2], box[3] };
+    }
+
+    Nms(bbox_list);
+    return InferenceHelper::kRetOk;
+}
+
+void DetectionPostProcess::Nms(std::vector<BoundingBox>& bbox_list)
+{
+    const int32_t candidate_num = static_cast<int32_t>(candidate_bbox_list_.size());
+
+    /* Per class NMS is done at once by shifting boxes of each class so that they never overlap with other classes */
+    float class_offset = 0.0f;
+    if (parameter_.nms == kNmsPerClass) {
+        float max_coordinate = 0.0f;
+        for (const auto& bbox : candidate_bbox_list_) {
+            max_coordinate = (std::max)(max_coordinate, (std::max)((std::max)(std::fabs(bbox.x0), std::fabs(bbox.x1)), (std::max)(std::fabs(bbox.y0), std::fabs(bbox.y1))));
+        }
+        class_offset = 2.0f * max_coordinate + 1.0f;
+    }
+    box_x0_.resize(candidate_num);
+    box_y0_.resize(candidate_num);
+    box_x1_.resize(candidate_num);
+    box_y1_.resize(candidate_num);
+    box_area_.resize(candidate_num);
+    for (int32_t i = 0; i < candidate_num; i++) {
+        const auto& bbox = candidate_bbox_list_[i];
+        const float offset = bbox.class_id * class_offset;
+        box_x0_[i] = bbox.x0 + offset;
+        box_y0_[i] = bbox.y0 + offset;
+        box_x1_[i] = bbox.x1 + offset;
+        box_y1_[i] = bbox.y1 + offset;
+        box_area_[i] = (bbox.x1 - bbox.x0) * (bbox.y1 - bbox.y0);
+    }
+
+    suppressed_.assign(candidate_num, 0);
+    for (int32_t i = 0; i < candidate_num; i++) {
+        if (suppressed_[i]) continue;
+        bbox_list.push_back(candidate_bbox_list_[i]);
+        if (static_cast<int32_t>(bbox_list.size()) >= parameter_.max_detection_num) break;
+
+        const float box[5] = { box_x0_[i], box_y0_[i], box_x1_[i], box_y1_[i], box_area_[i] };
+        const int32_t next = i + 1;
+        InferenceHelperKernel::SuppressOverlap(box_x0_.data() + next, box_y0_.data() + next, box_x1_.data() + next, box_y1_.data() + next, box_area_.data() + next,
+            candidate_num - next, box, parameter_.iou_threshold, suppressed_.data() + next);
+    }
+}
+
+}
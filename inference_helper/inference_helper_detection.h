@@ -0,0 +1,154 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef INFERENCE_HELPER_DETECTION_
+#define INFERENCE_HELPER_DETECTION_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* for My modules */
+#include "inference_helper.h"
+
+namespace InferenceHelperPostProcess {
+
+/* Box decode + score filter + NMS for object detection models (SSD, YOLO, etc.)
+ * Box tensor and score tensor are seen as [N, row] (the last dimension is row. batch 0 is used). They can be the same tensor (e.g. YOLO [1, N, 5 + class])
+ * Anchors (grids) are calculated at Initialize, and buffers are reused, so that Process doesn't allocate memory in steady state
+ */
+class DetectionPostProcess {
+public:
+    enum {
+        kBoxDecodeNone,     // box is (cx, cy, w, h) or (x0, y0, x1, y1) already
+        kBoxDecodeAnchor,   // SSD: cx = anchor.cx + box[0] * variance[0] * anchor.w, w = anchor.w * exp(box[2] * variance[2]) (y, h as well)
+        kBoxDecodeGrid,     // anchor free (e.g. YOLOX): cx = (box[0] + grid_x) * stride, w = exp(box[2]) * stride (y, h as well)
+    };
+
+    enum {
+        kBoxFormatCenter,   // (cx, cy, w, h)
+        kBoxFormatCorner,   // (x0, y0, x1, y1). Used only for kBoxDecodeNone
+    };
+
+    enum {
+        kScoreActivationNone,
+        kScoreActivationSigmoid,
+    };
+
+    enum {
+        kNmsPerClass,       // boxes of different classes don't suppress each other
+        kNmsClassAgnostic,  // all boxes are processed together
+    };
+
+    struct Anchor {
+        float cx;
+        float cy;
+        float w;
+        float h;
+    };
+
+    struct Parameter {
+        Parameter()
+            : box_decode(kBoxDecodeNone)
+            , box_format(kBoxFormatCenter)
+            , box_offset(0)
+            , class_num(0)
+            , score_offset(0)
+            , objectness_offset(-1)
+            , score_activation(kScoreActivationNone)
+            , score_threshold(0.5f)
+            , iou_threshold(0.5f)
+            , nms(kNmsPerClass)
+            , is_multi_label(false)
+            , max_candidate_num(1000)
+            , max_detection_num(100)
+            , variance{ 1.0f, 1.0f, 1.0f, 1.0f }
+            , input_width(0)
+            , input_height(0)
+            , box_scale_x(1.0f)
+            , box_scale_y(1.0f)
+        {}
+
+        int32_t box_decode;
+        int32_t box_format;
+        int32_t box_offset;             // index of the box (4 values) in a row of box tensor
+        int32_t class_num;
+        int32_t score_offset;           // index of the first class score in a row of score tensor
+        int32_t objectness_offset;      // index of objectness in a row of score tensor. score = objectness * class score. -1: not used
+        int32_t score_activation;       // applied to class score and objectness
+        float   score_threshold;
+        float   iou_threshold;
+        int32_t nms;
+        bool    is_multi_label;         // true: all classes over threshold are candidates, false: only the best class of each row
+        int32_t max_candidate_num;      // candidates with the highest scores are kept for NMS
+        int32_t max_detection_num;
+        float   variance[4];                // kBoxDecodeAnchor
+        std::vector<Anchor>  anchor_list;   // kBoxDecodeAnchor. size = N
+        std::vector<int32_t> stride_list;   // kBoxDecodeGrid. Grids of (input_width / stride) x (input_height / stride) for each stride in this order
+        int32_t input_width;                // kBoxDecodeGrid
+        int32_t input_height;               // kBoxDecodeGrid
+        float   box_scale_x;            // decoded box is multiplied by this (e.g. input width for normalized box)
+        float   box_scale_y;
+    };
+
+    struct BoundingBox {
+        int32_t class_id;
+        float   score;
+        float   x0;
+        float   y0;
+        float   x1;
+        float   y1;
+    };
+
+public:
+    DetectionPostProcess();
+    ~DetectionPostProcess();
+    int32_t Initialize(const Parameter& parameter);
+    /* box_tensor and score_tensor can be the same. Boxes are sorted by score (higher first) */
+    int32_t Process(const OutputTensorInfo& box_tensor, const OutputTensorInfo& score_tensor, std::vector<BoundingBox>& bbox_list);
+
+private:
+    struct Candidate {
+        int32_t index;      // row
+        int32_t class_id;
+        float   score;
+    };
+    struct Grid {
+        float x;
+        float y;
+        float stride;
+    };
+
+    template<typename T> void CollectCandidate(const OutputTensorInfo& score_tensor, const T* score, int32_t row_num, int32_t row_size, float threshold_raw);
+    void DecodeBox(const OutputTensorInfo& box_tensor, int32_t row_size, const Candidate& candidate, float* box) const;
+    void Nms(std::vector<BoundingBox>& bbox_list);
+
+private:
+    Parameter parameter_;
+    std::vector<Grid> grid_list_;
+
+    /* Work buffers reused for every frame */
+    std::vector<Candidate>   candidate_list_;
+    std::vector<BoundingBox> candidate_bbox_list_;
+    std::vector<float>       box_x0_;           // boxes for NMS (shifted for each class in kNmsPerClass)
+    std::vector<float>       box_y0_;
+    std::vector<float>       box_x1_;
+    std::vector<float>       box_y1_;
+    std::vector<float>       box_area_;
+    std::vector<uint8_t>     suppressed_;
+};
+
+}
+
+#endif
@@ -0,0 +1,2117 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+
+/* for SIMD */
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define INFERENCE_HELPER_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSE41
+#define TARGET_AVX2
+#define TARGET_F16C
+#else
+#include <cpuid.h>
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2  __attribute__((target("avx2")))
+#define TARGET_F16C  __attribute__((target("avx2,f16c")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define INFERENCE_HELPER_KERNEL_NEON
+#include <arm_neon.h>
+#if defined(__aarch64__) || (defined(__ARM_FP) && (__ARM_FP & 2))
+#define INFERENCE_HELPER_KERNEL_NEON_FP16
+#endif
+#endif
+
+/* for My modules */
+#include "inference_helper_kernel.h"
+
+namespace InferenceHelperKernel {
+
+/*** CPU feature ***/
+static int32_t DetectSimdLevel()
+{
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+#ifdef _MSC_VER
+    int32_t info[4];
+    __cpuid(info, 0);
+    const int32_t max_id = info[0];
+    __cpuid(info, 1);
+    const bool has_sse41 = (info[2] & (1 << 19)) != 0;
+    const bool has_avx = (info[2] & (1 << 28)) != 0;
+    const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+    bool has_avx2 = false;
+    if (max_id >= 7 && has_avx && has_osxsave && ((_xgetbv(0) & 0x06) == 0x06)) {
+        __cpuidex(info, 7, 0);
+        has_avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    const bool has_sse41 = __builtin_cpu_supports("sse4.1");
+    const bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (has_avx2) return kSimdAvx2;
+    if (has_sse41) return kSimdSse41;
+    return kSimdNone;
+#elif defined(INFERENCE_HELPER_KERNEL_NEON)
+    return kSimdNeon;
+#else
+    return kSimdNone;
+#endif
+}
+
+static int32_t GetDetectedSimdLevel()
+{
+    static const int32_t detected_simd_level = DetectSimdLevel();
+    return detected_simd_level;
+}
+
+static std::atomic<int32_t> s_simd_level_limit(kSimdNeon);
+
+/* F16C (fp16 <-> fp32 conversion) is used with AVX2 */
+static bool HasF16c()
+{
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    static const bool has_f16c = []() {
+#ifdef _MSC_VER
+        int32_t info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 29)) != 0;
+#else
+        uint32_t eax, ebx, ecx, edx;
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) return false;
+        return (ecx & (1u << 29)) != 0;
+#endif
+    }();
+    return has_f16c;
+#else
+    return false;
+#endif
+}
+
+int32_t GetSimdLevel()
+{
+    return (std::min)(GetDetectedSimdLevel(), s_simd_level_limit.load(std::memory_order_relaxed));
+}
+
+void SetSimdLevel(int32_t simd_level)
+{
+    s_simd_level_limit.store(simd_level, std::memory_order_relaxed);
+}
+
+
+/*** Normalize (uint8 -> float) ***/
+/* Scalar code (reference and fallback). kChannel > 0: channel is fixed at compile time so that the inner loop is unrolled, 0: channel is used */
+template<int32_t kChannel>
+static void NormalizeInterleavedScalarImpl(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* dst)
+{
+    const int32_t ch = (kChannel > 0) ? kChannel : channel;
+    for (int32_t i = 0; i < num; i++) {
+        for (int32_t c = 0; c < ch; c++) {
+            dst[i * ch + c] = (src[i * ch + c] - mean[c]) * norm[c];
+        }
+    }
+}
+
+template<int32_t kChannel>
+static void NormalizePlanarScalarImpl(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* const* dst_plane)
+{
+    const int32_t ch = (kChannel > 0) ? kChannel : channel;
+    for (int32_t c = 0; c < ch; c++) {
+        float* dst = dst_plane[c];
+        for (int32_t i = 0; i < num; i++) {
+            dst[i] = (src[i * ch + c] - mean[c]) * norm[c];
+        }
+    }
+}
+
+static void NormalizeInterleavedScalar(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* dst)
+{
+    switch (channel) {
+    case 1:
+        NormalizeInterleavedScalarImpl<1>(src, channel, num, mean, norm, dst);
+        break;
+    case 3:
+        NormalizeInterleavedScalarImpl<3>(src, channel, num, mean, norm, dst);
+        break;
+    case 4:
+        NormalizeInterleavedScalarImpl<4>(src, channel, num, mean, norm, dst);
+        break;
+    default:
+        NormalizeInterleavedScalarImpl<0>(src, channel, num, mean, norm, dst);
+        break;
+    }
+}
+
+static void NormalizePlanarScalar(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* const* dst_plane)
+{
+    switch (channel) {
+    case 1:
+        NormalizePlanarScalarImpl<1>(src, channel, num, mean, norm, dst_plane);
+        break;
+    case 3:
+        NormalizePlanarScalarImpl<3>(src, channel, num, mean, norm, dst_plane);
+        break;
+    case 4:
+        NormalizePlanarScalarImpl<4>(src, channel, num, mean, norm, dst_plane);
+        break;
+    default:
+        NormalizePlanarScalarImpl<0>(src, channel, num, mean, norm, dst_plane);
+        break;
+    }
+}
+
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+/* Shuffle masks to gather one channel from 16 pixels (48 bytes = 3 blocks) of RGB / BGR */
+alignas(16) static const int8_t kDeinterleave3Mask[3][3][16] = {
+    {
+        { 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+        { -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 },
+    },
+    {
+        { 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+        { -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 },
+    },
+    {
+        { 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+        { -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1 },
+        { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15 },
+    },
+};
+
+TARGET_SSE41 static inline __m128i Deinterleave3(__m128i block0, __m128i block1, __m128i block2, int32_t c)
+{
+    __m128i ret = _mm_shuffle_epi8(block0, _mm_load_si128(reinterpret_cast<const __m128i*>(kDeinterleave3Mask[c][0])));
+    ret = _mm_or_si128(ret, _mm_shuffle_epi8(block1, _mm_load_si128(reinterpret_cast<const __m128i*>(kDeinterleave3Mask[c][1]))));
+    ret = _mm_or_si128(ret, _mm_shuffle_epi8(block2, _mm_load_si128(reinterpret_cast<const __m128i*>(kDeinterleave3Mask[c][2]))));
+    return ret;
+}
+
+/* SSE4.1 */
+TARGET_SSE41 static inline void Normalize16Sse41(__m128i v, __m128 mean0, __m128 mean1, __m128 mean2, __m128 mean3, __m128 norm0, __m128 norm1, __m128 norm2, __m128 norm3, float* dst)
+{
+    __m128 f0 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(v));
+    __m128 f1 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4)));
+    __m128 f2 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+    __m128 f3 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12)));
+    _mm_storeu_ps(dst + 0, _mm_mul_ps(_mm_sub_ps(f0, mean0), norm0));
+    _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_sub_ps(f1, mean1), norm1));
+    _mm_storeu_ps(dst + 8, _mm_mul_ps(_mm_sub_ps(f2, mean2), norm2));
+    _mm_storeu_ps(dst + 12, _mm_mul_ps(_mm_sub_ps(f3, mean3), norm3));
+}
+
+TARGET_SSE41 static void NormalizeInterleavedSse41(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* dst)
+{
+    /* The channel pattern of 4 lanes repeats every 3 vectors (channel = 3) or every vector (channel = 1, 4) */
+    const int32_t period = (channel == 3) ? 3 : 1;
+    __m128 mean_vec[3];
+    __m128 norm_vec[3];
+    for (int32_t p = 0; p < period; p++) {
+        alignas(16) float m[4];
+        alignas(16) float n[4];
+        for (int32_t lane = 0; lane < 4; lane++) {
+            m[lane] = mean[(p * 4 + lane) % channel];
+            n[lane] = norm[(p * 4 + lane) % channel];
+        }
+        mean_vec[p] = _mm_load_ps(m);
+        norm_vec[p] = _mm_load_ps(n);
+    }
+
+    const int32_t total = num * channel;
+    const int32_t block = 16 * period;
+    int32_t i = 0;
+    for (; i + block <= total; i += block) {
+        for (int32_t b = 0; b < period; b++) {
+            /* vector index in the block is 4 * b + k, so the pattern index is (4 * b + k) % period */
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + b * 16));
+            const int32_t p0 = (4 * b + 0) % period;
+            const int32_t p1 = (4 * b + 1) % period;
+            const int32_t p2 = (4 * b + 2) % period;
+            const int32_t p3 = (4 * b + 3) % period;
+            Normalize16Sse41(v, mean_vec[p0], mean_vec[p1], mean_vec[p2], mean_vec[p3], norm_vec[p0], norm_vec[p1], norm_vec[p2], norm_vec[p3], dst + i + b * 16);
+        }
+    }
+    const int32_t done = i / channel;
+    NormalizeInterleavedScalar(src + done * channel, channel, num - done, mean, norm, dst + done * channel);
+}
+
+TARGET_SSE41 static void NormalizePlanarSse41(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* const* dst_plane)
+{
+    if (channel == 1) {
+        NormalizeInterleavedSse41(src, 1, num, mean, norm, dst_plane[0]);
+        return;
+    }
+    /* channel == 3 */
+    __m128 mean_vec[3];
+    __m128 norm_vec[3];
+    for (int32_t c = 0; c < 3; c++) {
+        mean_vec[c] = _mm_set1_ps(mean[c]);
+        norm_vec[c] = _mm_set1_ps(norm[c]);
+    }
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        const __m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 0));
+        const __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 16));
+        const __m128i block2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 32));
+        for (int32_t c = 0; c < 3; c++) {
+            const __m128i v = Deinterleave3(block0, block1, block2, c);
+            Normalize16Sse41(v, mean_vec[c], mean_vec[c], mean_vec[c], mean_vec[c], norm_vec[c], norm_vec[c], norm_vec[c], norm_vec[c], dst_plane[c] + i);
+        }
+    }
+    float* dst_plane_rest[3] = { dst_plane[0] + i, dst_plane[1] + i, dst_plane[2] + i };
+    NormalizePlanarScalar(src + i * 3, 3, num - i, mean, norm, dst_plane_rest);
+}
+
+/* AVX2 */
+TARGET_AVX2 static inline void Normalize16Avx2(__m128i v, __m256 mean0, __m256 mean1, __m256 norm0, __m256 norm1, float* dst)
+{
+    __m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+    __m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+    _mm256_storeu_ps(dst + 0, _mm256_mul_ps(_mm256_sub_ps(f0, mean0), norm0));
+    _mm256_storeu_ps(dst + 8, _mm256_mul_ps(_mm256_sub_ps(f1, mean1), norm1));
+}
+
+TARGET_AVX2 static void NormalizeInterleavedAvx2(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* dst)
+{
+    /* The channel pattern of 8 lanes repeats every 3 vectors (channel = 3) or every vector (channel = 1, 4) */
+    const int32_t period = (channel == 3) ? 3 : 1;
+    __m256 mean_vec[3];
+    __m256 norm_vec[3];
+    for (int32_t p = 0; p < period; p++) {
+        alignas(32) float m[8];
+        alignas(32) float n[8];
+        for (int32_t lane = 0; lane < 8; lane++) {
+            m[lane] = mean[(p * 8 + lane) % channel];
+            n[lane] = norm[(p * 8 + lane) % channel];
+        }
+        mean_vec[p] = _mm256_load_ps(m);
+        norm_vec[p] = _mm256_load_ps(n);
+    }
+
+    const int32_t total = num * channel;
+    const int32_t block = 16 * period;
+    int32_t i = 0;
+    for (; i + block <= total; i += block) {
+        for (int32_t b = 0; b < period; b++) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + b * 16));
+            const int32_t p0 = (2 * b + 0) % period;
+            const int32_t p1 = (2 * b + 1) % period;
+            Normalize16Avx2(v, mean_vec[p0], mean_vec[p1], norm_vec[p0], norm_vec[p1], dst + i + b * 16);
+        }
+    }
+    const int32_t done = i / channel;
+    NormalizeInterleavedScalar(src + done * channel, channel, num - done, mean, norm, dst + done * channel);
+}
+
+TARGET_AVX2 static void NormalizePlanarAvx2(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* const* dst_plane)
+{
+    if (channel == 1) {
+        NormalizeInterleavedAvx2(src, 1, num, mean, norm, dst_plane[0]);
+        return;
+    }
+    /* channel == 3 */
+    __m256 mean_vec[3];
+    __m256 norm_vec[3];
+    for (int32_t c = 0; c < 3; c++) {
+        mean_vec[c] = _mm256_set1_ps(mean[c]);
+        norm_vec[c] = _mm256_set1_ps(norm[c]);
+    }
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        const __m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 0));
+        const __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 16));
+        const __m128i block2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 32));
+        for (int32_t c = 0; c < 3; c++) {
+            const __m128i v = Deinterleave3(block0, block1, block2, c);
+            Normalize16Avx2(v, mean_vec[c], mean_vec[c], norm_vec[c], norm_vec[c], dst_plane[c] + i);
+        }
+    }
+    float* dst_plane_rest[3] = { dst_plane[0] + i, dst_plane[1] + i, dst_plane[2] + i };
+    NormalizePlanarScalar(src + i * 3, 3, num - i, mean, norm, dst_plane_rest);
+}
+#endif
+
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+static inline void Normalize16Neon(uint8x16_t v, float32x4_t mean, float32x4_t norm, float* dst)
+{
+    const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+    vst1q_f32(dst + 0, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), mean), norm));
+    vst1q_f32(dst + 4, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), mean), norm));
+    vst1q_f32(dst + 8, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), mean), norm));
+    vst1q_f32(dst + 12, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), mean), norm));
+}
+
+static void NormalizeInterleavedNeon(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* dst)
+{
+    int32_t i = 0;
+    if (channel == 1) {
+        const float32x4_t mean_vec = vdupq_n_f32(mean[0]);
+        const float32x4_t norm_vec = vdupq_n_f32(norm[0]);
+        for (; i + 16 <= num; i += 16) {
+            Normalize16Neon(vld1q_u8(src + i), mean_vec, norm_vec, dst + i);
+        }
+    } else {
+        /* channel == 3 */
+        float32x4_t mean_vec[3];
+        float32x4_t norm_vec[3];
+        for (int32_t c = 0; c < 3; c++) {
+            mean_vec[c] = vdupq_n_f32(mean[c]);
+            norm_vec[c] = vdupq_n_f32(norm[c]);
+        }
+        for (; i + 16 <= num; i += 16) {
+            const uint8x16x3_t v = vld3q_u8(src + i * 3);
+            uint16x8_t v16[3][2];
+            for (int32_t c = 0; c < 3; c++) {
+                v16[c][0] = vmovl_u8(vget_low_u8(v.val[c]));
+                v16[c][1] = vmovl_u8(vget_high_u8(v.val[c]));
+            }
+            for (int32_t g = 0; g < 4; g++) {
+                float32x4x3_t out;
+                for (int32_t c = 0; c < 3; c++) {
+                    const uint16x4_t v4 = (g % 2 == 0) ? vget_low_u16(v16[c][g / 2]) : vget_high_u16(v16[c][g / 2]);
+                    out.val[c] = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(v4)), mean_vec[c]), norm_vec[c]);
+                }
+                vst3q_f32(dst + (i + g * 4) * 3, out);
+            }
+        }
+    }
+    NormalizeInterleavedScalar(src + i * channel, channel, num - i, mean, norm, dst + i * channel);
+}
+
+static void NormalizePlanarNeon(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* const* dst_plane)
+{
+    if (channel == 1) {
+        NormalizeInterleavedNeon(src, 1, num, mean, norm, dst_plane[0]);
+        return;
+    }
+    /* channel == 3 */
+    float32x4_t mean_vec[3];
+    float32x4_t norm_vec[3];
+    for (int32_t c = 0; c < 3; c++) {
+        mean_vec[c] = vdupq_n_f32(mean[c]);
+        norm_vec[c] = vdupq_n_f32(norm[c]);
+    }
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        const uint8x16x3_t v = vld3q_u8(src + i * 3);
+        for (int32_t c = 0; c < 3; c++) {
+            Normalize16Neon(v.val[c], mean_vec[c], norm_vec[c], dst_plane[c] + i);
+        }
+    }
+    float* dst_plane_rest[3] = { dst_plane[0] + i, dst_plane[1] + i, dst_plane[2] + i };
+    NormalizePlanarScalar(src + i * 3, 3, num - i, mean, norm, dst_plane_rest);
+}
+#endif
+
+void NormalizeInterleaved(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* dst)
+{
+    if (channel == 1 || channel == 3 || channel == 4) {
+        switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+        case kSimdAvx2:
+            NormalizeInterleavedAvx2(src, channel, num, mean, norm, dst);
+            return;
+        case kSimdSse41:
+            NormalizeInterleavedSse41(src, channel, num, mean, norm, dst);
+            return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+        case kSimdNeon:
+            if (channel == 4) break;
+            NormalizeInterleavedNeon(src, channel, num, mean, norm, dst);
+            return;
+#endif
+        default:
+            break;
+        }
+    }
+    NormalizeInterleavedScalar(src, channel, num, mean, norm, dst);
+}
+
+void NormalizePlanar(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* const* dst_plane)
+{
+    if (channel == 1 || channel == 3) {
+        switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+        case kSimdAvx2:
+            NormalizePlanarAvx2(src, channel, num, mean, norm, dst_plane);
+            return;
+        case kSimdSse41:
+            NormalizePlanarSse41(src, channel, num, mean, norm, dst_plane);
+            return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+        case kSimdNeon:
+            NormalizePlanarNeon(src, channel, num, mean, norm, dst_plane);
+            return;
+#endif
+        default:
+            break;
+        }
+    }
+    NormalizePlanarScalar(src, channel, num, mean, norm, dst_plane);
+}
+
+
+/*** Deinterleave (uint8 -> uint8) ***/
+template<int32_t kChannel>
+static void DeinterleaveScalarImpl(const uint8_t* src, int32_t channel, int32_t num, uint8_t* const* dst_plane)
+{
+    const int32_t ch = (kChannel > 0) ? kChannel : channel;
+    for (int32_t c = 0; c < ch; c++) {
+        uint8_t* dst = dst_plane[c];
+        for (int32_t i = 0; i < num; i++) {
+            dst[i] = src[i * ch + c];
+        }
+    }
+}
+
+static void DeinterleaveScalar(const uint8_t* src, int32_t channel, int32_t num, uint8_t* const* dst_plane)
+{
+    switch (channel) {
+    case 3:
+        DeinterleaveScalarImpl<3>(src, channel, num, dst_plane);
+        break;
+    case 4:
+        DeinterleaveScalarImpl<4>(src, channel, num, dst_plane);
+        break;
+    default:
+        DeinterleaveScalarImpl<0>(src, channel, num, dst_plane);
+        break;
+    }
+}
+
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+TARGET_SSE41 static void Deinterleave3Sse41(const uint8_t* src, int32_t num, uint8_t* const* dst_plane)
+{
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        const __m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 0));
+        const __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 16));
+        const __m128i block2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 32));
+        for (int32_t c = 0; c < 3; c++) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst_plane[c] + i), Deinterleave3(block0, block1, block2, c));
+        }
+    }
+    uint8_t* dst_plane_rest[3] = { dst_plane[0] + i, dst_plane[1] + i, dst_plane[2] + i };
+    DeinterleaveScalar(src + i * 3, 3, num - i, dst_plane_rest);
+}
+#endif
+
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+static void Deinterleave3Neon(const uint8_t* src, int32_t num, uint8_t* const* dst_plane)
+{
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        const uint8x16x3_t v = vld3q_u8(src + i * 3);
+        for (int32_t c = 0; c < 3; c++) {
+            vst1q_u8(dst_plane[c] + i, v.val[c]);
+        }
+    }
+    uint8_t* dst_plane_rest[3] = { dst_plane[0] + i, dst_plane[1] + i, dst_plane[2] + i };
+    DeinterleaveScalar(src + i * 3, 3, num - i, dst_plane_rest);
+}
+#endif
+
+void Deinterleave(const uint8_t* src, int32_t channel, int32_t num, uint8_t* const* dst_plane)
+{
+    if (channel == 1) {
+        std::memcpy(dst_plane[0], src, num);
+        return;
+    }
+    if (channel == 3) {
+        switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+        case kSimdAvx2:
+        case kSimdSse41:
+            Deinterleave3Sse41(src, num, dst_plane);
+            return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+        case kSimdNeon:
+            Deinterleave3Neon(src, num, dst_plane);
+            return;
+#endif
+        default:
+            break;
+        }
+    }
+    DeinterleaveScalar(src, channel, num, dst_plane);
+}
+
+
+/*** Color conversion ***/
+/* Weights for gray (the same as OpenCV. 0.299 * R + 0.587 * G + 0.114 * B in 14-bit fixed point) */
+static constexpr int32_t kGrayWeightBits = 14;
+static constexpr int32_t kGrayWeightR = 4899;
+static constexpr int32_t kGrayWeightG = 9617;
+static constexpr int32_t kGrayWeightB = 1868;
+
+void ConvertColor(const uint8_t* src, int32_t color_conversion, int32_t num, uint8_t* dst)
+{
+    switch (color_conversion) {
+    case kColorConversionSwapRb:
+        for (int32_t i = 0; i < num; i++) {
+            const uint8_t c0 = src[i * 3 + 0];
+            dst[i * 3 + 0] = src[i * 3 + 2];
+            dst[i * 3 + 1] = src[i * 3 + 1];
+            dst[i * 3 + 2] = c0;
+        }
+        break;
+    case kColorConversionRgbToGray:
+    case kColorConversionBgrToGray:
+    {
+        const int32_t weight0 = (color_conversion == kColorConversionRgbToGray) ? kGrayWeightR : kGrayWeightB;
+        const int32_t weight2 = (color_conversion == kColorConversionRgbToGray) ? kGrayWeightB : kGrayWeightR;
+        for (int32_t i = 0; i < num; i++) {
+            const int32_t val = src[i * 3 + 0] * weight0 + src[i * 3 + 1] * kGrayWeightG + src[i * 3 + 2] * weight2;
+            dst[i] = static_cast<uint8_t>((val + (1 << (kGrayWeightBits - 1))) >> kGrayWeightBits);
+        }
+        break;
+    }
+    case kColorConversionGrayToRgb:
+        for (int32_t i = 0; i < num; i++) {
+            const uint8_t val = src[i];
+            dst[i * 3 + 0] = val;
+            dst[i * 3 + 1] = val;
+            dst[i * 3 + 2] = val;
+        }
+        break;
+    case kColorConversionNone:
+    default:
+        if (src != dst) std::memcpy(dst, src, num);
+        break;
+    }
+}
+
+/* BT.601 (limited range) coefficients in 20-bit fixed point (the same as OpenCV COLOR_YUV2RGB_NV12, etc.) */
+static constexpr int32_t kYuvShift = 20;
+static constexpr int32_t kYuvCy = 1220542;
+static constexpr int32_t kYuvCub = 2116026;
+static constexpr int32_t kYuvCug = -409993;
+static constexpr int32_t kYuvCvg = -852492;
+static constexpr int32_t kYuvCvr = 1673527;
+
+static inline uint8_t ClipYuv(int32_t val)
+{
+    val = (val + (1 << (kYuvShift - 1))) >> kYuvShift;
+    return static_cast<uint8_t>((std::min)(255, (std::max)(0, val)));
+}
+
+void ConvertYuv420ToRgb(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v, int32_t uv_step, int32_t x, int32_t num, uint8_t* dst)
+{
+    for (int32_t i = x; i < x + num; i++) {
+        const int32_t uv_index = (i >> 1) * uv_step;
+        const int32_t u = src_u[uv_index] - 128;
+        const int32_t v = src_v[uv_index] - 128;
+        const int32_t y = (std::max)(0, src_y[i] - 16) * kYuvCy;
+        dst[0] = ClipYuv(y + kYuvCvr * v);
+        dst[1] = ClipYuv(y + kYuvCvg * v + kYuvCug * u);
+        dst[2] = ClipYuv(y + kYuvCub * u);
+        dst += 3;
+    }
+}
+
+
+/*** Resize ***/
+void CalculateResizeTable(int32_t src_size, int32_t dst_size, int32_t step, int32_t* offset0, int32_t* offset1, int16_t* weight)
+{
+    const float scale = static_cast<float>(src_size) / dst_size;
+    for (int32_t i = 0; i < dst_size; i++) {
+        float pos = (i + 0.5f) * scale - 0.5f;
+        if (pos < 0) pos = 0;
+        int32_t pos0 = static_cast<int32_t>(pos);
+        float fraction = pos - pos0;
+        if (pos0 >= src_size - 1) {
+            pos0 = src_size - 1;
+            fraction = 0;
+        }
+        const int32_t pos1 = (std::min)(pos0 + 1, src_size - 1);
+        offset0[i] = pos0 * step;
+        offset1[i] = pos1 * step;
+        weight[i] = static_cast<int16_t>(fraction * kResizeWeightOne + 0.5f);
+    }
+}
+
+template<int32_t kChannel>
+static void ResizeBilinearRowImpl(const uint8_t* src_row0, const uint8_t* src_row1, int32_t channel, int32_t width, const int32_t* x_offset0, const int32_t* x_offset1, const int16_t* x_weight, int32_t y_weight, uint8_t* dst)
+{
+    /* (kResizeWeightBits * 2) bits fixed point. 255 * 2^11 * 2^11 fits in int32_t */
+    static constexpr int32_t kShift = kResizeWeightBits * 2;
+    static constexpr int32_t kRound = 1 << (kShift - 1);
+    const int32_t ch = (kChannel > 0) ? kChannel : channel;
+    const int32_t y_weight0 = kResizeWeightOne - y_weight;
+    for (int32_t x = 0; x < width; x++) {
+        const uint8_t* p00 = src_row0 + x_offset0[x];
+        const uint8_t* p01 = src_row0 + x_offset1[x];
+        const uint8_t* p10 = src_row1 + x_offset0[x];
+        const uint8_t* p11 = src_row1 + x_offset1[x];
+        const int32_t x_weight1 = x_weight[x];
+        const int32_t x_weight0 = kResizeWeightOne - x_weight1;
+        for (int32_t c = 0; c < ch; c++) {
+            const int32_t top = p00[c] * x_weight0 + p01[c] * x_weight1;
+            const int32_t bottom = p10[c] * x_weight0 + p11[c] * x_weight1;
+            dst[x * ch + c] = static_cast<uint8_t>((top * y_weight0 + bottom * y_weight + kRound) >> kShift);
+        }
+    }
+}
+
+void ResizeBilinearRow(const uint8_t* src_row0, const uint8_t* src_row1, int32_t channel, int32_t width, const int32_t* x_offset0, const int32_t* x_offset1, const int16_t* x_weight, int32_t y_weight, uint8_t* dst)
+{
+    switch (channel) {
+    case 1:
+        ResizeBilinearRowImpl<1>(src_row0, src_row1, channel, width, x_offset0, x_offset1, x_weight, y_weight, dst);
+        break;
+    case 3:
+        ResizeBilinearRowImpl<3>(src_row0, src_row1, channel, width, x_offset0, x_offset1, x_weight, y_weight, dst);
+        break;
+    case 4:
+        ResizeBilinearRowImpl<4>(src_row0, src_row1, channel, width, x_offset0, x_offset1, x_weight, y_weight, dst);
+        break;
+    default:
+        ResizeBilinearRowImpl<0>(src_row0, src_row1, channel, width, x_offset0, x_offset1, x_weight, y_weight, dst);
+        break;
+    }
+}
+
+
+/*** Transpose ***/
+/* Scalar code (reference and fallback) */
+template<typename T>
+static void TransposeScalar(const T* src, int32_t src_stride, int32_t rows, int32_t cols, T* dst, int32_t dst_stride)
+{
+    for (int32_t i = 0; i < rows; i++) {
+        for (int32_t j = 0; j < cols; j++) {
+            dst[j * dst_stride + i] = src[i * src_stride + j];
+        }
+    }
+}
+
+/* Transpose the area not covered by size x size tiles */
+template<typename T>
+static void TransposeRest(const T* src, int32_t src_stride, int32_t rows, int32_t cols, int32_t size, T* dst, int32_t dst_stride)
+{
+    const int32_t rows_tile = rows - rows % size;
+    const int32_t cols_tile = cols - cols % size;
+    TransposeScalar(src + cols_tile, src_stride, rows, cols - cols_tile, dst + cols_tile * dst_stride, dst_stride);
+    TransposeScalar(src + rows_tile * src_stride, src_stride, rows - rows_tile, cols_tile, dst + rows_tile, dst_stride);
+}
+
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+TARGET_SSE41 static void Transpose8Sse41(const uint8_t* src, int32_t src_stride, int32_t rows, int32_t cols, uint8_t* dst, int32_t dst_stride)
+{
+    for (int32_t i = 0; i + 8 <= rows; i += 8) {
+        for (int32_t j = 0; j + 8 <= cols; j += 8) {
+            const uint8_t* s = src + i * src_stride + j;
+            __m128i r[8];
+            for (int32_t k = 0; k < 8; k++) {
+                r[k] = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s + k * src_stride));
+            }
+            const __m128i t0 = _mm_unpacklo_epi8(r[0], r[1]);
+            const __m128i t1 = _mm_unpacklo_epi8(r[2], r[3]);
+            const __m128i t2 = _mm_unpacklo_epi8(r[4], r[5]);
+            const __m128i t3 = _mm_unpacklo_epi8(r[6], r[7]);
+            const __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+            const __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+            const __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+            const __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+            const __m128i v[4] = { _mm_unpacklo_epi32(u0, u2), _mm_unpackhi_epi32(u0, u2), _mm_unpacklo_epi32(u1, u3), _mm_unpackhi_epi32(u1, u3) };
+            uint8_t* d = dst + j * dst_stride + i;
+            for (int32_t k = 0; k < 4; k++) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(d + (k * 2 + 0) * dst_stride), v[k]);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(d + (k * 2 + 1) * dst_stride), _mm_srli_si128(v[k], 8));
+            }
+        }
+    }
+    TransposeRest(src, src_stride, rows, cols, 8, dst, dst_stride);
+}
+
+TARGET_SSE41 static void Transpose32Sse41(const float* src, int32_t src_stride, int32_t rows, int32_t cols, float* dst, int32_t dst_stride)
+{
+    for (int32_t i = 0; i + 4 <= rows; i += 4) {
+        for (int32_t j = 0; j + 4 <= cols; j += 4) {
+            const float* s = src + i * src_stride + j;
+            __m128 r0 = _mm_loadu_ps(s + 0 * src_stride);
+            __m128 r1 = _mm_loadu_ps(s + 1 * src_stride);
+            __m128 r2 = _mm_loadu_ps(s + 2 * src_stride);
+            __m128 r3 = _mm_loadu_ps(s + 3 * src_stride);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            float* d = dst + j * dst_stride + i;
+            _mm_storeu_ps(d + 0 * dst_stride, r0);
+            _mm_storeu_ps(d + 1 * dst_stride, r1);
+            _mm_storeu_ps(d + 2 * dst_stride, r2);
+            _mm_storeu_ps(d + 3 * dst_stride, r3);
+        }
+    }
+    TransposeRest(src, src_stride, rows, cols, 4, dst, dst_stride);
+}
+
+TARGET_AVX2 static void Transpose32Avx2(const float* src, int32_t src_stride, int32_t rows, int32_t cols, float* dst, int32_t dst_stride)
+{
+    for (int32_t i = 0; i + 8 <= rows; i += 8) {
+        for (int32_t j = 0; j + 8 <= cols; j += 8) {
+            const float* s = src + i * src_stride + j;
+            __m256 r[8];
+            for (int32_t k = 0; k < 8; k++) {
+                r[k] = _mm256_loadu_ps(s + k * src_stride);
+            }
+            __m256 t[8];
+            for (int32_t k = 0; k < 4; k++) {
+                t[k * 2 + 0] = _mm256_unpacklo_ps(r[k * 2], r[k * 2 + 1]);
+                t[k * 2 + 1] = _mm256_unpackhi_ps(r[k * 2], r[k * 2 + 1]);
+            }
+            __m256 u[8];
+            for (int32_t k = 0; k < 2; k++) {
+                u[k * 4 + 0] = _mm256_shuffle_ps(t[k * 4 + 0], t[k * 4 + 2], _MM_SHUFFLE(1, 0, 1, 0));
+                u[k * 4 + 1] = _mm256_shuffle_ps(t[k * 4 + 0], t[k * 4 + 2], _MM_SHUFFLE(3, 2, 3, 2));
+                u[k * 4 + 2] = _mm256_shuffle_ps(t[k * 4 + 1], t[k * 4 + 3], _MM_SHUFFLE(1, 0, 1, 0));
+                u[k * 4 + 3] = _mm256_shuffle_ps(t[k * 4 + 1], t[k * 4 + 3], _MM_SHUFFLE(3, 2, 3, 2));
+            }
+            float* d = dst + j * dst_stride + i;
+            for (int32_t k = 0; k < 4; k++) {
+                _mm256_storeu_ps(d + (k + 0) * dst_stride, _mm256_permute2f128_ps(u[k], u[k + 4], 0x20));
+                _mm256_storeu_ps(d + (k + 4) * dst_stride, _mm256_permute2f128_ps(u[k], u[k + 4], 0x31));
+            }
+        }
+    }
+    TransposeRest(src, src_stride, rows, cols, 8, dst, dst_stride);
+}
+#endif
+
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+static void Transpose8Neon(const uint8_t* src, int32_t src_stride, int32_t rows, int32_t cols, uint8_t* dst, int32_t dst_stride)
+{
+    for (int32_t i = 0; i + 8 <= rows; i += 8) {
+        for (int32_t j = 0; j + 8 <= cols; j += 8) {
+            const uint8_t* s = src + i * src_stride + j;
+            const uint8x8x2_t b0 = vtrn_u8(vld1_u8(s + 0 * src_stride), vld1_u8(s + 1 * src_stride));
+            const uint8x8x2_t b1 = vtrn_u8(vld1_u8(s + 2 * src_stride), vld1_u8(s + 3 * src_stride));
+            const uint8x8x2_t b2 = vtrn_u8(vld1_u8(s + 4 * src_stride), vld1_u8(s + 5 * src_stride));
+            const uint8x8x2_t b3 = vtrn_u8(vld1_u8(s + 6 * src_stride), vld1_u8(s + 7 * src_stride));
+            const uint16x4x2_t c0 = vtrn_u16(vreinterpret_u16_u8(b0.val[0]), vreinterpret_u16_u8(b1.val[0]));
+            const uint16x4x2_t c1 = vtrn_u16(vreinterpret_u16_u8(b0.val[1]), vreinterpret_u16_u8(b1.val[1]));
+            const uint16x4x2_t c2 = vtrn_u16(vreinterpret_u16_u8(b2.val[0]), vreinterpret_u16_u8(b3.val[0]));
+            const uint16x4x2_t c3 = vtrn_u16(vreinterpret_u16_u8(b2.val[1]), vreinterpret_u16_u8(b3.val[1]));
+            const uint32x2x2_t d0 = vtrn_u32(vreinterpret_u32_u16(c0.val[0]), vreinterpret_u32_u16(c2.val[0]));
+            const uint32x2x2_t d1 = vtrn_u32(vreinterpret_u32_u16(c1.val[0]), vreinterpret_u32_u16(c3.val[0]));
+            const uint32x2x2_t d2 = vtrn_u32(vreinterpret_u32_u16(c0.val[1]), vreinterpret_u32_u16(c2.val[1]));
+            const uint32x2x2_t d3 = vtrn_u32(vreinterpret_u32_u16(c1.val[1]), vreinterpret_u32_u16(c3.val[1]));
+            uint8_t* d = dst + j * dst_stride + i;
+            vst1_u8(d + 0 * dst_stride, vreinterpret_u8_u32(d0.val[0]));
+            vst1_u8(d + 1 * dst_stride, vreinterpret_u8_u32(d1.val[0]));
+            vst1_u8(d + 2 * dst_stride, vreinterpret_u8_u32(d2.val[0]));
+            vst1_u8(d + 3 * dst_stride, vreinterpret_u8_u32(d3.val[0]));
+            vst1_u8(d + 4 * dst_stride, vreinterpret_u8_u32(d0.val[1]));
+            vst1_u8(d + 5 * dst_stride, vreinterpret_u8_u32(d1.val[1]));
+            vst1_u8(d + 6 * dst_stride, vreinterpret_u8_u32(d2.val[1]));
+            vst1_u8(d + 7 * dst_stride, vreinterpret_u8_u32(d3.val[1]));
+        }
+    }
+    TransposeRest(src, src_stride, rows, cols, 8, dst, dst_stride);
+}
+
+static void Transpose32Neon(const uint32_t* src, int32_t src_stride, int32_t rows, int32_t cols, uint32_t* dst, int32_t dst_stride)
+{
+    for (int32_t i = 0; i + 4 <= rows; i += 4) {
+        for (int32_t j = 0; j + 4 <= cols; j += 4) {
+            const uint32_t* s = src + i * src_stride + j;
+            const uint32x4x2_t t01 = vtrnq_u32(vld1q_u32(s + 0 * src_stride), vld1q_u32(s + 1 * src_stride));
+            const uint32x4x2_t t23 = vtrnq_u32(vld1q_u32(s + 2 * src_stride), vld1q_u32(s + 3 * src_stride));
+            uint32_t* d = dst + j * dst_stride + i;
+            vst1q_u32(d + 0 * dst_stride, vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+            vst1q_u32(d + 1 * dst_stride, vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+            vst1q_u32(d + 2 * dst_stride, vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+            vst1q_u32(d + 3 * dst_stride, vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+        }
+    }
+    TransposeRest(src, src_stride, rows, cols, 4, dst, dst_stride);
+}
+#endif
+
+void TransposeBlock(const void* src, int32_t src_stride, int32_t rows, int32_t cols, int32_t element_size, void* dst, int32_t dst_stride)
+{
+    switch (element_size) {
+    case 1:
+    {
+        const uint8_t* src8 = static_cast<const uint8_t*>(src);
+        uint8_t* dst8 = static_cast<uint8_t*>(dst);
+        if (cols == 3 && src_stride == 3) {
+            /* NHWC (3 channel) -> NCHW is the same as deinterleave */
+            uint8_t* dst_plane[3] = { dst8, dst8 + dst_stride, dst8 + dst_stride * 2 };
+            Deinterleave(src8, 3, rows, dst_plane);
+            return;
+        }
+        switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+        case kSimdAvx2:
+        case kSimdSse41:
+            Transpose8Sse41(src8, src_stride, rows, cols, dst8, dst_stride);
+            return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+        case kSimdNeon:
+            Transpose8Neon(src8, src_stride, rows, cols, dst8, dst_stride);
+            return;
+#endif
+        default:
+            TransposeScalar(src8, src_stride, rows, cols, dst8, dst_stride);
+            return;
+        }
+    }
+    case 2:
+        TransposeScalar(static_cast<const uint16_t*>(src), src_stride, rows, cols, static_cast<uint16_t*>(dst), dst_stride);
+        return;
+    case 4:
+        switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+        case kSimdAvx2:
+            Transpose32Avx2(static_cast<const float*>(src), src_stride, rows, cols, static_cast<float*>(dst), dst_stride);
+            return;
+        case kSimdSse41:
+            Transpose32Sse41(static_cast<const float*>(src), src_stride, rows, cols, static_cast<float*>(dst), dst_stride);
+            return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+        case kSimdNeon:
+            Transpose32Neon(static_cast<const uint32_t*>(src), src_stride, rows, cols, static_cast<uint32_t*>(dst), dst_stride);
+            return;
+#endif
+        default:
+            TransposeScalar(static_cast<const uint32_t*>(src), src_stride, rows, cols, static_cast<uint32_t*>(dst), dst_stride);
+            return;
+        }
+    case 8:
+        TransposeScalar(static_cast<const uint64_t*>(src), src_stride, rows, cols, static_cast<uint64_t*>(dst), dst_stride);
+        return;
+    default:
+        return;
+    }
+}
+
+
+/*** Dequantize (uint8 / int8 -> float) ***/
+/* Scalar code (reference and fallback) */
+template<typename T>
+static void DequantizeScalar(const T* src, int32_t num, int32_t zero_point, float scale, float* dst)
+{
+    for (int32_t i = 0; i < num; i++) {
+        dst[i] = (src[i] - zero_point) * scale;
+    }
+}
+
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+TARGET_SSE41 static inline __m128i ExtendToInt32Sse41(__m128i v, const uint8_t*)
+{
+    return _mm_cvtepu8_epi32(v);
+}
+
+TARGET_SSE41 static inline __m128i ExtendToInt32Sse41(__m128i v, const int8_t*)
+{
+    return _mm_cvtepi8_epi32(v);
+}
+
+template<typename T>
+TARGET_SSE41 static void DequantizeSse41(const T* src, int32_t num, int32_t zero_point, float scale, float* dst)
+{
+    const __m128 zero_point_vec = _mm_set1_ps(static_cast<float>(zero_point));
+    const __m128 scale_vec = _mm_set1_ps(scale);
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        for (int32_t j = 0; j < 4; j++) {
+            const __m128 f = _mm_cvtepi32_ps(ExtendToInt32Sse41(v, src));
+            _mm_storeu_ps(dst + i + j * 4, _mm_mul_ps(_mm_sub_ps(f, zero_point_vec), scale_vec));
+            v = _mm_srli_si128(v, 4);
+        }
+    }
+    DequantizeScalar(src + i, num - i, zero_point, scale, dst + i);
+}
+
+TARGET_AVX2 static inline __m256i ExtendToInt32Avx2(__m128i v, const uint8_t*)
+{
+    return _mm256_cvtepu8_epi32(v);
+}
+
+TARGET_AVX2 static inline __m256i ExtendToInt32Avx2(__m128i v, const int8_t*)
+{
+    return _mm256_cvtepi8_epi32(v);
+}
+
+template<typename T>
+TARGET_AVX2 static void DequantizeAvx2(const T* src, int32_t num, int32_t zero_point, float scale, float* dst)
+{
+    const __m256 zero_point_vec = _mm256_set1_ps(static_cast<float>(zero_point));
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+    int32_t i = 0;
+    for (; i + 32 <= num; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const __m128i v_lo = _mm256_castsi256_si128(v);
+        const __m128i v_hi = _mm256_extracti128_si256(v, 1);
+        const __m128i part[4] = { v_lo, _mm_srli_si128(v_lo, 8), v_hi, _mm_srli_si128(v_hi, 8) };
+        for (int32_t j = 0; j < 4; j++) {
+            const __m256 f = _mm256_cvtepi32_ps(ExtendToInt32Avx2(part[j], src));
+            _mm256_storeu_ps(dst + i + j * 8, _mm256_mul_ps(_mm256_sub_ps(f, zero_point_vec), scale_vec));
+        }
+    }
+    DequantizeScalar(src + i, num - i, zero_point, scale, dst + i);
+}
+#endif
+
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+static inline void ExtendToInt32Neon(const uint8_t* src, int32x4_t* dst)
+{
+    const uint8x16_t v = vld1q_u8(src);
+    const int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v)));
+    const int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v)));
+    dst[0] = vmovl_s16(vget_low_s16(lo));
+    dst[1] = vmovl_s16(vget_high_s16(lo));
+    dst[2] = vmovl_s16(vget_low_s16(hi));
+    dst[3] = vmovl_s16(vget_high_s16(hi));
+}
+
+static inline void ExtendToInt32Neon(const int8_t* src, int32x4_t* dst)
+{
+    const int8x16_t v = vld1q_s8(src);
+    const int16x8_t lo = vmovl_s8(vget_low_s8(v));
+    const int16x8_t hi = vmovl_s8(vget_high_s8(v));
+    dst[0] = vmovl_s16(vget_low_s16(lo));
+    dst[1] = vmovl_s16(vget_high_s16(lo));
+    dst[2] = vmovl_s16(vget_low_s16(hi));
+    dst[3] = vmovl_s16(vget_high_s16(hi));
+}
+
+template<typename T>
+static void DequantizeNeon(const T* src, int32_t num, int32_t zero_point, float scale, float* dst)
+{
+    const float32x4_t zero_point_vec = vdupq_n_f32(static_cast<float>(zero_point));
+    const float32x4_t scale_vec = vdupq_n_f32(scale);
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        int32x4_t v[4];
+        ExtendToInt32Neon(src + i, v);
+        for (int32_t j = 0; j < 4; j++) {
+            vst1q_f32(dst + i + j * 4, vmulq_f32(vsubq_f32(vcvtq_f32_s32(v[j]), zero_point_vec), scale_vec));
+        }
+    }
+    DequantizeScalar(src + i, num - i, zero_point, scale, dst + i);
+}
+#endif
+
+template<typename T>
+static void DequantizeImpl(const T* src, int32_t num, int32_t zero_point, float scale, float* dst)
+{
+    switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    case kSimdAvx2:
+        DequantizeAvx2(src, num, zero_point, scale, dst);
+        return;
+    case kSimdSse41:
+        DequantizeSse41(src, num, zero_point, scale, dst);
+        return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+    case kSimdNeon:
+        DequantizeNeon(src, num, zero_point, scale, dst);
+        return;
+#endif
+    default:
+        DequantizeScalar(src, num, zero_point, scale, dst);
+        return;
+    }
+}
+
+void Dequantize(const uint8_t* src, int32_t num, int32_t zero_point, float scale, float* dst)
+{
+    DequantizeImpl(src, num, zero_point, scale, dst);
+}
+
+void Dequantize(const int8_t* src, int32_t num, int32_t zero_point, float scale, float* dst)
+{
+    DequantizeImpl(src, num, zero_point, scale, dst);
+}
+
+
+/*** Type conversion (fp16 / bf16 / int32 / int64 <-> float) ***/
+/* Scalar code (reference and fallback). Rounding is to nearest even, and inf / nan are kept */
+static inline float BitsToFloat(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline uint32_t FloatToBits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline float Fp16ToFp32Scalar(uint16_t h)
+{
+    /* Move exponent and mantissa to float position and rebias exponent. inf / nan and subnormal are fixed up */
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    const uint32_t shifted = static_cast<uint32_t>(h & 0x7FFF) << 13;
+    const uint32_t exponent = shifted & 0x0F800000;
+    uint32_t bits = shifted + ((127 - 15) << 23);
+    if (exponent == 0x0F800000) {
+        bits += (128 - 16) << 23;
+    } else if (exponent == 0) {
+        /* Subnormal (and zero): normalized by float subtraction, which is exact */
+        bits = FloatToBits(BitsToFloat(bits + (1 << 23)) - BitsToFloat(113 << 23));
+    }
+    return BitsToFloat(bits | sign);
+}
+
+static inline uint16_t Fp32ToFp16Scalar(float value)
+{
+    const uint32_t bits = FloatToBits(value);
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (((bits >> 23) & 0xFF) == 0xFF) {
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    } else if (exponent >= 0x1F) {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    } else if (exponent <= 0) {
+        /* Subnormal or zero */
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000;
+        const int32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) half++;     // carry to exponent (up to inf) is correct
+    return static_cast<uint16_t>(sign | half);
+}
+
+static inline uint16_t Fp32ToBf16Scalar(float value)
+{
+    const uint32_t bits = FloatToBits(value);
+    if ((bits & 0x7FFFFFFF) > 0x7F800000) {
+        return static_cast<uint16_t>((bits >> 16) | 0x40);     // quiet nan
+    }
+    return static_cast<uint16_t>((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+}
+
+static void ConvertFp16ToFp32Scalar(const uint16_t* src, int32_t num, float* dst)
+{
+    for (int32_t i = 0; i < num; i++) {
+        dst[i] = Fp16ToFp32Scalar(src[i]);
+    }
+}
+
+static void ConvertFp32ToFp16Scalar(const float* src, int32_t num, uint16_t* dst)
+{
+    for (int32_t i = 0; i < num; i++) {
+        dst[i] = Fp32ToFp16Scalar(src[i]);
+    }
+}
+
+static void ConvertBf16ToFp32Scalar(const uint16_t* src, int32_t num, float* dst)
+{
+    for (int32_t i = 0; i < num; i++) {
+        dst[i] = BitsToFloat(static_cast<uint32_t>(src[i]) << 16);
+    }
+}
+
+static void ConvertFp32ToBf16Scalar(const float* src, int32_t num, uint16_t* dst)
+{
+    for (int32_t i = 0; i < num; i++) {
+        dst[i] = Fp32ToBf16Scalar(src[i]);
+    }
+}
+
+template<typename T>
+static void ConvertIntToFp32Scalar(const T* src, int32_t num, float* dst)
+{
+    for (int32_t i = 0; i < num; i++) {
+        dst[i] = static_cast<float>(src[i]);
+    }
+}
+
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+TARGET_F16C static void ConvertFp16ToFp32F16c(const uint16_t* src, int32_t num, float* dst)
+{
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(v0));
+        _mm256_storeu_ps(dst + i + 8, _mm256_cvtph_ps(v1));
+    }
+    ConvertFp16ToFp32Scalar(src + i, num - i, dst + i);
+}
+
+TARGET_F16C static void ConvertFp32ToFp16F16c(const float* src, int32_t num, uint16_t* dst)
+{
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        const __m128i v0 = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        const __m128i v1 = _mm256_cvtps_ph(_mm256_loadu_ps(src + i + 8), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), v1);
+    }
+    ConvertFp32ToFp16Scalar(src + i, num - i, dst + i);
+}
+
+TARGET_SSE41 static void ConvertBf16ToFp32Sse41(const uint16_t* src, int32_t num, float* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int32_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(zero, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(zero, v));
+    }
+    ConvertBf16ToFp32Scalar(src + i, num - i, dst + i);
+}
+
+TARGET_SSE41 static inline __m128i Fp32ToBf16Sse41(__m128i bits)
+{
+    const __m128i lsb = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(1));
+    const __m128i rounded = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(0x7FFF)), lsb), 16);
+    const __m128i is_nan = _mm_cmpgt_epi32(_mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF)), _mm_set1_epi32(0x7F800000));
+    const __m128i nan = _mm_or_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x40));
+    return _mm_blendv_epi8(rounded, nan, is_nan);
+}
+
+TARGET_SSE41 static void ConvertFp32ToBf16Sse41(const float* src, int32_t num, uint16_t* dst)
+{
+    int32_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        const __m128i v0 = Fp32ToBf16Sse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        const __m128i v1 = Fp32ToBf16Sse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi32(v0, v1));
+    }
+    ConvertFp32ToBf16Scalar(src + i, num - i, dst + i);
+}
+
+TARGET_SSE41 static void ConvertInt32ToFp32Sse41(const int32_t* src, int32_t num, float* dst)
+{
+    int32_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4))));
+    }
+    ConvertIntToFp32Scalar(src + i, num - i, dst + i);
+}
+
+TARGET_AVX2 static void ConvertInt32ToFp32Avx2(const int32_t* src, int32_t num, float* dst)
+{
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i))));
+        _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 8))));
+    }
+    ConvertIntToFp32Scalar(src + i, num - i, dst + i);
+}
+#endif
+
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+#if defined(INFERENCE_HELPER_KERNEL_NEON_FP16)
+static void ConvertFp16ToFp32Neon(const uint16_t* src, int32_t num, float* dst)
+{
+    int32_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        const uint16x8_t v = vld1q_u16(src + i);
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vget_low_u16(v))));
+        vst1q_f32(dst + i + 4, vcvt_f32_f16(vreinterpret_f16_u16(vget_high_u16(v))));
+    }
+    ConvertFp16ToFp32Scalar(src + i, num - i, dst + i);
+}
+
+static void ConvertFp32ToFp16Neon(const float* src, int32_t num, uint16_t* dst)
+{
+    int32_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        const uint16x4_t v0 = vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i)));
+        const uint16x4_t v1 = vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i + 4)));
+        vst1q_u16(dst + i, vcombine_u16(v0, v1));
+    }
+    ConvertFp32ToFp16Scalar(src + i, num - i, dst + i);
+}
+#endif
+
+static void ConvertBf16ToFp32Neon(const uint16_t* src, int32_t num, float* dst)
+{
+    int32_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        const uint16x8_t v = vld1q_u16(src + i);
+        vst1q_f32(dst + i, vreinterpretq_f32_u32(vshll_n_u16(vget_low_u16(v), 16)));
+        vst1q_f32(dst + i + 4, vreinterpretq_f32_u32(vshll_n_u16(vget_high_u16(v), 16)));
+    }
+    ConvertBf16ToFp32Scalar(src + i, num - i, dst + i);
+}
+
+static void ConvertInt32ToFp32Neon(const int32_t* src, int32_t num, float* dst)
+{
+    int32_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        vst1q_f32(dst + i, vcvtq_f32_s32(vld1q_s32(src + i)));
+        vst1q_f32(dst + i + 4, vcvtq_f32_s32(vld1q_s32(src + i + 4)));
+    }
+    ConvertIntToFp32Scalar(src + i, num - i, dst + i);
+}
+#endif
+
+void ConvertFp16ToFp32(const uint16_t* src, int32_t num, float* dst)
+{
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    if (GetSimdLevel() >= kSimdAvx2 && HasF16c()) {
+        ConvertFp16ToFp32F16c(src, num, dst);
+        return;
+    }
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON_FP16)
+    if (GetSimdLevel() == kSimdNeon) {
+        ConvertFp16ToFp32Neon(src, num, dst);
+        return;
+    }
+#endif
+    ConvertFp16ToFp32Scalar(src, num, dst);
+}
+
+void ConvertFp32ToFp16(const float* src, int32_t num, uint16_t* dst)
+{
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    if (GetSimdLevel() >= kSimdAvx2 && HasF16c()) {
+        ConvertFp32ToFp16F16c(src, num, dst);
+        return;
+    }
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON_FP16)
+    if (GetSimdLevel() == kSimdNeon) {
+        ConvertFp32ToFp16Neon(src, num, dst);
+        return;
+    }
+#endif
+    ConvertFp32ToFp16Scalar(src, num, dst);
+}
+
+void ConvertBf16ToFp32(const uint16_t* src, int32_t num, float* dst)
+{
+    switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    case kSimdAvx2:
+    case kSimdSse41:
+        ConvertBf16ToFp32Sse41(src, num, dst);
+        return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+    case kSimdNeon:
+        ConvertBf16ToFp32Neon(src, num, dst);
+        return;
+#endif
+    default:
+        ConvertBf16ToFp32Scalar(src, num, dst);
+        return;
+    }
+}
+
+void ConvertFp32ToBf16(const float* src, int32_t num, uint16_t* dst)
+{
+    switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    case kSimdAvx2:
+    case kSimdSse41:
+        ConvertFp32ToBf16Sse41(src, num, dst);
+        return;
+#endif
+    default:
+        ConvertFp32ToBf16Scalar(src, num, dst);
+        return;
+    }
+}
+
+void ConvertInt32ToFp32(const int32_t* src, int32_t num, float* dst)
+{
+    switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    case kSimdAvx2:
+        ConvertInt32ToFp32Avx2(src, num, dst);
+        return;
+    case kSimdSse41:
+        ConvertInt32ToFp32Sse41(src, num, dst);
+        return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+    case kSimdNeon:
+        ConvertInt32ToFp32Neon(src, num, dst);
+        return;
+#endif
+    default:
+        ConvertIntToFp32Scalar(src, num, dst);
+        return;
+    }
+}
+
+void ConvertInt64ToFp32(const int64_t* src, int32_t num, float* dst)
+{
+    /* No SIMD instruction for int64 -> float before AVX-512. The loop is simple enough for the compiler */
+    ConvertIntToFp32Scalar(src, num, dst);
+}
+
+
+/*** Normalize (uint8 -> fp16) ***/
+/* Pixels are normalized into a small float buffer (stays in L1 cache) and converted to fp16, so the tensor is written only once in fp16 */
+static constexpr int32_t kNormalizeFp16BufferSize = 1024;   // float elements
+static constexpr int32_t kNormalizeFp16MaxChannel = 4;
+
+void NormalizeInterleavedFp16(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, uint16_t* dst)
+{
+    channel = (std::min)(channel, kNormalizeFp16MaxChannel);
+    float buffer[kNormalizeFp16BufferSize];
+    const int32_t chunk = kNormalizeFp16BufferSize / channel;
+    for (int32_t i = 0; i < num; i += chunk) {
+        const int32_t n = (std::min)(chunk, num - i);
+        NormalizeInterleaved(src + i * channel, channel, n, mean, norm, buffer);
+        ConvertFp32ToFp16(buffer, n * channel, dst + i * channel);
+    }
+}
+
+void NormalizePlanarFp16(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, uint16_t* const* dst_plane)
+{
+    channel = (std::min)(channel, kNormalizeFp16MaxChannel);
+    static constexpr int32_t kChunk = kNormalizeFp16BufferSize / kNormalizeFp16MaxChannel;
+    float buffer[kNormalizeFp16BufferSize];
+    float* buffer_plane[kNormalizeFp16MaxChannel] = { buffer, buffer + kChunk, buffer + kChunk * 2, buffer + kChunk * 3 };
+    for (int32_t i = 0; i < num; i += kChunk) {
+        const int32_t n = (std::min)(kChunk, num - i);
+        NormalizePlanar(src + i * channel, channel, n, mean, norm, buffer_plane);
+        for (int32_t c = 0; c < channel; c++) {
+            ConvertFp32ToFp16(buffer_plane[c], n, dst_plane[c] + i);
+        }
+    }
+}
+
+
+/*** Softmax ***/
+/* exp is approximated by polynomial (the same as Cephes expf. relative error < 2e-7), so that scalar and SIMD code use the same algorithm */
+static constexpr float kExpMax = 88.3762626647949f;
+static constexpr float kExpMin = -88.3762626647949f;
+static constexpr float kExpLog2e = 1.44269504088896341f;
+static constexpr float kExpC1 = 0.693359375f;
+static constexpr float kExpC2 = -2.12194440e-4f;
+static constexpr float kExpP0 = 1.9875691500E-4f;
+static constexpr float kExpP1 = 1.3981999507E-3f;
+static constexpr float kExpP2 = 8.3334519073E-3f;
+static constexpr float kExpP3 = 4.1665795894E-2f;
+static constexpr float kExpP4 = 1.6666665459E-1f;
+static constexpr float kExpP5 = 5.0000001201E-1f;
+
+static inline float ExpScalar(float x)
+{
+    x = (std::min)((std::max)(x, kExpMin), kExpMax);
+    const float fx = std::floor(x * kExpLog2e + 0.5f);
+    x = x - fx * kExpC1;
+    x = x - fx * kExpC2;
+    float y = kExpP0;
+    y = y * x + kExpP1;
+    y = y * x + kExpP2;
+    y = y * x + kExpP3;
+    y = y * x + kExpP4;
+    y = y * x + kExpP5;
+    y = y * x * x + x + 1.0f;
+    const int32_t n = (static_cast<int32_t>(fx) + 127) << 23;
+    float pow2n;
+    std::memcpy(&pow2n, &n, sizeof(pow2n));
+    return y * pow2n;
+}
+
+/* Scalar code (reference and fallback) */
+static void SoftmaxScalar(const float* src, int32_t num, float* dst)
+{
+    if (num <= 0) return;
+    float max_val = src[0];
+    for (int32_t i = 1; i < num; i++) {
+        max_val = (std::max)(max_val, src[i]);
+    }
+    float sum = 0.0f;
+    for (int32_t i = 0; i < num; i++) {
+        dst[i] = ExpScalar(src[i] - max_val);
+        sum += dst[i];
+    }
+    const float inv_sum = 1.0f / sum;
+    for (int32_t i = 0; i < num; i++) {
+        dst[i] *= inv_sum;
+    }
+}
+
+static void SoftmaxPlanarScalar(const float* src, int32_t channel, int32_t num, int32_t plane_step, float* dst)
+{
+    for (int32_t i = 0; i < num; i++) {
+        float max_val = src[i];
+        for (int32_t c = 1; c < channel; c++) {
+            max_val = (std::max)(max_val, src[c * plane_step + i]);
+        }
+        float sum = 0.0f;
+        for (int32_t c = 0; c < channel; c++) {
+            dst[c * plane_step + i] = ExpScalar(src[c * plane_step + i] - max_val);
+            sum += dst[c * plane_step + i];
+        }
+        const float inv_sum = 1.0f / sum;
+        for (int32_t c = 0; c < channel; c++) {
+            dst[c * plane_step + i] *= inv_sum;
+        }
+    }
+}
+
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+TARGET_SSE41 static inline __m128 ExpSse41(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(kExpMin)), _mm_set1_ps(kExpMax));
+    const __m128 fx = _mm_floor_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(kExpLog2e)), _mm_set1_ps(0.5f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(kExpC1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(kExpC2)));
+    __m128 y = _mm_set1_ps(kExpP0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kExpP5));
+    y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, x), x), x), _mm_set1_ps(1.0f));
+    const __m128i n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(y, _mm_castsi128_ps(n));
+}
+
+TARGET_SSE41 static void SoftmaxSse41(const float* src, int32_t num, float* dst)
+{
+    if (num < 4) {
+        SoftmaxScalar(src, num, dst);
+        return;
+    }
+    __m128 max_vec = _mm_loadu_ps(src);
+    int32_t i = 4;
+    for (; i + 4 <= num; i += 4) {
+        max_vec = _mm_max_ps(max_vec, _mm_loadu_ps(src + i));
+    }
+    alignas(16) float lane[4];
+    _mm_store_ps(lane, max_vec);
+    float max_val = (std::max)((std::max)(lane[0], lane[1]), (std::max)(lane[2], lane[3]));
+    for (; i < num; i++) {
+        max_val = (std::max)(max_val, src[i]);
+    }
+
+    const __m128 max_val_vec = _mm_set1_ps(max_val);
+    __m128 sum_vec = _mm_setzero_ps();
+    i = 0;
+    for (; i + 4 <= num; i += 4) {
+        const __m128 e = ExpSse41(_mm_sub_ps(_mm_loadu_ps(src + i), max_val_vec));
+        _mm_storeu_ps(dst + i, e);
+        sum_vec = _mm_add_ps(sum_vec, e);
+    }
+    _mm_store_ps(lane, sum_vec);
+    float sum = lane[0] + lane[1] + lane[2] + lane[3];
+    for (int32_t j = i; j < num; j++) {
+        dst[j] = ExpScalar(src[j] - max_val);
+        sum += dst[j];
+    }
+
+    const float inv_sum = 1.0f / sum;
+    const __m128 inv_sum_vec = _mm_set1_ps(inv_sum);
+    i = 0;
+    for (; i + 4 <= num; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), inv_sum_vec));
+    }
+    for (; i < num; i++) {
+        dst[i] *= inv_sum;
+    }
+}
+
+TARGET_SSE41 static void SoftmaxPlanarSse41(const float* src, int32_t channel, int32_t num, int32_t plane_step, float* dst)
+{
+    int32_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        __m128 max_vec = _mm_loadu_ps(src + i);
+        for (int32_t c = 1; c < channel; c++) {
+            max_vec = _mm_max_ps(max_vec, _mm_loadu_ps(src + c * plane_step + i));
+        }
+        __m128 sum_vec = _mm_setzero_ps();
+        for (int32_t c = 0; c < channel; c++) {
+            const __m128 e = ExpSse41(_mm_sub_ps(_mm_loadu_ps(src + c * plane_step + i), max_vec));
+            _mm_storeu_ps(dst + c * plane_step + i, e);
+            sum_vec = _mm_add_ps(sum_vec, e);
+        }
+        const __m128 inv_sum_vec = _mm_div_ps(_mm_set1_ps(1.0f), sum_vec);
+        for (int32_t c = 0; c < channel; c++) {
+            _mm_storeu_ps(dst + c * plane_step + i, _mm_mul_ps(_mm_loadu_ps(dst + c * plane_step + i), inv_sum_vec));
+        }
+    }
+    SoftmaxPlanarScalar(src + i, channel, num - i, plane_step, dst + i);
+}
+
+TARGET_AVX2 static inline __m256 ExpAvx2(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(kExpMin)), _mm256_set1_ps(kExpMax));
+    const __m256 fx = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(kExpLog2e)), _mm256_set1_ps(0.5f)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(kExpC1)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(kExpC2)));
+    __m256 y = _mm256_set1_ps(kExpP0);
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(kExpP1));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(kExpP2));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(kExpP3));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(kExpP4));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(kExpP5));
+    y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(y, x), x), x), _mm256_set1_ps(1.0f));
+    const __m256i n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(n));
+}
+
+TARGET_AVX2 static void SoftmaxAvx2(const float* src, int32_t num, float* dst)
+{
+    if (num < 8) {
+        SoftmaxScalar(src, num, dst);
+        return;
+    }
+    __m256 max_vec = _mm256_loadu_ps(src);
+    int32_t i = 8;
+    for (; i + 8 <= num; i += 8) {
+        max_vec = _mm256_max_ps(max_vec, _mm256_loadu_ps(src + i));
+    }
+    alignas(32) float lane[8];
+    _mm256_store_ps(lane, max_vec);
+    float max_val = lane[0];
+    for (int32_t j = 1; j < 8; j++) {
+        max_val = (std::max)(max_val, lane[j]);
+    }
+    for (; i < num; i++) {
+        max_val = (std::max)(max_val, src[i]);
+    }
+
+    const __m256 max_val_vec = _mm256_set1_ps(max_val);
+    __m256 sum_vec = _mm256_setzero_ps();
+    i = 0;
+    for (; i + 8 <= num; i += 8) {
+        const __m256 e = ExpAvx2(_mm256_sub_ps(_mm256_loadu_ps(src + i), max_val_vec));
+        _mm256_storeu_ps(dst + i, e);
+        sum_vec = _mm256_add_ps(sum_vec, e);
+    }
+    _mm256_store_ps(lane, sum_vec);
+    float sum = 0.0f;
+    for (int32_t j = 0; j < 8; j++) {
+        sum += lane[j];
+    }
+    for (int32_t j = i; j < num; j++) {
+        dst[j] = ExpScalar(src[j] - max_val);
+        sum += dst[j];
+    }
+
+    const float inv_sum = 1.0f / sum;
+    const __m256 inv_sum_vec = _mm256_set1_ps(inv_sum);
+    i = 0;
+    for (; i + 8 <= num; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(dst + i), inv_sum_vec));
+    }
+    for (; i < num; i++) {
+        dst[i] *= inv_sum;
+    }
+}
+
+TARGET_AVX2 static void SoftmaxPlanarAvx2(const float* src, int32_t channel, int32_t num, int32_t plane_step, float* dst)
+{
+    int32_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        __m256 max_vec = _mm256_loadu_ps(src + i);
+        for (int32_t c = 1; c < channel; c++) {
+            max_vec = _mm256_max_ps(max_vec, _mm256_loadu_ps(src + c * plane_step + i));
+        }
+        __m256 sum_vec = _mm256_setzero_ps();
+        for (int32_t c = 0; c < channel; c++) {
+            const __m256 e = ExpAvx2(_mm256_sub_ps(_mm256_loadu_ps(src + c * plane_step + i), max_vec));
+            _mm256_storeu_ps(dst + c * plane_step + i, e);
+            sum_vec = _mm256_add_ps(sum_vec, e);
+        }
+        const __m256 inv_sum_vec = _mm256_div_ps(_mm256_set1_ps(1.0f), sum_vec);
+        for (int32_t c = 0; c < channel; c++) {
+            _mm256_storeu_ps(dst + c * plane_step + i, _mm256_mul_ps(_mm256_loadu_ps(dst + c * plane_step + i), inv_sum_vec));
+        }
+    }
+    SoftmaxPlanarScalar(src + i, channel, num - i, plane_step, dst + i);
+}
+#endif
+
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+static inline float32x4_t ExpNeon(float32x4_t x)
+{
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(kExpMin)), vdupq_n_f32(kExpMax));
+    /* floor: truncate, then subtract 1 if the result is larger (ARMv7 doesn't have vrndmq_f32) */
+    const float32x4_t fx_round = vaddq_f32(vmulq_f32(x, vdupq_n_f32(kExpLog2e)), vdupq_n_f32(0.5f));
+    float32x4_t fx = vcvtq_f32_s32(vcvtq_s32_f32(fx_round));
+    const uint32x4_t mask = vcgtq_f32(fx, fx_round);
+    fx = vsubq_f32(fx, vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+    x = vsubq_f32(x, vmulq_f32(fx, vdupq_n_f32(kExpC1)));
+    x = vsubq_f32(x, vmulq_f32(fx, vdupq_n_f32(kExpC2)));
+    float32x4_t y = vdupq_n_f32(kExpP0);
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(kExpP1));
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(kExpP2));
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(kExpP3));
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(kExpP4));
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(kExpP5));
+    y = vaddq_f32(vaddq_f32(vmulq_f32(vmulq_f32(y, x), x), x), vdupq_n_f32(1.0f));
+    const int32x4_t n = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(fx), vdupq_n_s32(127)), 23);
+    return vmulq_f32(y, vreinterpretq_f32_s32(n));
+}
+
+static void SoftmaxNeon(const float* src, int32_t num, float* dst)
+{
+    if (num < 4) {
+        SoftmaxScalar(src, num, dst);
+        return;
+    }
+    float32x4_t max_vec = vld1q_f32(src);
+    int32_t i = 4;
+    for (; i + 4 <= num; i += 4) {
+        max_vec = vmaxq_f32(max_vec, vld1q_f32(src + i));
+    }
+    float lane[4];
+    vst1q_f32(lane, max_vec);
+    float max_val = (std::max)((std::max)(lane[0], lane[1]), (std::max)(lane[2], lane[3]));
+    for (; i < num; i++) {
+        max_val = (std::max)(max_val, src[i]);
+    }
+
+    const float32x4_t max_val_vec = vdupq_n_f32(max_val);
+    float32x4_t sum_vec = vdupq_n_f32(0.0f);
+    i = 0;
+    for (; i + 4 <= num; i += 4) {
+        const float32x4_t e = ExpNeon(vsubq_f32(vld1q_f32(src + i), max_val_vec));
+        vst1q_f32(dst + i, e);
+        sum_vec = vaddq_f32(sum_vec, e);
+    }
+    vst1q_f32(lane, sum_vec);
+    float sum = lane[0] + lane[1] + lane[2] + lane[3];
+    for (int32_t j = i; j < num; j++) {
+        dst[j] = ExpScalar(src[j] - max_val);
+        sum += dst[j];
+    }
+
+    const float inv_sum = 1.0f / sum;
+    const float32x4_t inv_sum_vec = vdupq_n_f32(inv_sum);
+    i = 0;
+    for (; i + 4 <= num; i += 4) {
+        vst1q_f32(dst + i, vmulq_f32(vld1q_f32(dst + i), inv_sum_vec));
+    }
+    for (; i < num; i++) {
+        dst[i] *= inv_sum;
+    }
+}
+
+static void SoftmaxPlanarNeon(const float* src, int32_t channel, int32_t num, int32_t plane_step, float* dst)
+{
+    int32_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        float32x4_t max_vec = vld1q_f32(src + i);
+        for (int32_t c = 1; c < channel; c++) {
+            max_vec = vmaxq_f32(max_vec, vld1q_f32(src + c * plane_step + i));
+        }
+        float32x4_t sum_vec = vdupq_n_f32(0.0f);
+        for (int32_t c = 0; c < channel; c++) {
+            const float32x4_t e = ExpNeon(vsubq_f32(vld1q_f32(src + c * plane_step + i), max_vec));
+            vst1q_f32(dst + c * plane_step + i, e);
+            sum_vec = vaddq_f32(sum_vec, e);
+        }
+        /* reciprocal estimate + 2 Newton-Raphson steps (ARMv7 doesn't have vdivq_f32) */
+        float32x4_t inv_sum_vec = vrecpeq_f32(sum_vec);
+        inv_sum_vec = vmulq_f32(vrecpsq_f32(sum_vec, inv_sum_vec), inv_sum_vec);
+        inv_sum_vec = vmulq_f32(vrecpsq_f32(sum_vec, inv_sum_vec), inv_sum_vec);
+        for (int32_t c = 0; c < channel; c++) {
+            vst1q_f32(dst + c * plane_step + i, vmulq_f32(vld1q_f32(dst + c * plane_step + i), inv_sum_vec));
+        }
+    }
+    SoftmaxPlanarScalar(src + i, channel, num - i, plane_step, dst + i);
+}
+#endif
+
+void Softmax(const float* src, int32_t num, float* dst)
+{
+    switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    case kSimdAvx2:
+        SoftmaxAvx2(src, num, dst);
+        return;
+    case kSimdSse41:
+        SoftmaxSse41(src, num, dst);
+        return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+    case kSimdNeon:
+        SoftmaxNeon(src, num, dst);
+        return;
+#endif
+    default:
+        SoftmaxScalar(src, num, dst);
+        return;
+    }
+}
+
+void SoftmaxPlanar(const float* src, int32_t channel, int32_t num, int32_t plane_step, float* dst)
+{
+    switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    case kSimdAvx2:
+        SoftmaxPlanarAvx2(src, channel, num, plane_step, dst);
+        return;
+    case kSimdSse41:
+        SoftmaxPlanarSse41(src, channel, num, plane_step, dst);
+        return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+    case kSimdNeon:
+        SoftmaxPlanarNeon(src, channel, num, plane_step, dst);
+        return;
+#endif
+    default:
+        SoftmaxPlanarScalar(src, channel, num, plane_step, dst);
+        return;
+    }
+}
+
+
+/*** ArgMax ***/
+/* Scalar code (reference and fallback) */
+template<typename T>
+static void ArgMaxPlanarScalar(const T* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, T* dst_max)
+{
+    for (int32_t i = 0; i < num; i++) {
+        T max_val = src[i];
+        int32_t max_index = 0;
+        for (int32_t c = 1; c < channel; c++) {
+            if (src[c * plane_step + i] > max_val) {
+                max_val = src[c * plane_step + i];
+                max_index = c;
+            }
+        }
+        dst[i] = max_index;
+        if (dst_max) dst_max[i] = max_val;
+    }
+}
+
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+TARGET_SSE41 static inline __m128i Max8Sse41(__m128i a, __m128i b, const uint8_t*)
+{
+    return _mm_max_epu8(a, b);
+}
+
+TARGET_SSE41 static inline __m128i Max8Sse41(__m128i a, __m128i b, const int8_t*)
+{
+    return _mm_max_epi8(a, b);
+}
+
+TARGET_SSE41 static void ArgMaxPlanarSse41(const float* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, float* dst_max)
+{
+    int32_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        __m128 max_vec = _mm_loadu_ps(src + i);
+        __m128i index_vec = _mm_setzero_si128();
+        for (int32_t c = 1; c < channel; c++) {
+            const __m128 v = _mm_loadu_ps(src + c * plane_step + i);
+            const __m128 mask = _mm_cmpgt_ps(v, max_vec);
+            max_vec = _mm_blendv_ps(max_vec, v, mask);
+            index_vec = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(index_vec), _mm_castsi128_ps(_mm_set1_epi32(c)), mask));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), index_vec);
+        if (dst_max) _mm_storeu_ps(dst_max + i, max_vec);
+    }
+    ArgMaxPlanarScalar(src + i, channel, num - i, plane_step, dst + i, dst_max ? dst_max + i : nullptr);
+}
+
+/* channel <= 256 (index is kept in uint8) */
+template<typename T>
+TARGET_SSE41 static void ArgMax8PlanarSse41(const T* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, T* dst_max)
+{
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        __m128i max_vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i index_vec = _mm_setzero_si128();
+        for (int32_t c = 1; c < channel; c++) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + c * plane_step + i));
+            const __m128i new_max = Max8Sse41(max_vec, v, src);
+            /* v > max  <=>  max(max, v) != max */
+            const __m128i mask = _mm_xor_si128(_mm_cmpeq_epi8(new_max, max_vec), _mm_set1_epi8(-1));
+            index_vec = _mm_blendv_epi8(index_vec, _mm_set1_epi8(static_cast<char>(c)), mask);
+            max_vec = new_max;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_cvtepu8_epi32(index_vec));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_cvtepu8_epi32(_mm_srli_si128(index_vec, 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_cvtepu8_epi32(_mm_srli_si128(index_vec, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_cvtepu8_epi32(_mm_srli_si128(index_vec, 12)));
+        if (dst_max) _mm_storeu_si128(reinterpret_cast<__m128i*>(dst_max + i), max_vec);
+    }
+    ArgMaxPlanarScalar(src + i, channel, num - i, plane_step, dst + i, dst_max ? dst_max + i : nullptr);
+}
+
+TARGET_AVX2 static void ArgMaxPlanarAvx2(const float* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, float* dst_max)
+{
+    int32_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        __m256 max_vec = _mm256_loadu_ps(src + i);
+        __m256i index_vec = _mm256_setzero_si256();
+        for (int32_t c = 1; c < channel; c++) {
+            const __m256 v = _mm256_loadu_ps(src + c * plane_step + i);
+            const __m256 mask = _mm256_cmp_ps(v, max_vec, _CMP_GT_OQ);
+            max_vec = _mm256_blendv_ps(max_vec, v, mask);
+            index_vec = _mm256_blendv_epi8(index_vec, _mm256_set1_epi32(c), _mm256_castps_si256(mask));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), index_vec);
+        if (dst_max) _mm256_storeu_ps(dst_max + i, max_vec);
+    }
+    ArgMaxPlanarScalar(src + i, channel, num - i, plane_step, dst + i, dst_max ? dst_max + i : nullptr);
+}
+#endif
+
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+static void ArgMaxPlanarNeon(const float* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, float* dst_max)
+{
+    int32_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        float32x4_t max_vec = vld1q_f32(src + i);
+        uint32x4_t index_vec = vdupq_n_u32(0);
+        for (int32_t c = 1; c < channel; c++) {
+            const float32x4_t v = vld1q_f32(src + c * plane_step + i);
+            const uint32x4_t mask = vcgtq_f32(v, max_vec);
+            max_vec = vbslq_f32(mask, v, max_vec);
+            index_vec = vbslq_u32(mask, vdupq_n_u32(c), index_vec);
+        }
+        vst1q_s32(dst + i, vreinterpretq_s32_u32(index_vec));
+        if (dst_max) vst1q_f32(dst_max + i, max_vec);
+    }
+    ArgMaxPlanarScalar(src + i, channel, num - i, plane_step, dst + i, dst_max ? dst_max + i : nullptr);
+}
+
+static inline uint8x16_t CompareGreater8Neon(const uint8_t* a, uint8x16_t b, uint8x16_t* a_vec)
+{
+    *a_vec = vld1q_u8(a);
+    return vcgtq_u8(*a_vec, b);
+}
+
+static inline uint8x16_t CompareGreater8Neon(const int8_t* a, uint8x16_t b, uint8x16_t* a_vec)
+{
+    const int8x16_t v = vld1q_s8(a);
+    *a_vec = vreinterpretq_u8_s8(v);
+    return vcgtq_s8(v, vreinterpretq_s8_u8(b));
+}
+
+/* channel <= 256 (index is kept in uint8). Values are kept as uint8x16_t bit pattern */
+template<typename T>
+static void ArgMax8PlanarNeon(const T* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, T* dst_max)
+{
+    int32_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        uint8x16_t max_vec = vld1q_u8(reinterpret_cast<const uint8_t*>(src + i));
+        uint8x16_t index_vec = vdupq_n_u8(0);
+        for (int32_t c = 1; c < channel; c++) {
+            uint8x16_t v;
+            const uint8x16_t mask = CompareGreater8Neon(src + c * plane_step + i, max_vec, &v);
+            max_vec = vbslq_u8(mask, v, max_vec);
+            index_vec = vbslq_u8(mask, vdupq_n_u8(static_cast<uint8_t>(c)), index_vec);
+        }
+        const uint16x8_t lo = vmovl_u8(vget_low_u8(index_vec));
+        const uint16x8_t hi = vmovl_u8(vget_high_u8(index_vec));
+        vst1q_s32(dst + i + 0, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(lo))));
+        vst1q_s32(dst + i + 4, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(lo))));
+        vst1q_s32(dst + i + 8, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(hi))));
+        vst1q_s32(dst + i + 12, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(hi))));
+        if (dst_max) vst1q_u8(reinterpret_cast<uint8_t*>(dst_max + i), max_vec);
+    }
+    ArgMaxPlanarScalar(src + i, channel, num - i, plane_step, dst + i, dst_max ? dst_max + i : nullptr);
+}
+#endif
+
+void ArgMaxPlanar(const float* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, float* dst_max)
+{
+    switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    case kSimdAvx2:
+        ArgMaxPlanarAvx2(src, channel, num, plane_step, dst, dst_max);
+        return;
+    case kSimdSse41:
+        ArgMaxPlanarSse41(src, channel, num, plane_step, dst, dst_max);
+        return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+    case kSimdNeon:
+        ArgMaxPlanarNeon(src, channel, num, plane_step, dst, dst_max);
+        return;
+#endif
+    default:
+        ArgMaxPlanarScalar(src, channel, num, plane_step, dst, dst_max);
+        return;
+    }
+}
+
+template<typename T>
+static void ArgMax8Planar(const T* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, T* dst_max)
+{
+    if (channel <= 256) {
+        switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+        case kSimdAvx2:
+        case kSimdSse41:
+            ArgMax8PlanarSse41(src, channel, num, plane_step, dst, dst_max);
+            return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+        case kSimdNeon:
+            ArgMax8PlanarNeon(src, channel, num, plane_step, dst, dst_max);
+            return;
+#endif
+        default:
+            break;
+        }
+    }
+    ArgMaxPlanarScalar(src, channel, num, plane_step, dst, dst_max);
+}
+
+void ArgMaxPlanar(const uint8_t* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, uint8_t* dst_max)
+{
+    ArgMax8Planar(src, channel, num, plane_step, dst, dst_max);
+}
+
+void ArgMaxPlanar(const int8_t* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, int8_t* dst_max)
+{
+    ArgMax8Planar(src, channel, num, plane_step, dst, dst_max);
+}
+
+
+/*** Suppress overlap (NMS) ***/
+/* IoU > threshold  <=>  intersection > threshold * (area + area_j - intersection). Division is not used */
+/* Scalar code (reference and fallback) */
+static void SuppressOverlapScalar(const float* x0, const float* y0, const float* x1, const float* y1, const float* area, int32_t num, const float* box, float iou_threshold, uint8_t* suppressed)
+{
+    for (int32_t j = 0; j < num; j++) {
+        const float w = (std::max)(0.0f, (std::min)(box[2], x1[j]) - (std::max)(box[0], x0[j]));
+        const float h = (std::max)(0.0f, (std::min)(box[3], y1[j]) - (std::max)(box[1], y0[j]));
+        const float intersection = w * h;
+        if (intersection > iou_threshold * (box[4] + area[j] - intersection)) {
+            suppressed[j] = 1;
+        }
+    }
+}
+
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+TARGET_SSE41 static void SuppressOverlapSse41(const float* x0, const float* y0, const float* x1, const float* y1, const float* area, int32_t num, const float* box, float iou_threshold, uint8_t* suppressed)
+{
+    const __m128 box_x0 = _mm_set1_ps(box[0]);
+    const __m128 box_y0 = _mm_set1_ps(box[1]);
+    const __m128 box_x1 = _mm_set1_ps(box[2]);
+    const __m128 box_y1 = _mm_set1_ps(box[3]);
+    const __m128 box_area = _mm_set1_ps(box[4]);
+    const __m128 threshold = _mm_set1_ps(iou_threshold);
+    const __m128 zero = _mm_setzero_ps();
+    int32_t j = 0;
+    for (; j + 4 <= num; j += 4) {
+        const __m128 w = _mm_max_ps(zero, _mm_sub_ps(_mm_min_ps(box_x1, _mm_loadu_ps(x1 + j)), _mm_max_ps(box_x0, _mm_loadu_ps(x0 + j))));
+        const __m128 h = _mm_max_ps(zero, _mm_sub_ps(_mm_min_ps(box_y1, _mm_loadu_ps(y1 + j)), _mm_max_ps(box_y0, _mm_loadu_ps(y0 + j))));
+        const __m128 intersection = _mm_mul_ps(w, h);
+        const __m128 area_union = _mm_sub_ps(_mm_add_ps(box_area, _mm_loadu_ps(area + j)), intersection);
+        const int32_t mask = _mm_movemask_ps(_mm_cmpgt_ps(intersection, _mm_mul_ps(threshold, area_union)));
+        for (int32_t k = 0; k < 4; k++) {
+            suppressed[j + k] |= (mask >> k) & 1;
+        }
+    }
+    SuppressOverlapScalar(x0 + j, y0 + j, x1 + j, y1 + j, area + j, num - j, box, iou_threshold, suppressed + j);
+}
+
+TARGET_AVX2 static void SuppressOverlapAvx2(const float* x0, const float* y0, const float* x1, const float* y1, const float* area, int32_t num, const float* box, float iou_threshold, uint8_t* suppressed)
+{
+    const __m256 box_x0 = _mm256_set1_ps(box[0]);
+    const __m256 box_y0 = _mm256_set1_ps(box[1]);
+    const __m256 box_x1 = _mm256_set1_ps(box[2]);
+    const __m256 box_y1 = _mm256_set1_ps(box[3]);
+    const __m256 box_area = _mm256_set1_ps(box[4]);
+    const __m256 threshold = _mm256_set1_ps(iou_threshold);
+    const __m256 zero = _mm256_setzero_ps();
+    int32_t j = 0;
+    for (; j + 8 <= num; j += 8) {
+        const __m256 w = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(box_x1, _mm256_loadu_ps(x1 + j)), _mm256_max_ps(box_x0, _mm256_loadu_ps(x0 + j))));
+        const __m256 h = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(box_y1, _mm256_loadu_ps(y1 + j)), _mm256_max_ps(box_y0, _mm256_loadu_ps(y0 + j))));
+        const __m256 intersection = _mm256_mul_ps(w, h);
+        const __m256 area_union = _mm256_sub_ps(_mm256_add_ps(box_area, _mm256_loadu_ps(area + j)), intersection);
+        const int32_t mask = _mm256_movemask_ps(_mm256_cmp_ps(intersection, _mm256_mul_ps(threshold, area_union), _CMP_GT_OQ));
+        for (int32_t k = 0; k < 8; k++) {
+            suppressed[j + k] |= (mask >> k) & 1;
+        }
+    }
+    SuppressOverlapScalar(x0 + j, y0 + j, x1 + j, y1 + j, area + j, num - j, box, iou_threshold, suppressed + j);
+}
+#endif
+
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+static void SuppressOverlapNeon(const float* x0, const float* y0, const float* x1, const float* y1, const float* area, int32_t num, const float* box, float iou_threshold, uint8_t* suppressed)
+{
+    const float32x4_t box_x0 = vdupq_n_f32(box[0]);
+    const float32x4_t box_y0 = vdupq_n_f32(box[1]);
+    const float32x4_t box_x1 = vdupq_n_f32(box[2]);
+    const float32x4_t box_y1 = vdupq_n_f32(box[3]);
+    const float32x4_t box_area = vdupq_n_f32(box[4]);
+    const float32x4_t threshold = vdupq_n_f32(iou_threshold);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    int32_t j = 0;
+    for (; j + 4 <= num; j += 4) {
+        const float32x4_t w = vmaxq_f32(zero, vsubq_f32(vminq_f32(box_x1, vld1q_f32(x1 + j)), vmaxq_f32(box_x0, vld1q_f32(x0 + j))));
+        const float32x4_t h = vmaxq_f32(zero, vsubq_f32(vminq_f32(box_y1, vld1q_f32(y1 + j)), vmaxq_f32(box_y0, vld1q_f32(y0 + j))));
+        const float32x4_t intersection = vmulq_f32(w, h);
+        const float32x4_t area_union = vsubq_f32(vaddq_f32(box_area, vld1q_f32(area + j)), intersection);
+        uint32_t mask[4];
+        vst1q_u32(mask, vcgtq_f32(intersection, vmulq_f32(threshold, area_union)));
+        for (int32_t k = 0; k < 4; k++) {
+            suppressed[j + k] |= mask[k] & 1;
+        }
+    }
+    SuppressOverlapScalar(x0 + j, y0 + j, x1 + j, y1 + j, area + j, num - j, box, iou_threshold, suppressed + j);
+}
+#endif
+
+void SuppressOverlap(const float* x0, const float* y0, const float* x1, const float* y1, const float* area, int32_t num, const float* box, float iou_threshold, uint8_t* suppressed)
+{
+    switch (GetSimdLevel()) {
+#if defined(INFERENCE_HELPER_KERNEL_X86)
+    case kSimdAvx2:
+        SuppressOverlapAvx2(x0, y0, x1, y1, area, num, box, iou_threshold, suppressed);
+        return;
+    case kSimdSse41:
+        SuppressOverlapSse41(x0, y0, x1, y1, area, num, box, iou_threshold, suppressed);
+        return;
+#endif
+#if defined(INFERENCE_HELPER_KERNEL_NEON)
+    case kSimdNeon:
+        SuppressOverlapNeon(x0, y0, x1, y1, area, num, box, iou_threshold, suppressed);
+        return;
+#endif
+    default:
+        SuppressOverlapScalar(x0, y0, x1, y1, area, num, box, iou_threshold, suppressed);
+        return;
+    }
+}
+
+}
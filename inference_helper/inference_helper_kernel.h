@@ -0,0 +1,124 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef INFERENCE_HELPER_KERNEL_
+#define INFERENCE_HELPER_KERNEL_
+
+/* for general */
+#include <cstdint>
+
+/* Low level kernels used by InferenceHelper (pre-process, etc.)
+ * SIMD code (SSE4.1 / AVX2 on x86, NEON on ARM) is selected at runtime, and the scalar code is used as fallback
+ */
+namespace InferenceHelperKernel {
+
+enum {
+    kSimdNone,
+    kSimdSse41,
+    kSimdAvx2,
+    kSimdNeon,
+};
+
+/* SIMD level used by kernels. x86: detected at runtime, ARM: decided at build time */
+int32_t GetSimdLevel();
+/* Limit SIMD level (e.g. kSimdNone to compare with scalar code). The level is never raised above the detected one */
+void SetSimdLevel(int32_t simd_level);
+
+/* dst[i * channel + c] = (src[i * channel + c] - mean[c]) * norm[c]  (i < num) */
+void NormalizeInterleaved(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* dst);
+
+/* dst_plane[c][i] = (src[i * channel + c] - mean[c]) * norm[c]  (i < num) */
+void NormalizePlanar(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, float* const* dst_plane);
+
+/* dst_plane[c][i] = src[i * channel + c]  (i < num) */
+void Deinterleave(const uint8_t* src, int32_t channel, int32_t num, uint8_t* const* dst_plane);
+
+
+enum {
+    kColorConversionNone,
+    kColorConversionSwapRb,     // RGB -> BGR, BGR -> RGB
+    kColorConversionRgbToGray,
+    kColorConversionBgrToGray,
+    kColorConversionGrayToRgb,  // also used for GRAY -> BGR
+};
+
+/* Convert color of num pixels (packed) */
+void ConvertColor(const uint8_t* src, int32_t color_conversion, int32_t num, uint8_t* dst);
+
+/* Convert pixels [x, x + num) of one YUV420 row into packed RGB (BT.601 limited range, the same as OpenCV)
+ * src_y, src_u and src_v point to the top of the row. uv_step is the distance between chroma samples (NV12/NV21: 2, I420: 1)
+ */
+void ConvertYuv420ToRgb(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v, int32_t uv_step, int32_t x, int32_t num, uint8_t* dst);
+
+
+/* Bilinear resize uses fixed point weight (weight of the second pixel, 0 - kResizeWeightOne) */
+static constexpr int32_t kResizeWeightBits = 11;
+static constexpr int32_t kResizeWeightOne = 1 << kResizeWeightBits;
+
+/* Calculate a table to map dst coordinate to src coordinate (aligned at pixel center, the same as OpenCV)
+ * offset0[i] and offset1[i] are the neighbor pixels multiplied by step, and weight[i] is the weight for offset1[i]
+ */
+void CalculateResizeTable(int32_t src_size, int32_t dst_size, int32_t step, int32_t* offset0, int32_t* offset1, int16_t* weight);
+
+/* Resize one row by bilinear interpolation. x_* are the table for x (step = channel), y_weight is the weight for src_row1 */
+void ResizeBilinearRow(const uint8_t* src_row0, const uint8_t* src_row1, int32_t channel, int32_t width, const int32_t* x_offset0, const int32_t* x_offset1, const int16_t* x_weight, int32_t y_weight, uint8_t* dst);
+
+
+/* Transpose a rows x cols block: dst[j * dst_stride + i] = src[i * src_stride + j]. Stride is in element
+ * element_size is 1, 2, 4 or 8 (byte). Data is copied as bit pattern, so any type of the size can be used
+ */
+void TransposeBlock(const void* src, int32_t src_stride, int32_t rows, int32_t cols, int32_t element_size, void* dst, int32_t dst_stride);
+
+
+/* dst[i] = (src[i] - zero_point) * scale  (i < num) */
+void Dequantize(const uint8_t* src, int32_t num, int32_t zero_point, float scale, float* dst);
+void Dequantize(const int8_t* src, int32_t num, int32_t zero_point, float scale, float* dst);
+
+/* Type conversion of num elements. fp16 (IEEE half) and bf16 are bit patterns in uint16_t
+ * float -> fp16 / bf16 is rounded to nearest even. fp16 uses F16C (with AVX2) on x86 and NEON fp16 on ARM
+ */
+void ConvertFp16ToFp32(const uint16_t* src, int32_t num, float* dst);
+void ConvertFp32ToFp16(const float* src, int32_t num, uint16_t* dst);
+void ConvertBf16ToFp32(const uint16_t* src, int32_t num, float* dst);
+void ConvertFp32ToBf16(const float* src, int32_t num, uint16_t* dst);
+void ConvertInt32ToFp32(const int32_t* src, int32_t num, float* dst);
+void ConvertInt64ToFp32(const int64_t* src, int32_t num, float* dst);
+
+/* The same as NormalizeInterleaved / NormalizePlanar, but the result is stored in fp16. channel is 1 - 4 (the size of mean and norm in PreProcessPlan) */
+void NormalizeInterleavedFp16(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, uint16_t* dst);
+void NormalizePlanarFp16(const uint8_t* src, int32_t channel, int32_t num, const float* mean, const float* norm, uint16_t* const* dst_plane);
+
+
+/* dst[i] = exp(src[i] - max) / sum_j(exp(src[j] - max))  (i, j < num). src and dst can be the same buffer */
+void Softmax(const float* src, int32_t num, float* dst);
+
+/* Softmax over channel for each i (i < num): src[c * plane_step + i] (c < channel). e.g. NCHW tensor. src and dst can be the same buffer */
+void SoftmaxPlanar(const float* src, int32_t channel, int32_t num, int32_t plane_step, float* dst);
+
+/* dst[i] = argmax_c(src[c * plane_step + i]) (c < channel, i < num). The first channel is taken for ties
+ * dst_max[i] = max value (dst_max can be nullptr)
+ */
+void ArgMaxPlanar(const float* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, float* dst_max);
+void ArgMaxPlanar(const uint8_t* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, uint8_t* dst_max);
+void ArgMaxPlanar(const int8_t* src, int32_t channel, int32_t num, int32_t plane_step, int32_t* dst, int8_t* dst_max);
+
+
+/* suppressed[j] = 1 if IoU(box, box_j) > iou_threshold (j < num). Otherwise suppressed[j] is not changed
+ * box_j is (x0[j], y0[j], x1[j], y1[j]) and area[j] is its area. box is {x0, y0, x1, y1, area}
+ */
+void SuppressOverlap(const float* x0, const float* y0, const float* x1, const float* y1, const float* area, int32_t num, const float* box, float iou_threshold, uint8_t* suppressed);
+
+}
+
+#endif
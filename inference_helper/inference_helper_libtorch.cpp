@@ -105,9 +105,10 @@ int32_t InferenceHelperLibtorch::Initialize(const std::string& model_filename, s
     module_.to(device_type_);
     module_.eval();
 
-    /*** Convert normalize parameter to speed up ***/
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /*** Compile pre-process for each input tensor (normalize parameters are converted to speed up). Buffer is allocated for each frame ***/
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, nullptr);
     }
 
     return kRetOk;
@@ -126,12 +127,9 @@ int32_t InferenceHelperLibtorch::PreProcess(const std::vector<InputTensorInfo>&
     /* Todo: there may be a way to reuse allocated GPU memory */
     input_tensor_list_.clear();
 
-    /*** Normalize input data and store the converted data into the input tensor buffer ***/
-    for (size_t input_tensor_index = 0; input_tensor_index < input_tensor_info_list.size(); input_tensor_index++) {
+    std::vector<torch::Tensor> input_tensor_cpu_list;
+    for (size_t input_tensor_index = 0; input_tensor_index < input_tensor_info_list.size() && input_tensor_index < pre_process_plan_list_.size(); input_tensor_index++) {
         const auto& input_tensor_info = input_tensor_info_list[input_tensor_index];
-        const int32_t img_width = input_tensor_info.GetWidth();
-        const int32_t img_height = input_tensor_info.GetHeight();
-        const int32_t img_channel = input_tensor_info.GetChannel();
 
         torch::TensorOptions tensor_options;
         if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
@@ -142,55 +140,16 @@ int32_t InferenceHelperLibtorch::PreProcess(const std::vector<InputTensorInfo>&
             sizes.push_back(v);
         }
         torch::Tensor input_tensor = torch::zeros(sizes, tensor_options);
+        pre_process_plan_list_[input_tensor_index].dst = input_tensor.data_ptr();
+        input_tensor_cpu_list.push_back(input_tensor);
+    }
 
+    /*** Normalize input data and store the converted data into the input tensor buffer ***/
+    if (RunPreProcessPlan(num_threads_, input_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
 
-        if (input_tensor_info.data_type == InputTensorInfo::kDataTypeImage) {
-            if ((input_tensor_info.image_info.width != input_tensor_info.image_info.crop_width) || (input_tensor_info.image_info.height != input_tensor_info.image_info.crop_height)) {
-                PRINT_E("Crop is not supported\n");
-                return  kRetErr;
-            }
-            if ((input_tensor_info.image_info.crop_width != img_width) || (input_tensor_info.image_info.crop_height != img_height)) {
-                PRINT_E("Resize is not supported\n");
-                return  kRetErr;
-            }
-            if (input_tensor_info.image_info.channel != img_channel) {
-                PRINT_E("Color conversion is not supported\n");
-                return  kRetErr;
-            }
-            
-            /* Normalize image */
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = (float*)(input_tensor.data_ptr());
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8) {
-                uint8_t* dst = (uint8_t*)(input_tensor.data_ptr());
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                int8_t* dst = (int8_t*)(input_tensor.data_ptr());
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else if ((input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) || (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw)) {
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = (float*)(input_tensor.data_ptr());
-                PreProcessBlob<float>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8 || input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                uint8_t* dst = (uint8_t*)(input_tensor.data_ptr());
-                PreProcessBlob<uint8_t>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt32) {
-                int32_t* dst = (int32_t*)(input_tensor.data_ptr());
-                PreProcessBlob<int32_t>(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else {
-            PRINT_E("Unsupported data_type (%d)\n", input_tensor_info.data_type);
-            return kRetErr;
-        }
-
+    for (auto& input_tensor : input_tensor_cpu_list) {
         input_tensor_list_.push_back(input_tensor.to(device_type_));
     }
     
@@ -249,5 +208,9 @@ int32_t InferenceHelperLibtorch::Process(std::vector<OutputTensorInfo>& output_t
         tensor_info.data = output_tensor.data_ptr();
     }
 
+    if (ConvertOutputLayout(num_threads_, true, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
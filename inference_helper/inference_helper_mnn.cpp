@@ -133,9 +133,10 @@ int32_t InferenceHelperMnn::Initialize(const std::string& model_filename, std::v
         /* Output size is set when run inference later */
     }
 
-    /* Convert normalize parameter to speed up */
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /* Compile pre-process for each input tensor (normalize parameters are converted to speed up). Only normalize parameters are used */
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, nullptr);
     }
 
 
@@ -172,7 +173,17 @@ int32_t InferenceHelperMnn::Finalize(void)
 
 int32_t InferenceHelperMnn::PreProcess(const std::vector<InputTensorInfo>& input_tensor_info_list)
 {
-    for (const auto& input_tensor_info : input_tensor_info_list) {
+    if (input_tensor_info_list.size() != pre_process_plan_list_.size()) {
+        PRINT_E("The number of input tensors is different from Initialize (%zu != %zu)\n", input_tensor_info_list.size(), pre_process_plan_list_.size());
+        return kRetErr;
+    }
+    for (size_t input_tensor_index = 0; input_tensor_index < input_tensor_info_list.size(); input_tensor_index++) {
+        const auto& input_tensor_info = input_tensor_info_list[input_tensor_index];
+        const auto& plan = pre_process_plan_list_[input_tensor_index];
+        if (!input_tensor_info.batch_list.empty()) {
+            PRINT_E("batch_list is not supported\n");
+            return kRetErr;
+        }
         auto input_tensor = net_->getSessionInput(session_, input_tensor_info.name.c_str());
         if (input_tensor == nullptr) {
             PRINT_E("Invalid input name (%s)\n", input_tensor_info.name.c_str());
@@ -184,6 +195,11 @@ int32_t InferenceHelperMnn::PreProcess(const std::vector<InputTensorInfo>& input
                 PRINT_E("Crop is not supported\n");
                 return kRetErr;
             }
+            /* Letterbox */
+            if (input_tensor_info.image_info.letterbox != InputTensorInfo::kLetterboxNone) {
+                PRINT_E("Letterbox is not supported\n");
+                return kRetErr;
+            }
 
             MNN::CV::ImageProcess::Config image_processconfig;
             /* Convert color type */
@@ -209,8 +225,8 @@ int32_t InferenceHelperMnn::PreProcess(const std::vector<InputTensorInfo>& input
             }
 
             /* Normalize image */
-            std::memcpy(image_processconfig.mean, input_tensor_info.normalize.mean, sizeof(image_processconfig.mean));
-            std::memcpy(image_processconfig.normal, input_tensor_info.normalize.norm, sizeof(image_processconfig.normal));
+            std::memcpy(image_processconfig.mean, plan.mean, sizeof(image_processconfig.mean));
+            std::memcpy(image_processconfig.normal, plan.norm, sizeof(image_processconfig.normal));
             
             /* Resize image */
             image_processconfig.filterType = MNN::CV::BILINEAR;
@@ -220,7 +236,7 @@ int32_t InferenceHelperMnn::PreProcess(const std::vector<InputTensorInfo>& input
             /* Do pre-process */
             std::shared_ptr<MNN::CV::ImageProcess> pretreat(MNN::CV::ImageProcess::create(image_processconfig));
             pretreat->setMatrix(trans);
-            pretreat->convert(static_cast<uint8_t*>(input_tensor_info.data), input_tensor_info.image_info.crop_width, input_tensor_info.image_info.crop_height, 0, input_tensor);
+            pretreat->convert(static_cast<uint8_t*>(input_tensor_info.data), input_tensor_info.image_info.crop_width, input_tensor_info.image_info.crop_height, input_tensor_info.image_info.stride, input_tensor);
         } else if ( (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) || (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw) ) {
             std::unique_ptr<MNN::Tensor> tensor;
             if (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) {
@@ -251,7 +267,8 @@ int32_t InferenceHelperMnn::Process(std::vector<OutputTensorInfo>& output_tensor
     net_->runSession(session_);
 
     out_mat_list_.clear();
-    for (auto& output_tensor_info : output_tensor_info_list) {
+    for (int32_t i = 0; i < static_cast<int32_t>(output_tensor_info_list.size()); i++) {
+        auto& output_tensor_info = output_tensor_info_list[i];
         auto output_tensor = net_->getSessionOutput(session_, output_tensor_info.name.c_str());
         if (output_tensor == nullptr) {
             PRINT_E("Invalid output name (%s)\n", output_tensor_info.name.c_str());
@@ -279,7 +296,13 @@ int32_t InferenceHelperMnn::Process(std::vector<OutputTensorInfo>& output_tensor
         }
 
         out_mat_list_.push_back(std::move(outputUser));	// store data in member variable so that data keep exist
+
+        /* The layout is decided for each tensor by the model (TENSORFLOW: NHWC, CAFFE: NCHW) */
+        if (ConvertOutputLayout(num_threads_, dimType != MNN::Tensor::TENSORFLOW, i, output_tensor_info) != kRetOk) {
+            return kRetErr;
+        }
     }
 
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
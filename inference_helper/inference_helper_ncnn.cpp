@@ -140,9 +140,10 @@ int32_t InferenceHelperNcnn::Initialize(const std::string& model_filename, std::
         return kRetErr;
     }
 
-    /* Convert normalize parameter to speed up */
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /* Compile pre-process for each input tensor (normalize parameters are converted to speed up). Only normalize parameters are used */
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, nullptr);
     }
 
     /* Check if tensor info is set */
@@ -181,7 +182,17 @@ int32_t InferenceHelperNcnn::Finalize(void)
 int32_t InferenceHelperNcnn::PreProcess(const std::vector<InputTensorInfo>& input_tensor_info_list)
 {
     in_mat_list_.clear();
-    for (const auto& input_tensor_info : input_tensor_info_list) {
+    if (input_tensor_info_list.size() != pre_process_plan_list_.size()) {
+        PRINT_E("The number of input tensors is different from Initialize (%zu != %zu)\n", input_tensor_info_list.size(), pre_process_plan_list_.size());
+        return kRetErr;
+    }
+    for (size_t input_tensor_index = 0; input_tensor_index < input_tensor_info_list.size(); input_tensor_index++) {
+        const auto& input_tensor_info = input_tensor_info_list[input_tensor_index];
+        const auto& plan = pre_process_plan_list_[input_tensor_index];
+        if (!input_tensor_info.batch_list.empty()) {
+            PRINT_E("batch_list is not supported\n");
+            return kRetErr;
+        }
         ncnn::Mat ncnn_mat;
         if (input_tensor_info.data_type == InputTensorInfo::kDataTypeImage) {
             /* Crop */
@@ -189,6 +200,11 @@ int32_t InferenceHelperNcnn::PreProcess(const std::vector<InputTensorInfo>& inpu
                 PRINT_E("Crop is not supported\n");
                 return kRetErr;
             }
+            /* Letterbox */
+            if (input_tensor_info.image_info.letterbox != InputTensorInfo::kLetterboxNone) {
+                PRINT_E("Letterbox is not supported\n");
+                return kRetErr;
+            }
             /* Convert color type */
             int32_t pixel_type = 0;
             if ((input_tensor_info.image_info.channel == 3) && (input_tensor_info.GetChannel() == 3)) {
@@ -207,15 +223,16 @@ int32_t InferenceHelperNcnn::PreProcess(const std::vector<InputTensorInfo>& inpu
                 return kRetErr;
             }
             
+            const int32_t stride = (input_tensor_info.image_info.stride > 0) ? input_tensor_info.image_info.stride : input_tensor_info.image_info.width * input_tensor_info.image_info.channel;
             if (input_tensor_info.image_info.crop_width == input_tensor_info.GetWidth() && input_tensor_info.image_info.crop_height == input_tensor_info.GetHeight()) {
                 /* Convert to blob */
-                ncnn_mat = ncnn::Mat::from_pixels((uint8_t*)input_tensor_info.data, pixel_type, input_tensor_info.image_info.width, input_tensor_info.image_info.height);
+                ncnn_mat = ncnn::Mat::from_pixels((uint8_t*)input_tensor_info.data, pixel_type, input_tensor_info.image_info.width, input_tensor_info.image_info.height, stride);
             } else {
                 /* Convert to blob with resize */
-                ncnn_mat = ncnn::Mat::from_pixels_resize((uint8_t*)input_tensor_info.data, pixel_type, input_tensor_info.image_info.width, input_tensor_info.image_info.height, input_tensor_info.GetWidth(), input_tensor_info.GetHeight());
+                ncnn_mat = ncnn::Mat::from_pixels_resize((uint8_t*)input_tensor_info.data, pixel_type, input_tensor_info.image_info.width, input_tensor_info.image_info.height, stride, input_tensor_info.GetWidth(), input_tensor_info.GetHeight());
             }
             /* Normalize image */
-            ncnn_mat.substract_mean_normalize(input_tensor_info.normalize.mean, input_tensor_info.normalize.norm);
+            ncnn_mat.substract_mean_normalize(plan.mean, plan.norm);
         } else if (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) {
             PRINT_E("[ToDo] Unsupported data type (%d)\n", input_tensor_info.data_type);
             ncnn_mat = ncnn::Mat::from_pixels((uint8_t*)input_tensor_info.data, input_tensor_info.GetChannel() == 3 ? ncnn::Mat::PIXEL_RGB : ncnn::Mat::PIXEL_GRAY, input_tensor_info.GetWidth(), input_tensor_info.GetHeight());
@@ -245,7 +262,21 @@ int32_t InferenceHelperNcnn::Process(std::vector<OutputTensorInfo>& output_tenso
     out_mat_list_.clear();
     for (auto& output_tensor_info : output_tensor_info_list) {
         ncnn::Mat ncnn_out;
-        if (ex.extract(output_tensor_info.name.c_str(), ncnn_out) != 0) {
+        if (output_tensor_info.tensor_type == TensorInfo::kTensorTypeFp16) {
+            /* Keep fp16 storage without conversion to fp32 (type = 1). Only packing is converted */
+            ncnn::Mat ncnn_raw;
+            if (ex.extract(output_tensor_info.name.c_str(), ncnn_raw, 1) != 0) {
+                PRINT_E("Output mat error (%s)\n", output_tensor_info.name.c_str());
+                return kRetErr;
+            }
+            ncnn::Mat ncnn_unpacked;
+            ncnn::convert_packing(ncnn_raw, ncnn_unpacked, 1, net_->opt);
+            if (ncnn_unpacked.elemsize == 2) {
+                ncnn_out = ncnn_unpacked;
+            } else {
+                ncnn::cast_float32_to_float16(ncnn_unpacked, ncnn_out, net_->opt);
+            }
+        } else if (ex.extract(output_tensor_info.name.c_str(), ncnn_out) != 0) {
             PRINT_E("Output mat error (%s)\n", output_tensor_info.name.c_str());
             return kRetErr;
         }
@@ -258,5 +289,9 @@ int32_t InferenceHelperNcnn::Process(std::vector<OutputTensorInfo>& output_tenso
         output_tensor_info.tensor_dims.push_back(ncnn_out.w);
     }
 
+    if (ConvertOutputLayout(num_threads_, true, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
@@ -99,9 +99,10 @@ int32_t InferenceHelperNnabla::Initialize(const std::string& model_filename, std
         return kRetErr;
     }
 
-    /* Convert normalize parameter to speed up */
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /* Compile pre-process for each input tensor (normalize parameters are converted to speed up). Buffer is set for each frame */
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, nullptr);
     }
 
     return kRetOk;
@@ -116,58 +117,30 @@ int32_t InferenceHelperNnabla::Finalize(void)
 
 int32_t InferenceHelperNnabla::PreProcess(const std::vector<InputTensorInfo>& input_tensor_info_list)
 {
-    for (const auto& input_tensor_info : input_tensor_info_list) {
-        const int32_t img_width = input_tensor_info.GetWidth();
-        const int32_t img_height = input_tensor_info.GetHeight();
-        const int32_t img_channel = input_tensor_info.GetChannel();
-        if (input_tensor_info.data_type == InputTensorInfo::kDataTypeImage) {
-            if ((input_tensor_info.image_info.width != input_tensor_info.image_info.crop_width) || (input_tensor_info.image_info.height != input_tensor_info.image_info.crop_height)) {
-                PRINT_E("Crop is not supported\n");
-                return  kRetErr;
-            }
-            if ((input_tensor_info.image_info.crop_width != img_width) || (input_tensor_info.image_info.crop_height != img_height)) {
-                PRINT_E("Resize is not supported\n");
-                return  kRetErr;
-            }
-            if (input_tensor_info.image_info.channel != img_channel) {
-                PRINT_E("Color conversion is not supported\n");
-                return  kRetErr;
-            }
-
-            /* Normalize image */
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = GetInputVariable(input_tensor_info.id)->cast_data_and_get_pointer<float>(*ctx_cpu_);
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8) {
-                uint8_t* dst = GetInputVariable(input_tensor_info.id)->cast_data_and_get_pointer<uint8_t>(*ctx_cpu_);
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                int8_t* dst = GetInputVariable(input_tensor_info.id)->cast_data_and_get_pointer<int8_t>(*ctx_cpu_);
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else if ((input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) || (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw)) {
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = GetInputVariable(input_tensor_info.id)->cast_data_and_get_pointer<float>(*ctx_cpu_);
-                PreProcessBlob<float>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8 || input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                uint8_t* dst = GetInputVariable(input_tensor_info.id)->cast_data_and_get_pointer<uint8_t>(*ctx_cpu_);
-                PreProcessBlob<uint8_t>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt32) {
-                int32_t* dst = GetInputVariable(input_tensor_info.id)->cast_data_and_get_pointer<int32_t>(*ctx_cpu_);
-                PreProcessBlob<int32_t>(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else {
-            PRINT_E("Unsupported data_type (%d)\n", input_tensor_info.data_type);
-            return kRetErr;
+    /* Get buffer on CPU for each frame, because the data is moved to the device at forward */
+    for (size_t i = 0; i < input_tensor_info_list.size() && i < pre_process_plan_list_.size(); i++) {
+        const auto& input_tensor_info = input_tensor_info_list[i];
+        const auto& variable = GetInputVariable(input_tensor_info.id);
+        switch (input_tensor_info.tensor_type) {
+        case TensorInfo::kTensorTypeFp32:
+            pre_process_plan_list_[i].dst = variable->cast_data_and_get_pointer<float>(*ctx_cpu_);
+            break;
+        case TensorInfo::kTensorTypeUint8:
+            pre_process_plan_list_[i].dst = variable->cast_data_and_get_pointer<uint8_t>(*ctx_cpu_);
+            break;
+        case TensorInfo::kTensorTypeInt8:
+            pre_process_plan_list_[i].dst = variable->cast_data_and_get_pointer<int8_t>(*ctx_cpu_);
+            break;
+        case TensorInfo::kTensorTypeInt32:
+            pre_process_plan_list_[i].dst = variable->cast_data_and_get_pointer<int32_t>(*ctx_cpu_);
+            break;
+        default:
+            break;
         }
     }
-    return kRetOk;
+
+    /* Crop, resize, color conversion and normalize (image), or copy (blob) by the plan compiled at Initialize */
+    return RunPreProcessPlan(num_threads_, input_tensor_info_list);
 }
 
 int32_t InferenceHelperNnabla::Process(std::vector<OutputTensorInfo>& output_tensor_info_list)
@@ -213,6 +186,10 @@ int32_t InferenceHelperNnabla::Process(std::vector<OutputTensorInfo>& output_ten
         PRINT_E("Exception: %s\n", e.what());
         return kRetErr;
     }
+    if (ConvertOutputLayout(num_threads_, true, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
 
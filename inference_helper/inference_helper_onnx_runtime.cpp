@@ -61,7 +61,7 @@ static constexpr const char* DATA_TYPE_ID_TO_NAME_MAP[] = {
     "uint64",  // ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64
     nullptr,   // ONNX_TENSOR_ELEMENT_DATA_TYPE_COMPLEX64
     nullptr,   // ONNX_TENSOR_ELEMENT_DATA_TYPE_COMPLEX128
-    nullptr    // ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16
+    "bfloat16" // ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16
 };
 
 
@@ -173,11 +173,15 @@ int32_t InferenceHelperOnnxRuntime::Initialize(const std::string& model_filename
         }
     }
 
-    /*** Convert normalize parameter to speed up ***/
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /* Compile pre-process for each input tensor (normalize parameters are converted to speed up) */
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, input_buffer_list_[input_tensor_info.id].get());
     }
 
+    /* PreProcess runs only the plan, so that it can be pipelined (PreProcessToSlot) */
+    is_pre_process_stageable_ = true;
+
     return kRetOk;
 };
 
@@ -196,58 +200,8 @@ int32_t InferenceHelperOnnxRuntime::Finalize(void)
 
 int32_t InferenceHelperOnnxRuntime::PreProcess(const std::vector<InputTensorInfo>& input_tensor_info_list)
 {
-    for (const auto& input_tensor_info : input_tensor_info_list) {
-        const int32_t img_width = input_tensor_info.GetWidth();
-        const int32_t img_height = input_tensor_info.GetHeight();
-        const int32_t img_channel = input_tensor_info.GetChannel();
-        if (input_tensor_info.data_type == InputTensorInfo::kDataTypeImage) {
-            if ((input_tensor_info.image_info.width != input_tensor_info.image_info.crop_width) || (input_tensor_info.image_info.height != input_tensor_info.image_info.crop_height)) {
-                PRINT_E("Crop is not supported\n");
-                return  kRetErr;
-            }
-            if ((input_tensor_info.image_info.crop_width != img_width) || (input_tensor_info.image_info.crop_height != img_height)) {
-                PRINT_E("Resize is not supported\n");
-                return  kRetErr;
-            }
-            if (input_tensor_info.image_info.channel != img_channel) {
-                PRINT_E("Color conversion is not supported\n");
-                return  kRetErr;
-            }
-
-            /* Normalize image */
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = (float*)(input_buffer_list_[input_tensor_info.id].get());
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8) {
-                uint8_t* dst = (uint8_t*)(input_buffer_list_[input_tensor_info.id].get());
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                int8_t* dst = (int8_t*)(input_buffer_list_[input_tensor_info.id].get());
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else if ((input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) || (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw)) {
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = (float*)(input_buffer_list_[input_tensor_info.id].get());
-                PreProcessBlob<float>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8 || input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                uint8_t* dst = (uint8_t*)(input_buffer_list_[input_tensor_info.id].get());
-                PreProcessBlob<uint8_t>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt32) {
-                int32_t* dst = (int32_t*)(input_buffer_list_[input_tensor_info.id].get());
-                PreProcessBlob<int32_t>(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else {
-            PRINT_E("Unsupported data_type (%d)\n", input_tensor_info.data_type);
-            return kRetErr;
-        }
-    }
-    return kRetOk;
+    /* Crop, resize, color conversion and normalize (image), or copy (blob) by the plan compiled at Initialize */
+    return RunPreProcessPlan(num_threads_, input_tensor_info_list);
 }
 
 int32_t InferenceHelperOnnxRuntime::Process(std::vector<OutputTensorInfo>& output_tensor_info_list)
@@ -268,6 +222,10 @@ int32_t InferenceHelperOnnxRuntime::Process(std::vector<OutputTensorInfo>& outpu
         return kRetErr;
     }
 
+    if (ConvertOutputLayout(num_threads_, true, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
 
@@ -375,6 +333,20 @@ int32_t InferenceHelperOnnxRuntime::AllocateTensor(bool is_input, size_t index,
         }
         byte_count *= sizeof(int64_t);
         break;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+        if (tensor_info->tensor_type != TensorInfo::kTensorTypeFp16) {
+            PRINT_E("%s: tensor_type doesn't match. %s != %d\n", name_from_model_str.c_str(), DATA_TYPE_ID_TO_NAME_MAP[element_type], tensor_info->tensor_type);
+            return kRetErr;
+        }
+        byte_count *= sizeof(uint16_t);
+        break;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+        if (tensor_info->tensor_type != TensorInfo::kTensorTypeBf16) {
+            PRINT_E("%s: tensor_type doesn't match. %s != %d\n", name_from_model_str.c_str(), DATA_TYPE_ID_TO_NAME_MAP[element_type], tensor_info->tensor_type);
+            return kRetErr;
+        }
+        byte_count *= sizeof(uint16_t);
+        break;
     }
     buffer = std::make_unique<uint8_t[]>(byte_count);
     tensor = Ort::Value::CreateTensor(memory_info, buffer.get(), byte_count, shape.data(), shape.size(), element_type);
@@ -138,9 +138,10 @@ int32_t InferenceHelperOpenCV::Initialize(const std::string& model_filename, std
         }
     }
 
-    /* Convert normalize parameter to speed up */
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /* Compile pre-process for each input tensor (normalize parameters are converted to speed up). Only normalize parameters are used */
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, nullptr);
     }
 
     /* Check if tensor info is set */
@@ -173,11 +174,27 @@ int32_t InferenceHelperOpenCV::Finalize(void)
 int32_t InferenceHelperOpenCV::PreProcess(const std::vector<InputTensorInfo>& input_tensor_info_list)
 {
     in_mat_list_.clear();
-    for (const auto& input_tensor_info : input_tensor_info_list) {
+    if (input_tensor_info_list.size() != pre_process_plan_list_.size()) {
+        PRINT_E("The number of input tensors is different from Initialize (%zu != %zu)\n", input_tensor_info_list.size(), pre_process_plan_list_.size());
+        return kRetErr;
+    }
+    for (size_t input_tensor_index = 0; input_tensor_index < input_tensor_info_list.size(); input_tensor_index++) {
+        const auto& input_tensor_info = input_tensor_info_list[input_tensor_index];
+        const auto& plan = pre_process_plan_list_[input_tensor_index];
+        if (!input_tensor_info.batch_list.empty()) {
+            PRINT_E("batch_list is not supported\n");
+            return kRetErr;
+        }
         cv::Mat img_blob;
         if (input_tensor_info.data_type == InputTensorInfo::kDataTypeImage) {
+            if (input_tensor_info.image_info.letterbox != InputTensorInfo::kLetterboxNone) {
+                PRINT_E("Letterbox is not supported\n");
+                return kRetErr;
+            }
+
             /* Generate mat from original data */
-            cv::Mat img_src = cv::Mat(cv::Size(input_tensor_info.image_info.width, input_tensor_info.image_info.height), (input_tensor_info.image_info.channel == 3) ? CV_8UC3 : CV_8UC1, input_tensor_info.data);
+            const size_t step = (input_tensor_info.image_info.stride > 0) ? input_tensor_info.image_info.stride : cv::Mat::AUTO_STEP;
+            cv::Mat img_src = cv::Mat(cv::Size(input_tensor_info.image_info.width, input_tensor_info.image_info.height), (input_tensor_info.image_info.channel == 3) ? CV_8UC3 : CV_8UC1, input_tensor_info.data, step);
 
             /* Crop image */
             if (input_tensor_info.image_info.width == input_tensor_info.image_info.crop_width && input_tensor_info.image_info.height == input_tensor_info.image_info.crop_height) {
@@ -212,8 +229,8 @@ int32_t InferenceHelperOpenCV::PreProcess(const std::vector<InputTensorInfo>& in
                 if (input_tensor_info.GetChannel() == 3) {
 #if 1
                     img_src.convertTo(img_src, CV_32FC3);
-                    cv::subtract(img_src, cv::Scalar(cv::Vec<float, 3>(input_tensor_info.normalize.mean)), img_src);
-                    cv::multiply(img_src, cv::Scalar(cv::Vec<float, 3>(input_tensor_info.normalize.norm)), img_src);
+                    cv::subtract(img_src, cv::Scalar(cv::Vec<float, 3>(plan.mean)), img_src);
+                    cv::multiply(img_src, cv::Scalar(cv::Vec<float, 3>(plan.norm)), img_src);
                     
 #else
                     img_src.convertTo(img_src, CV_32FC3, 1.0 / 255);
@@ -223,8 +240,8 @@ int32_t InferenceHelperOpenCV::PreProcess(const std::vector<InputTensorInfo>& in
                 } else if (input_tensor_info.GetChannel() == 1) {
 #if 1
                     img_src.convertTo(img_src, CV_32FC1);
-                    cv::subtract(img_src, cv::Scalar(cv::Vec<float, 1>(input_tensor_info.normalize.mean)), img_src);
-                    cv::multiply(img_src, cv::Scalar(cv::Vec<float, 1>(input_tensor_info.normalize.norm)), img_src);
+                    cv::subtract(img_src, cv::Scalar(cv::Vec<float, 1>(plan.mean)), img_src);
+                    cv::multiply(img_src, cv::Scalar(cv::Vec<float, 1>(plan.norm)), img_src);
 #else
                     img_src.convertTo(img_src, CV_32FC1, 1.0 / 255);
                     cv::subtract(img_src, cv::Scalar(cv::Vec<float, 1>(input_tensor_info.normalize.mean)), img_src);
@@ -307,6 +324,10 @@ int32_t InferenceHelperOpenCV::Process(std::vector<OutputTensorInfo>& output_ten
         output_tensor_info_list[i].tensor_dims.push_back(out_mat_list_[i].cols);
     }
 
+    if (ConvertOutputLayout(cv::getNumThreads(), true, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
 
@@ -0,0 +1,232 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* for My modules */
+#include "inference_helper_log.h"
+#include "inference_helper.h"
+#include "inference_helper_pipeline.h"
+
+/*** Macro ***/
+#define TAG "InferenceHelperPipeline"
+#define PRINT(...)   INFERENCE_HELPER_LOG_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) INFERENCE_HELPER_LOG_PRINT_E(TAG, __VA_ARGS__)
+
+
+/*** Function ***/
+InferenceHelperPipeline::InferenceHelperPipeline()
+    : inference_helper_(nullptr)
+    , submit_num_(0)
+    , waited_num_(0)
+    , max_frame_num_(0)
+    , slot_num_(0)
+    , commit_num_(0)
+    , waited_handle_(-1)
+    , is_exit_(true)
+{
+}
+
+InferenceHelperPipeline::~InferenceHelperPipeline()
+{
+    Finalize();
+}
+
+int32_t InferenceHelperPipeline::Initialize(InferenceHelper* inference_helper, const std::vector<OutputTensorInfo>& output_tensor_info_list, int32_t max_frame_num)
+{
+    Finalize();
+    if (inference_helper == nullptr || max_frame_num < 1) {
+        PRINT_E("Invalid parameter (max_frame_num = %d)\n", max_frame_num);
+        return InferenceHelper::kRetErr;
+    }
+    inference_helper_ = inference_helper;
+    output_tensor_info_list_ = output_tensor_info_list;
+    /* The helper may be set to other than kPreProcessSlotNum (e.g. used by InferenceHelperStreamRunner before) */
+    slot_num_ = inference_helper_->GetPreProcessSlotNum();
+
+    /* One more frame for the result referred by the caller after Wait */
+    frame_list_.clear();
+    for (int32_t i = 0; i < max_frame_num + 1; i++) {
+        std::unique_ptr<Frame> frame(new Frame());
+        frame->handle = -1;
+        frame->state = kStateFree;
+        frame->result = InferenceHelper::kRetOk;
+        frame_list_.push_back(std::move(frame));
+    }
+    submit_num_ = 0;
+    waited_num_ = 0;
+    max_frame_num_ = max_frame_num;
+    commit_num_ = 0;
+    waited_handle_ = -1;
+    is_exit_ = false;
+
+    thread_pre_process_ = std::thread(&InferenceHelperPipeline::ThreadPreProcess, this);
+    thread_process_ = std::thread(&InferenceHelperPipeline::ThreadProcess, this);
+    return InferenceHelper::kRetOk;
+}
+
+int32_t InferenceHelperPipeline::Finalize(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_exit_ = true;
+    }
+    cond_.notify_all();
+    if (thread_pre_process_.joinable()) thread_pre_process_.join();
+    if (thread_process_.joinable()) thread_process_.join();
+    inference_helper_ = nullptr;
+    return InferenceHelper::kRetOk;
+}
+
+int64_t InferenceHelperPipeline::SubmitAsync(const std::vector<InputTensorInfo>& input_tensor_info_list)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (is_exit_) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+    /* Only the caller can release frames (by Wait), so SubmitAsync doesn't wait for a free frame */
+    if (submit_num_ - waited_num_ >= max_frame_num_) {
+        PRINT_E("Too many frames not waited (%lld)\n", static_cast<long long>(submit_num_ - waited_num_));
+        return -1;
+    }
+    const int64_t handle = submit_num_;
+    Frame& frame = GetFrame(handle);
+    if (frame.state != kStateFree) {
+        PRINT_E("Frame %lld is not waited yet\n", static_cast<long long>(frame.handle));
+        return -1;
+    }
+
+    /* Free frame is touched only by the submitting thread */
+    lock.unlock();
+    frame.handle = handle;
+    frame.result = InferenceHelper::kRetOk;
+    frame.input_tensor_info_list = input_tensor_info_list;
+    lock.lock();
+    frame.state = kStateSubmitted;
+    submit_num_++;
+    lock.unlock();
+    cond_.notify_all();
+    return handle;
+}
+
+bool InferenceHelperPipeline::Poll(int64_t handle)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (handle < 0 || handle >= submit_num_) return false;
+    const Frame& frame = GetFrame(handle);
+    return frame.handle == handle && frame.state == kStateDone;
+}
+
+int32_t InferenceHelperPipeline::Wait(int64_t handle, std::vector<OutputTensorInfo>& output_tensor_info_list, std::vector<InputTensorInfo>* input_tensor_info_list)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (handle < 0 || handle >= submit_num_ || GetFrame(handle).handle != handle || GetFrame(handle).state == kStateWaited || GetFrame(handle).state == kStateFree) {
+        PRINT_E("Invalid handle (%lld)\n", static_cast<long long>(handle));
+        return InferenceHelper::kRetErr;
+    }
+    Frame& frame = GetFrame(handle);
+    cond_.wait(lock, [&] { return is_exit_ || frame.state == kStateDone; });
+    if (frame.state != kStateDone) {
+        PRINT_E("Finalized before the frame is done (%lld)\n", static_cast<long long>(handle));
+        return InferenceHelper::kRetErr;
+    }
+
+    /* The result of the previous Wait is not referred any more */
+    if (waited_handle_ >= 0) GetFrame(waited_handle_).state = kStateFree;
+    frame.state = kStateWaited;
+    waited_handle_ = handle;
+    waited_num_++;
+    lock.unlock();
+    cond_.notify_all();
+
+    output_tensor_info_list = frame.output_tensor_info_list;
+    if (input_tensor_info_list) *input_tensor_info_list = frame.input_tensor_info_list;
+    return frame.result;
+}
+
+void InferenceHelperPipeline::ThreadPreProcess(void)
+{
+    for (int64_t handle = 0; ; handle++) {
+        Frame* frame;
+        {
+            /* The staging buffer is free when the frame using it before (handle - slot_num_) is committed */
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [&] { return is_exit_ || (handle < submit_num_ && handle < commit_num_ + slot_num_); });
+            if (is_exit_) return;
+            frame = &GetFrame(handle);
+        }
+        const int32_t slot = static_cast<int32_t>(handle % slot_num_);
+        frame->result = inference_helper_->PreProcessToSlot(slot, frame->input_tensor_info_list);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame->state = kStatePreProcessed;
+        }
+        cond_.notify_all();
+    }
+}
+
+void InferenceHelperPipeline::ThreadProcess(void)
+{
+    for (int64_t handle = 0; ; handle++) {
+        Frame* frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [&] { return is_exit_ || (handle < submit_num_ && GetFrame(handle).state == kStatePreProcessed); });
+            if (is_exit_) return;
+            frame = &GetFrame(handle);
+        }
+        const int32_t slot = static_cast<int32_t>(handle % slot_num_);
+        if (frame->result == InferenceHelper::kRetOk) {
+            frame->result = inference_helper_->CommitPreProcess(slot, frame->input_tensor_info_list);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            commit_num_ = handle + 1;
+        }
+        cond_.notify_all();
+
+        if (frame->result == InferenceHelper::kRetOk) {
+            frame->result = inference_helper_->Process(output_tensor_info_list_);
+        }
+        if (frame->result == InferenceHelper::kRetOk) {
+            /* The framework's output buffer is overwritten by the next frame, so the result is copied into the frame */
+            frame->output_tensor_info_list = output_tensor_info_list_;
+            frame->output_buffer_list.resize(output_tensor_info_list_.size());
+            for (size_t i = 0; i < output_tensor_info_list_.size(); i++) {
+                auto& output_tensor_info = frame->output_tensor_info_list[i];
+                if (output_tensor_info.data == nullptr) continue;
+                auto& buffer = frame->output_buffer_list[i];
+                buffer.resize(output_tensor_info.GetByteSize());
+                std::memcpy(buffer.data(), output_tensor_info.data, buffer.size());
+                output_tensor_info.data = buffer.data();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame->state = kStateDone;
+        }
+        cond_.notify_all();
+    }
+}
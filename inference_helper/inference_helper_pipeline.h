@@ -0,0 +1,99 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef INFERENCE_HELPER_PIPELINE_
+#define INFERENCE_HELPER_PIPELINE_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* for My modules */
+#include "inference_helper.h"
+
+/* Asynchronous PreProcess + Process of an initialized InferenceHelper
+ * Pre-process and inference run on their own threads, so that pre-process of frame N + 1 overlaps inference of frame N
+ * Pre-process is stored into the staging buffers (InferenceHelper::PreProcessToSlot, double-buffered by default), so the two stages never touch the same memory
+ * Frameworks whose pre-process can't be staged run PreProcess on the inference thread (still asynchronous to the caller)
+ * Frames are processed in the order of SubmitAsync. SubmitAsync, Poll and Wait are expected to be called from one thread
+ */
+class InferenceHelperPipeline {
+public:
+    InferenceHelperPipeline();
+    ~InferenceHelperPipeline();
+    /* inference_helper must be initialized (not owned). output_tensor_info_list is the one used for Initialize of inference_helper
+     * max_frame_num is the number of frames submitted and not waited yet. SubmitAsync fails when it's reached (Wait for a frame first)
+     */
+    int32_t Initialize(InferenceHelper* inference_helper, const std::vector<OutputTensorInfo>& output_tensor_info_list, int32_t max_frame_num = 4);
+    /* Frames not processed yet are discarded */
+    int32_t Finalize(void);
+
+    /* Returns handle of the frame (>= 0), or -1 for error (including max_frame_num frames not waited). Every handle must be waited
+     * Image (blob) data pointed by input_tensor_info_list must be kept until the frame is done
+     * Frames are expected to be waited in the order of submission. If not, SubmitAsync fails while the frame submitted max_frame_num + 1 before is not waited
+     */
+    int64_t SubmitAsync(const std::vector<InputTensorInfo>& input_tensor_info_list);
+    /* true if the frame is done (Wait doesn't block) */
+    bool Poll(int64_t handle);
+    /* Wait for the frame and get the result. Data of output_tensor_info_list is owned by the pipeline and valid until the next Wait
+     * input_tensor_info_list (can be nullptr) receives the inputs of the frame, whose image_transform is set by pre-process
+     * Returns kRetErr if PreProcess or Process failed, or handle is not waitable (unknown or already waited)
+     */
+    int32_t Wait(int64_t handle, std::vector<OutputTensorInfo>& output_tensor_info_list, std::vector<InputTensorInfo>* input_tensor_info_list = nullptr);
+
+private:
+    enum {
+        kStateFree,
+        kStateSubmitted,
+        kStatePreProcessed,
+        kStateDone,
+        kStateWaited,       // returned by Wait and referred by the caller until the next Wait
+    };
+
+    struct Frame {
+        int64_t handle;
+        int32_t state;
+        int32_t result;
+        std::vector<InputTensorInfo>      input_tensor_info_list;
+        std::vector<OutputTensorInfo>     output_tensor_info_list;
+        std::vector<std::vector<uint8_t>> output_buffer_list;       // data of output_tensor_info_list (copied from the framework's buffer)
+    };
+
+    void ThreadPreProcess(void);
+    void ThreadProcess(void);
+    Frame& GetFrame(int64_t handle) { return *frame_list_[handle % frame_list_.size()]; }
+
+private:
+    InferenceHelper* inference_helper_;
+    std::vector<OutputTensorInfo> output_tensor_info_list_;     // used for Process
+    std::vector<std::unique_ptr<Frame>> frame_list_;            // ring buffer indexed by handle
+    int64_t submit_num_;
+    int64_t waited_num_;        // frames returned by Wait
+    int64_t max_frame_num_;
+    int64_t slot_num_;          // staging slots of the helper
+    int64_t commit_num_;        // frames whose staging buffer is committed to the input tensors
+    int64_t waited_handle_;
+    bool is_exit_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::thread thread_pre_process_;
+    std::thread thread_process_;
+};
+
+#endif
@@ -0,0 +1,263 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* for My modules */
+#include "inference_helper_log.h"
+#include "inference_helper.h"
+#include "inference_helper_pool.h"
+
+/*** Macro ***/
+#define TAG "InferenceHelperPool"
+#define PRINT(...)   INFERENCE_HELPER_LOG_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) INFERENCE_HELPER_LOG_PRINT_E(TAG, __VA_ARGS__)
+
+
+/*** Function ***/
+InferenceHelperPool::Parameter InferenceHelperPool::GetPresetParameter(int32_t preset, int32_t core_num)
+{
+    if (core_num <= 0) {
+        core_num = (std::max)(1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+    }
+    Parameter parameter;
+    if (preset == kPresetLatency) {
+        parameter.instance_num = 1;
+        parameter.num_threads = core_num;
+    } else {
+        parameter.instance_num = core_num;
+        parameter.num_threads = 1;
+    }
+    return parameter;
+}
+
+InferenceHelperPool::InferenceHelperPool()
+    : submit_num_(0)
+    , queued_num_(0)
+    , is_exit_(true)
+{
+}
+
+InferenceHelperPool::~InferenceHelperPool()
+{
+    Finalize();
+}
+
+int32_t InferenceHelperPool::Initialize(InferenceHelper::HelperType helper_type, const std::string& model_filename, std::vector<InputTensorInfo>& input_tensor_info_list, std::vector<OutputTensorInfo>& output_tensor_info_list, const Parameter& parameter)
+{
+    Finalize();
+    if (parameter.instance_num < 1 || parameter.num_threads < 1) {
+        PRINT_E("Invalid parameter (instance_num = %d, num_threads = %d)\n", parameter.instance_num, parameter.num_threads);
+        return InferenceHelper::kRetErr;
+    }
+
+    for (int32_t i = 0; i < parameter.instance_num; i++) {
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->inference_helper.reset(InferenceHelper::Create(helper_type));
+        if (!worker->inference_helper) {
+            Finalize();
+            return InferenceHelper::kRetErr;
+        }
+        std::vector<InputTensorInfo> input_list = input_tensor_info_list;
+        worker->output_tensor_info_list = output_tensor_info_list;
+        if (worker->inference_helper->SetNumThreads(parameter.num_threads) != InferenceHelper::kRetOk
+            || worker->inference_helper->SetCustomOps(parameter.custom_ops) != InferenceHelper::kRetOk
+            || worker->inference_helper->Initialize(model_filename, input_list, worker->output_tensor_info_list) != InferenceHelper::kRetOk) {
+            PRINT_E("Failed to initialize instance %d\n", i);
+            worker->inference_helper->Finalize();
+            Finalize();
+            return InferenceHelper::kRetErr;
+        }
+        if (i == 0) {
+            input_tensor_info_list = input_list;
+            output_tensor_info_list = worker->output_tensor_info_list;
+        }
+        worker_list_.push_back(std::move(worker));
+    }
+
+    submit_num_ = 0;
+    queued_num_ = 0;
+    is_exit_ = false;
+    for (int32_t i = 0; i < static_cast<int32_t>(worker_list_.size()); i++) {
+        worker_list_[i]->thread = std::thread(&InferenceHelperPool::ThreadWorker, this, i);
+    }
+    return InferenceHelper::kRetOk;
+}
+
+int32_t InferenceHelperPool::Finalize(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_exit_ = true;
+    }
+    cond_queue_.notify_all();
+    cond_done_.notify_all();
+    for (auto& worker : worker_list_) {
+        if (worker->thread.joinable()) worker->thread.join();
+        worker->inference_helper->Finalize();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    worker_list_.clear();
+    request_map_.clear();
+    return InferenceHelper::kRetOk;
+}
+
+int64_t InferenceHelperPool::SubmitAsync(const std::vector<InputTensorInfo>& input_tensor_info_list)
+{
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->ret = InferenceHelper::kRetErr;
+    request->is_done = false;
+    request->result.input_tensor_info_list = input_tensor_info_list;
+
+    int64_t handle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (is_exit_) {
+            PRINT_E("Not initialized\n");
+            return -1;
+        }
+        handle = submit_num_++;
+        request_map_[handle] = request;
+    }
+
+    /* Round robin. An idle worker takes it if the worker is busy */
+    Worker& worker = *worker_list_[handle % worker_list_.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.queue.push_back(request);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_num_++;
+    }
+    cond_queue_.notify_one();
+    return handle;
+}
+
+bool InferenceHelperPool::Poll(int64_t handle)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = request_map_.find(handle);
+    return it != request_map_.end() && it->second->is_done;
+}
+
+int32_t InferenceHelperPool::Wait(int64_t handle, Result& result)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto it = request_map_.find(handle);
+    if (it == request_map_.end()) {
+        PRINT_E("Invalid handle (%lld)\n", static_cast<long long>(handle));
+        return InferenceHelper::kRetErr;
+    }
+    std::shared_ptr<Request> request = it->second;
+    cond_done_.wait(lock, [&] { return is_exit_ || request->is_done; });
+    if (!request->is_done || request_map_.erase(handle) == 0) {
+        PRINT_E("Request is discarded (%lld)\n", static_cast<long long>(handle));
+        return InferenceHelper::kRetErr;
+    }
+    result = std::move(request->result);
+    return request->ret;
+}
+
+int32_t InferenceHelperPool::Run(const std::vector<InputTensorInfo>& input_tensor_info_list, Result& result)
+{
+    const int64_t handle = SubmitAsync(input_tensor_info_list);
+    if (handle < 0) {
+        return InferenceHelper::kRetErr;
+    }
+    return Wait(handle, result);
+}
+
+/* The front of its own queue, or the back of another worker's queue (work stealing) */
+std::shared_ptr<InferenceHelperPool::Request> InferenceHelperPool::PopRequest(int32_t index)
+{
+    const int32_t worker_num = static_cast<int32_t>(worker_list_.size());
+    for (int32_t i = 0; i < worker_num; i++) {
+        Worker& worker = *worker_list_[(index + i) % worker_num];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.queue.empty()) continue;
+        std::shared_ptr<Request> request;
+        if (i == 0) {
+            request = worker.queue.front();
+            worker.queue.pop_front();
+        } else {
+            request = worker.queue.back();
+            worker.queue.pop_back();
+        }
+        queued_num_--;
+        return request;
+    }
+    return nullptr;
+}
+
+void InferenceHelperPool::ProcessRequest(Worker& worker, Request& request)
+{
+    Result& result = request.result;
+    request.ret = worker.inference_helper->PreProcess(result.input_tensor_info_list);
+    if (request.ret == InferenceHelper::kRetOk) {
+        request.ret = worker.inference_helper->Process(worker.output_tensor_info_list);
+    }
+    if (request.ret != InferenceHelper::kRetOk) {
+        return;
+    }
+
+    /* The framework's output buffer is overwritten by the next request, so the result is copied */
+    result.output_tensor_info_list = worker.output_tensor_info_list;
+    result.buffer_list.resize(result.output_tensor_info_list.size());
+    for (size_t i = 0; i < result.output_tensor_info_list.size(); i++) {
+        auto& output_tensor_info = result.output_tensor_info_list[i];
+        if (output_tensor_info.data == nullptr) continue;
+        auto& buffer = result.buffer_list[i];
+        buffer.resize(output_tensor_info.GetByteSize());
+        std::memcpy(buffer.data(), output_tensor_info.data, buffer.size());
+        output_tensor_info.data = buffer.data();
+    }
+}
+
+void InferenceHelperPool::ThreadWorker(int32_t index)
+{
+    Worker& worker = *worker_list_[index];
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (is_exit_) return;
+        }
+        std::shared_ptr<Request> request = PopRequest(index);
+        if (!request) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_queue_.wait(lock, [&] { return is_exit_ || queued_num_ > 0; });
+            continue;
+        }
+        ProcessRequest(worker, *request);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            request->is_done = true;
+        }
+        cond_done_.notify_all();
+    }
+}
@@ -0,0 +1,124 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef INFERENCE_HELPER_POOL_
+#define INFERENCE_HELPER_POOL_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* for My modules */
+#include "inference_helper.h"
+
+/* Multiple instances of InferenceHelper for one model, each on its own thread
+ * Requests are distributed to the queue of each instance in round robin, and an idle instance steals requests from the others
+ * The model bytes are shared by the instances if the framework refers to them without copy (InferenceHelper::LoadModelBuffer. e.g. TensorFlow Lite)
+ * SubmitAsync, Poll and Wait can be called from any thread
+ */
+class InferenceHelperPool {
+public:
+    enum {
+        kPresetThroughput,  // many instances with 1 thread each (the best total FPS for many requests)
+        kPresetLatency,     // one instance with all threads (the best latency of each request)
+    };
+
+    struct Parameter {
+        Parameter()
+            : instance_num(1)
+            , num_threads(1)
+        {}
+
+        int32_t instance_num;
+        int32_t num_threads;        // SetNumThreads of each instance
+        std::vector<std::pair<const char*, const void*>> custom_ops;
+    };
+
+    /* Result of a request. output_tensor_info_list refers to buffer_list, so it can be moved but must not be copied */
+    struct Result {
+        Result() = default;
+        Result(Result&&) = default;
+        Result& operator=(Result&&) = default;
+        Result(const Result&) = delete;
+        Result& operator=(const Result&) = delete;
+
+        std::vector<InputTensorInfo>      input_tensor_info_list;   // image_transform is set by PreProcess
+        std::vector<OutputTensorInfo>     output_tensor_info_list;
+        std::vector<std::vector<uint8_t>> buffer_list;              // data of output_tensor_info_list
+    };
+
+public:
+    /* Parameter of the preset for core_num cores (0: the number of hardware threads) */
+    static Parameter GetPresetParameter(int32_t preset, int32_t core_num = 0);
+
+    InferenceHelperPool();
+    ~InferenceHelperPool();
+    /* Each instance is initialized with the copy of the tensor info lists, and the lists of the first instance are returned */
+    int32_t Initialize(InferenceHelper::HelperType helper_type, const std::string& model_filename, std::vector<InputTensorInfo>& input_tensor_info_list, std::vector<OutputTensorInfo>& output_tensor_info_list, const Parameter& parameter);
+    /* Requests not processed yet are discarded */
+    int32_t Finalize(void);
+
+    /* Returns handle of the request (>= 0), or -1 for error. Every handle must be waited
+     * Image (blob) data pointed by input_tensor_info_list must be kept until the request is done
+     */
+    int64_t SubmitAsync(const std::vector<InputTensorInfo>& input_tensor_info_list);
+    /* true if the request is done (Wait doesn't block) */
+    bool Poll(int64_t handle);
+    /* Wait for the request and get the result. Returns kRetErr if PreProcess or Process failed, or handle is unknown */
+    int32_t Wait(int64_t handle, Result& result);
+    /* SubmitAsync + Wait */
+    int32_t Run(const std::vector<InputTensorInfo>& input_tensor_info_list, Result& result);
+
+    int32_t GetInstanceNum() const { return static_cast<int32_t>(worker_list_.size()); }
+
+private:
+    struct Request {
+        int32_t ret;
+        bool    is_done;
+        Result  result;
+    };
+
+    struct Worker {
+        std::unique_ptr<InferenceHelper>      inference_helper;
+        std::vector<OutputTensorInfo>         output_tensor_info_list;    // used for Process
+        std::deque<std::shared_ptr<Request>>  queue;
+        std::mutex                            mutex;      // for queue
+        std::thread                           thread;
+    };
+
+    void ThreadWorker(int32_t index);
+    std::shared_ptr<Request> PopRequest(int32_t index);
+    void ProcessRequest(Worker& worker, Request& request);
+
+private:
+    std::vector<std::unique_ptr<Worker>> worker_list_;
+    std::unordered_map<int64_t, std::shared_ptr<Request>> request_map_;    // requests not waited yet
+    int64_t submit_num_;
+    std::atomic<int64_t> queued_num_;       // requests in the queues
+    bool is_exit_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_queue_;    // a request is queued
+    std::condition_variable cond_done_;     // a request is done
+};
+
+#endif
@@ -0,0 +1,654 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+/* for My modules */
+#include "inference_helper_log.h"
+#include "inference_helper.h"
+#include "inference_helper_kernel.h"
+#include "inference_helper_post_process.h"
+
+/*** Macro ***/
+#define TAG "InferenceHelperPostProcess"
+#define PRINT(...)   INFERENCE_HELPER_LOG_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) INFERENCE_HELPER_LOG_PRINT_E(TAG, __VA_ARGS__)
+
+namespace InferenceHelperPostProcess {
+
+/* Elements processed by one thread at a time */
+static constexpr int32_t kBlockSize = 16 * 1024;
+
+/* The tensor is seen as [outer, class_num, inner] */
+static int32_t GetClassAxis(const OutputTensorInfo& output_tensor_info, int32_t& outer, int32_t& class_num, int32_t& inner)
+{
+    const auto& dims = output_tensor_info.tensor_dims;
+    if (dims.empty() || output_tensor_info.GetElementNum() <= 0) {
+        PRINT_E("Invalid tensor dims (%s)\n", output_tensor_info.name.c_str());
+        return InferenceHelper::kRetErr;
+    }
+    if (dims.size() == 4) {
+        class_num = output_tensor_info.GetChannel();
+        if (output_tensor_info.is_nchw) {
+            outer = dims[0];
+            inner = dims[2] * dims[3];
+        } else {
+            outer = dims[0] * dims[1] * dims[2];
+            inner = 1;
+        }
+    } else {
+        outer = 1;
+        for (size_t i = 0; i < dims.size() - 1; i++) {
+            outer *= dims[i];
+        }
+        class_num = dims.back();
+        inner = 1;
+    }
+    return InferenceHelper::kRetOk;
+}
+
+static bool IsPerAxisQuantized(const OutputTensorInfo& output_tensor_info)
+{
+    return output_tensor_info.quant.axis >= 0 && !output_tensor_info.quant.scale_list.empty();
+}
+
+/* Raw data of fp32, uint8 or int8. Per axis quantized data can't be compared as it is, and other types have no kernel, so they are converted into buffer */
+static const void* GetComparableData(const OutputTensorInfo& output_tensor_info, int32_t& tensor_type, std::vector<float>& buffer)
+{
+    tensor_type = output_tensor_info.tensor_type;
+    if (output_tensor_info.data == nullptr) {
+        PRINT_E("Data is not set (%s)\n", output_tensor_info.name.c_str());
+        return nullptr;
+    }
+    const bool is_comparable = (tensor_type == TensorInfo::kTensorTypeFp32)
+        || ((tensor_type == TensorInfo::kTensorTypeUint8 || tensor_type == TensorInfo::kTensorTypeInt8) && !IsPerAxisQuantized(output_tensor_info));
+    if (!is_comparable) {
+        /* Per axis quantized, or other types (fp16, int64, etc.) */
+        buffer.resize(output_tensor_info.GetElementNum());
+        if (!output_tensor_info.GetDataAsFloat(0, static_cast<int32_t>(buffer.size()), buffer.data())) {
+            PRINT_E("Unsupported tensor type (%s, %d)\n", output_tensor_info.name.c_str(), tensor_type);
+            return nullptr;
+        }
+        tensor_type = TensorInfo::kTensorTypeFp32;
+        return buffer.data();
+    }
+    return output_tensor_info.data;
+}
+
+
+/*** Softmax ***/
+int32_t Softmax(const OutputTensorInfo& output_tensor_info, std::vector<float>& dst)
+{
+    int32_t outer, class_num, inner;
+    if (GetClassAxis(output_tensor_info, outer, class_num, inner) != InferenceHelper::kRetOk) {
+        return InferenceHelper::kRetErr;
+    }
+    const int32_t element_num = output_tensor_info.GetElementNum();
+    dst.resize(element_num);
+
+    /* Quantized data is dequantized into dst, then softmax is calculated in place */
+    const float* src = nullptr;
+    if (output_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
+        src = static_cast<const float*>(output_tensor_info.data);
+    } else if (output_tensor_info.GetDataAsFloat(0, element_num, dst.data())) {
+        src = dst.data();
+    }
+    if (src == nullptr) {
+        PRINT_E("Unsupported tensor (%s)\n", output_tensor_info.name.c_str());
+        return InferenceHelper::kRetErr;
+    }
+
+    if (inner > 1) {
+        /* Planar (NCHW). Each task processes a part of the plane */
+        const int32_t block_num_per_outer = (inner + kBlockSize - 1) / kBlockSize;
+        const int32_t task_num = outer * block_num_per_outer;
+#pragma omp parallel for if (task_num > 1)
+        for (int32_t task = 0; task < task_num; task++) {
+            const int32_t o = task / block_num_per_outer;
+            const int32_t start = (task % block_num_per_outer) * kBlockSize;
+            const int32_t num = (std::min)(inner - start, kBlockSize);
+            const int32_t offset = o * class_num * inner + start;
+            InferenceHelperKernel::SoftmaxPlanar(src + offset, class_num, num, inner, dst.data() + offset);
+        }
+    } else {
+        /* Classes are contiguous (NHWC or [N, class]). Each task processes some positions */
+        const int32_t outer_per_task = (std::max)(1, kBlockSize / class_num);
+        const int32_t task_num = (outer + outer_per_task - 1) / outer_per_task;
+#pragma omp parallel for if (task_num > 1)
+        for (int32_t task = 0; task < task_num; task++) {
+            const int32_t o_end = (std::min)(outer, (task + 1) * outer_per_task);
+            for (int32_t o = task * outer_per_task; o < o_end; o++) {
+                InferenceHelperKernel::Softmax(src + o * class_num, class_num, dst.data() + o * class_num);
+            }
+        }
+    }
+    return InferenceHelper::kRetOk;
+}
+
+
+/*** TopK ***/
+template<typename T>
+static void TopKImpl(const T* src, int32_t num, int32_t k, std::vector<std::pair<T, int32_t>>& heap)
+{
+    /* Min heap of the current top k. "greater" puts the worst one (smaller value, or larger index for the same value) on top */
+    auto greater = [](const std::pair<T, int32_t>& a, const std::pair<T, int32_t>& b) {
+        return (a.first > b.first) || (a.first == b.first && a.second < b.second);
+    };
+    heap.clear();
+    for (int32_t i = 0; i < k; i++) {
+        heap.push_back(std::make_pair(src[i], i));
+    }
+    std::make_heap(heap.begin(), heap.end(), greater);
+    for (int32_t i = k; i < num; i++) {
+        /* index increases, so the same value as the worst one never enters */
+        if (src[i] > heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            heap.back() = std::make_pair(src[i], i);
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), greater);
+}
+
+template<typename T>
+static void TopKToResult(const OutputTensorInfo& output_tensor_info, const T* src, int32_t num, int32_t k, std::vector<IndexScore>& result)
+{
+    std::vector<std::pair<T, int32_t>> heap;
+    heap.reserve(k);
+    TopKImpl(src, num, k, heap);
+    result.resize(heap.size());
+    for (size_t i = 0; i < heap.size(); i++) {
+        result[i].index = heap[i].second;
+        result[i].score = (heap[i].first - output_tensor_info.quant.zero_point) * output_tensor_info.quant.scale;
+    }
+}
+
+static void TopKToResult(const OutputTensorInfo&, const float* src, int32_t num, int32_t k, std::vector<IndexScore>& result)
+{
+    std::vector<std::pair<float, int32_t>> heap;
+    heap.reserve(k);
+    TopKImpl(src, num, k, heap);
+    result.resize(heap.size());
+    for (size_t i = 0; i < heap.size(); i++) {
+        result[i].index = heap[i].second;
+        result[i].score = heap[i].first;
+    }
+}
+
+int32_t TopK(const OutputTensorInfo& output_tensor_info, int32_t k, std::vector<IndexScore>& result, int32_t batch)
+{
+    result.clear();
+    const int32_t batch_num = output_tensor_info.tensor_dims.empty() ? 0 : output_tensor_info.tensor_dims[0];
+    if (batch < 0 || batch >= batch_num || k < 0) {
+        PRINT_E("Invalid batch or k (%d, %d) (%s)\n", batch, k, output_tensor_info.name.c_str());
+        return InferenceHelper::kRetErr;
+    }
+    const int32_t num = output_tensor_info.GetElementNum() / batch_num;
+    k = (std::min)(k, num);
+    if (k == 0) {
+        return InferenceHelper::kRetOk;
+    }
+
+    int32_t tensor_type;
+    std::vector<float> buffer;
+    const void* data = GetComparableData(output_tensor_info, tensor_type, buffer);
+    if (data == nullptr) {
+        return InferenceHelper::kRetErr;
+    }
+    switch (tensor_type) {
+    case TensorInfo::kTensorTypeFp32:
+        TopKToResult(output_tensor_info, static_cast<const float*>(data) + batch * num, num, k, result);
+        break;
+    case TensorInfo::kTensorTypeUint8:
+        TopKToResult(output_tensor_info, static_cast<const uint8_t*>(data) + batch * num, num, k, result);
+        break;
+    case TensorInfo::kTensorTypeInt8:
+        TopKToResult(output_tensor_info, static_cast<const int8_t*>(data) + batch * num, num, k, result);
+        break;
+    default:
+        return InferenceHelper::kRetErr;
+    }
+    return InferenceHelper::kRetOk;
+}
+
+
+/*** ArgMax ***/
+/* Classes are contiguous: dst[o] = argmax_c(src[o * class_num + c]) */
+template<typename T>
+static void ArgMaxContiguous(const T* src, int32_t num, int32_t class_num, int32_t* dst, T* dst_max)
+{
+    for (int32_t o = 0; o < num; o++) {
+        const T* p = src + o * class_num;
+        T max_val = p[0];
+        int32_t max_index = 0;
+        for (int32_t c = 1; c < class_num; c++) {
+            if (p[c] > max_val) {
+                max_val = p[c];
+                max_index = c;
+            }
+        }
+        dst[o] = max_index;
+        if (dst_max) dst_max[o] = max_val;
+    }
+}
+
+template<typename T>
+static void ArgMaxImpl(const T* src, int32_t outer, int32_t class_num, int32_t inner, int32_t* dst, T* dst_max)
+{
+    if (inner > 1) {
+        /* Planar (NCHW). Each task processes a part of the plane */
+        const int32_t block_num_per_outer = (inner + kBlockSize - 1) / kBlockSize;
+        const int32_t task_num = outer * block_num_per_outer;
+#pragma omp parallel for if (task_num > 1)
+        for (int32_t task = 0; task < task_num; task++) {
+            const int32_t o = task / block_num_per_outer;
+            const int32_t start = (task % block_num_per_outer) * kBlockSize;
+            const int32_t num = (std::min)(inner - start, kBlockSize);
+            InferenceHelperKernel::ArgMaxPlanar(src + o * class_num * inner + start, class_num, num, inner, dst + o * inner + start, dst_max ? dst_max + o * inner + start : nullptr);
+        }
+    } else {
+        /* Classes are contiguous (NHWC or [N, class]) */
+        const int32_t outer_per_task = (std::max)(1, kBlockSize / class_num);
+        const int32_t task_num = (outer + outer_per_task - 1) / outer_per_task;
+#pragma omp parallel for if (task_num > 1)
+        for (int32_t task = 0; task < task_num; task++) {
+            const int32_t o = task * outer_per_task;
+            const int32_t num = (std::min)(outer - o, outer_per_task);
+            ArgMaxContiguous(src + o * class_num, num, class_num, dst + o, dst_max ? dst_max + o : nullptr);
+        }
+    }
+}
+
+template<typename T>
+static void ArgMaxQuantized(const OutputTensorInfo& output_tensor_info, const T* src, int32_t outer, int32_t class_num, int32_t inner, std::vector<int32_t>& index_map, std::vector<float>* score_map)
+{
+    if (score_map == nullptr) {
+        ArgMaxImpl<T>(src, outer, class_num, inner, index_map.data(), nullptr);
+        return;
+    }
+    std::vector<T> max_map(index_map.size());
+    ArgMaxImpl<T>(src, outer, class_num, inner, index_map.data(), max_map.data());
+    for (size_t i = 0; i < max_map.size(); i++) {
+        (*score_map)[i] = (max_map[i] - output_tensor_info.quant.zero_point) * output_tensor_info.quant.scale;
+    }
+}
+
+int32_t ArgMax(const OutputTensorInfo& output_tensor_info, std::vector<int32_t>& index_map, std::vector<float>* score_map)
+{
+    int32_t outer, class_num, inner;
+    if (GetClassAxis(output_tensor_info, outer, class_num, inner) != InferenceHelper::kRetOk) {
+        return InferenceHelper::kRetErr;
+    }
+    int32_t tensor_type;
+    std::vector<float> buffer;
+    const void* data = GetComparableData(output_tensor_info, tensor_type, buffer);
+    if (data == nullptr) {
+        return InferenceHelper::kRetErr;
+    }
+
+    index_map.resize(outer * inner);
+    if (score_map) score_map->resize(outer * inner);
+    switch (tensor_type) {
+    case TensorInfo::kTensorTypeFp32:
+        ArgMaxImpl(static_cast<const float*>(data), outer, class_num, inner, index_map.data(), score_map ? score_map->data() : nullptr);
+        break;
+    case TensorInfo::kTensorTypeUint8:
+        ArgMaxQuantized(output_tensor_info, static_cast<const uint8_t*>(data), outer, class_num, inner, index_map, score_map);
+        break;
+    case TensorInfo::kTensorTypeInt8:
+        ArgMaxQuantized(output_tensor_info, static_cast<const int8_t*>(data), outer, class_num, inner, index_map, score_map);
+        break;
+    default:
+        return InferenceHelper::kRetErr;
+    }
+    return InferenceHelper::kRetOk;
+}
+
+
+/*** ArgMax + resize to image ***/
+/* Image rows processed by one thread at a time */
+static constexpr int32_t kRowNumPerTask = 16;
+
+/* Threshold to compare raw data directly (quantized value for quantized tensor) */
+static float RawThreshold(const OutputTensorInfo&, const float*, float threshold)
+{
+    return threshold;
+}
+
+template<typename T>
+static int32_t RawThreshold(const OutputTensorInfo& output_tensor_info, const T*, float threshold)
+{
+    if (threshold < -static_cast<float>((std::numeric_limits<int32_t>::max)())) return (std::numeric_limits<int32_t>::min)();
+    return output_tensor_info.QuantizeThreshold(threshold);
+}
+
+/* Nearest tensor coordinate of each image pixel (-1: out of the image area in the tensor)
+ * tensor_input = (image - crop) * scale + offset (input tensor), tensor_output = tensor_input * output_size / input_size
+ */
+static void CreateNearestTable(int32_t image_size, int32_t crop, int32_t crop_size, float scale, int32_t offset, int32_t transform_size, int32_t input_size, int32_t output_size, std::vector<int32_t>& table)
+{
+    table.resize(image_size);
+    for (int32_t i = 0; i < image_size; i++) {
+        table[i] = -1;
+        if (i < crop || i >= crop + crop_size) continue;
+        const float tensor_input = (i + 0.5f - crop) * scale + offset;
+        if (tensor_input < offset || tensor_input >= offset + transform_size) continue;
+        const int32_t tensor_output = static_cast<int32_t>(tensor_input * output_size / input_size);
+        table[i] = (std::max)(0, (std::min)(output_size - 1, tensor_output));
+    }
+}
+
+template<typename T>
+static void ArgMaxResizeToImageImpl(const OutputTensorInfo& output_tensor_info, const T* src, const std::vector<int32_t>& x_table, const std::vector<int32_t>& y_table,
+    float threshold, int32_t background, int32_t* label_map)
+{
+    const int32_t class_num = output_tensor_info.GetChannel();
+    const int32_t height = output_tensor_info.GetHeight();
+    const int32_t width = output_tensor_info.GetWidth();
+    const bool is_nchw = output_tensor_info.is_nchw;
+    const auto threshold_raw = RawThreshold(output_tensor_info, src, threshold);
+    const int32_t image_width = static_cast<int32_t>(x_table.size());
+    const int32_t image_height = static_cast<int32_t>(y_table.size());
+
+    const int32_t task_num = (image_height + kRowNumPerTask - 1) / kRowNumPerTask;
+#pragma omp parallel for if (task_num > 1)
+    for (int32_t task = 0; task < task_num; task++) {
+        /* Argmax of a tensor row is calculated once and used for the following image rows sampling the same tensor row */
+        std::vector<int32_t> index_row(width);
+        std::vector<T> max_row(width);
+        int32_t cached_y = -1;
+        const int32_t y_end = (std::min)(image_height, (task + 1) * kRowNumPerTask);
+        for (int32_t y = task * kRowNumPerTask; y < y_end; y++) {
+            int32_t* dst = label_map + y * image_width;
+            const int32_t tensor_y = y_table[y];
+            if (tensor_y < 0) {
+                std::fill(dst, dst + image_width, background);
+                continue;
+            }
+            if (tensor_y != cached_y) {
+                if (is_nchw) {
+                    InferenceHelperKernel::ArgMaxPlanar(src + tensor_y * width, class_num, width, height * width, index_row.data(), max_row.data());
+                } else {
+                    ArgMaxContiguous(src + tensor_y * width * class_num, width, class_num, index_row.data(), max_row.data());
+                }
+                for (int32_t x = 0; x < width; x++) {
+                    if (!(max_row[x] >= threshold_raw)) index_row[x] = background;
+                }
+                cached_y = tensor_y;
+            }
+            for (int32_t x = 0; x < image_width; x++) {
+                const int32_t tensor_x = x_table[x];
+                dst[x] = (tensor_x < 0) ? background : index_row[tensor_x];
+            }
+        }
+    }
+}
+
+/* image_info and image_transform used by PreProcess for the batch */
+static int32_t GetImageTransform(const OutputTensorInfo& output_tensor_info, const InputTensorInfo& input_tensor_info, int32_t batch,
+    const InputTensorInfo::ImageInfo*& image_info, const InputTensorInfo::ImageTransform*& image_transform)
+{
+    const int32_t batch_num = output_tensor_info.GetBatch();
+    if (output_tensor_info.tensor_dims.size() != 4 || output_tensor_info.GetElementNum() <= 0 || input_tensor_info.GetWidth() <= 0 || input_tensor_info.GetHeight() <= 0) {
+        PRINT_E("Invalid tensor dims (%s, %s)\n", output_tensor_info.name.c_str(), input_tensor_info.name.c_str());
+        return InferenceHelper::kRetErr;
+    }
+    const bool has_batch_list = !input_tensor_info.batch_list.empty();
+    if (batch < 0 || batch >= batch_num || (has_batch_list && batch >= static_cast<int32_t>(input_tensor_info.batch_list.size())) || (!has_batch_list && batch != 0)) {
+        PRINT_E("Invalid batch (%d)\n", batch);
+        return InferenceHelper::kRetErr;
+    }
+    image_info = has_batch_list ? &input_tensor_info.batch_list[batch].image_info : &input_tensor_info.image_info;
+    image_transform = has_batch_list ? &input_tensor_info.batch_list[batch].image_transform : &input_tensor_info.image_transform;
+    return InferenceHelper::kRetOk;
+}
+
+int32_t ArgMaxResizeToImage(const OutputTensorInfo& output_tensor_info, const InputTensorInfo& input_tensor_info, std::vector<int32_t>& label_map, int32_t batch, float threshold, int32_t background)
+{
+    const InputTensorInfo::ImageInfo* image_info_ptr;
+    const InputTensorInfo::ImageTransform* image_transform_ptr;
+    if (GetImageTransform(output_tensor_info, input_tensor_info, batch, image_info_ptr, image_transform_ptr) != InferenceHelper::kRetOk) {
+        return InferenceHelper::kRetErr;
+    }
+    const auto& image_info = *image_info_ptr;
+    const auto& image_transform = *image_transform_ptr;
+
+    int32_t tensor_type;
+    std::vector<float> buffer;
+    const void* data = GetComparableData(output_tensor_info, tensor_type, buffer);
+    if (data == nullptr) {
+        return InferenceHelper::kRetErr;
+    }
+
+    std::vector<int32_t> x_table;
+    std::vector<int32_t> y_table;
+    CreateNearestTable(image_info.width, image_info.crop_x, image_info.crop_width, image_transform.scale_x, image_transform.offset_x, image_transform.width, input_tensor_info.GetWidth(), output_tensor_info.GetWidth(), x_table);
+    CreateNearestTable(image_info.height, image_info.crop_y, image_info.crop_height, image_transform.scale_y, image_transform.offset_y, image_transform.height, input_tensor_info.GetHeight(), output_tensor_info.GetHeight(), y_table);
+
+    label_map.resize(image_info.width * image_info.height);
+    const int32_t batch_offset = output_tensor_info.GetElementNum() / output_tensor_info.GetBatch() * batch;
+    switch (tensor_type) {
+    case TensorInfo::kTensorTypeFp32:
+        ArgMaxResizeToImageImpl(output_tensor_info, static_cast<const float*>(data) + batch_offset, x_table, y_table, threshold, background, label_map.data());
+        break;
+    case TensorInfo::kTensorTypeUint8:
+        ArgMaxResizeToImageImpl(output_tensor_info, static_cast<const uint8_t*>(data) + batch_offset, x_table, y_table, threshold, background, label_map.data());
+        break;
+    case TensorInfo::kTensorTypeInt8:
+        ArgMaxResizeToImageImpl(output_tensor_info, static_cast<const int8_t*>(data) + batch_offset, x_table, y_table, threshold, background, label_map.data());
+        break;
+    default:
+        return InferenceHelper::kRetErr;
+    }
+    return InferenceHelper::kRetOk;
+}
+
+
+/*** Heatmap ***/
+/* Reverse of PreProcess: tensor_input = (image - crop) * scale + offset, tensor_output = tensor_input * output_size / input_size (pixel edge is integer) */
+static float ConvertToImage(float tensor, int32_t output_size, int32_t input_size, int32_t offset, float scale, int32_t crop)
+{
+    const float tensor_input = (tensor + 0.5f) * input_size / output_size;
+    return (tensor_input - offset) / scale + crop - 0.5f;
+}
+
+int32_t ConvertToImageCoordinate(const OutputTensorInfo& output_tensor_info, const InputTensorInfo& input_tensor_info, float tensor_x, float tensor_y, float& image_x, float& image_y, int32_t batch)
+{
+    const InputTensorInfo::ImageInfo* image_info;
+    const InputTensorInfo::ImageTransform* image_transform;
+    if (GetImageTransform(output_tensor_info, input_tensor_info, batch, image_info, image_transform) != InferenceHelper::kRetOk) {
+        return InferenceHelper::kRetErr;
+    }
+    image_x = ConvertToImage(tensor_x, output_tensor_info.GetWidth(), input_tensor_info.GetWidth(), image_transform->offset_x, image_transform->scale_x, image_info->crop_x);
+    image_y = ConvertToImage(tensor_y, output_tensor_info.GetHeight(), input_tensor_info.GetHeight(), image_transform->offset_y, image_transform->scale_y, image_info->crop_y);
+    return InferenceHelper::kRetOk;
+}
+
+/* Dequantized value (quantized values are affine, so comparison and quadratic fit can use raw values) */
+static float ToScore(const OutputTensorInfo&, float value)
+{
+    return value;
+}
+
+template<typename T>
+static float ToScore(const OutputTensorInfo& output_tensor_info, T value)
+{
+    return (value - output_tensor_info.quant.zero_point) * output_tensor_info.quant.scale;
+}
+
+/* Offset of the vertex of the parabola through (-1, left), (0, center), (1, right). 0 if center is not a peak */
+static float QuadraticOffset(float left, float center, float right)
+{
+    const float denominator = left - 2.0f * center + right;
+    if (!(denominator < 0.0f)) return 0.0f;
+    const float offset = 0.5f * (left - right) / denominator;
+    return (std::max)(-0.5f, (std::min)(0.5f, offset));
+}
+
+/* src[i * step] is the value at i = y * width + x. The first pixel in raster order wins on plateau */
+template<typename T>
+static bool IsLocalMax(const T* src, int32_t step, int32_t width, int32_t height, int32_t x, int32_t y, int32_t radius)
+{
+    const T val = src[(y * width + x) * step];
+    const int32_t x0 = (std::max)(0, x - radius);
+    const int32_t x1 = (std::min)(width - 1, x + radius);
+    const int32_t y0 = (std::max)(0, y - radius);
+    const int32_t y1 = (std::min)(height - 1, y + radius);
+    for (int32_t yy = y0; yy <= y1; yy++) {
+        for (int32_t xx = x0; xx <= x1; xx++) {
+            const T neighbor = src[(yy * width + xx) * step];
+            if (neighbor > val) return false;
+            if (neighbor == val && (yy < y || (yy == y && xx < x))) return false;
+        }
+    }
+    return true;
+}
+
+template<typename T, typename TH>
+static void DecodeHeatmapChannel(const OutputTensorInfo& output_tensor_info, const T* src, int32_t step, int32_t width, int32_t height, int32_t channel,
+    const HeatmapParameter& parameter, TH threshold_raw, std::vector<std::pair<T, int32_t>>& peak_list, std::vector<Keypoint>& keypoint_list)
+{
+    const int32_t num = width * height;
+    peak_list.clear();
+    if (parameter.max_peak_num == 1) {
+        T max_val = src[0];
+        int32_t max_index = 0;
+        for (int32_t i = 1; i < num; i++) {
+            if (src[i * step] > max_val) {
+                max_val = src[i * step];
+                max_index = i;
+            }
+        }
+        if (max_val >= threshold_raw) peak_list.push_back(std::make_pair(max_val, max_index));
+    } else {
+        for (int32_t y = 0; y < height; y++) {
+            for (int32_t x = 0; x < width; x++) {
+                const T val = src[(y * width + x) * step];
+                if (!(val >= threshold_raw)) continue;
+                if (IsLocalMax(src, step, width, height, x, y, parameter.nms_radius)) {
+                    peak_list.push_back(std::make_pair(val, y * width + x));
+                }
+            }
+        }
+        /* Higher score first, smaller index first for ties */
+        auto greater = [](const std::pair<T, int32_t>& a, const std::pair<T, int32_t>& b) {
+            return (a.first > b.first) || (a.first == b.first && a.second < b.second);
+        };
+        const size_t peak_num = (std::min)(peak_list.size(), static_cast<size_t>(parameter.max_peak_num));
+        std::partial_sort(peak_list.begin(), peak_list.begin() + peak_num, peak_list.end(), greater);
+        peak_list.resize(peak_num);
+    }
+
+    keypoint_list.resize(peak_list.size());
+    for (size_t i = 0; i < peak_list.size(); i++) {
+        const int32_t x = peak_list[i].second % width;
+        const int32_t y = peak_list[i].second / width;
+        Keypoint& keypoint = keypoint_list[i];
+        keypoint.channel = channel;
+        keypoint.score = ToScore(output_tensor_info, peak_list[i].first);
+        keypoint.x = static_cast<float>(x);
+        keypoint.y = static_cast<float>(y);
+        if (parameter.is_subpixel) {
+            const float center = static_cast<float>(peak_list[i].first);
+            const T* p = src + peak_list[i].second * step;
+            if (x > 0 && x < width - 1) keypoint.x += QuadraticOffset(static_cast<float>(p[-step]), center, static_cast<float>(p[step]));
+            if (y > 0 && y < height - 1) keypoint.y += QuadraticOffset(static_cast<float>(p[-width * step]), center, static_cast<float>(p[width * step]));
+        }
+    }
+}
+
+template<typename T>
+static void DecodeHeatmapImpl(const OutputTensorInfo& output_tensor_info, const T* src, const HeatmapParameter& parameter, std::vector<std::vector<Keypoint>>& channel_keypoint_list)
+{
+    const int32_t channel_num = output_tensor_info.GetChannel();
+    const int32_t height = output_tensor_info.GetHeight();
+    const int32_t width = output_tensor_info.GetWidth();
+    const bool is_nchw = output_tensor_info.is_nchw;
+    const auto threshold_raw = RawThreshold(output_tensor_info, src, parameter.threshold);
+
+#pragma omp parallel for if (channel_num > 1)
+    for (int32_t c = 0; c < channel_num; c++) {
+        std::vector<std::pair<T, int32_t>> peak_list;
+        if (is_nchw) {
+            DecodeHeatmapChannel(output_tensor_info, src + c * height * width, 1, width, height, c, parameter, threshold_raw, peak_list, channel_keypoint_list[c]);
+        } else {
+            DecodeHeatmapChannel(output_tensor_info, src + c, channel_num, width, height, c, parameter, threshold_raw, peak_list, channel_keypoint_list[c]);
+        }
+    }
+}
+
+int32_t DecodeHeatmap(const OutputTensorInfo& output_tensor_info, const HeatmapParameter& parameter, std::vector<Keypoint>& keypoint_list, const InputTensorInfo* input_tensor_info, int32_t batch)
+{
+    keypoint_list.clear();
+    if (output_tensor_info.tensor_dims.size() != 4 || output_tensor_info.GetElementNum() <= 0) {
+        PRINT_E("Invalid tensor dims (%s)\n", output_tensor_info.name.c_str());
+        return InferenceHelper::kRetErr;
+    }
+    const int32_t batch_num = output_tensor_info.GetBatch();
+    if (batch < 0 || batch >= batch_num || parameter.max_peak_num < 0 || parameter.nms_radius < 0) {
+        PRINT_E("Invalid batch or parameter (%d, %d, %d)\n", batch, parameter.max_peak_num, parameter.nms_radius);
+        return InferenceHelper::kRetErr;
+    }
+    const InputTensorInfo::ImageInfo* image_info = nullptr;
+    const InputTensorInfo::ImageTransform* image_transform = nullptr;
+    if (input_tensor_info && GetImageTransform(output_tensor_info, *input_tensor_info, batch, image_info, image_transform) != InferenceHelper::kRetOk) {
+        return InferenceHelper::kRetErr;
+    }
+    if (parameter.max_peak_num == 0) {
+        return InferenceHelper::kRetOk;
+    }
+
+    int32_t tensor_type;
+    std::vector<float> buffer;
+    const void* data = GetComparableData(output_tensor_info, tensor_type, buffer);
+    if (data == nullptr) {
+        return InferenceHelper::kRetErr;
+    }
+
+    std::vector<std::vector<Keypoint>> channel_keypoint_list(output_tensor_info.GetChannel());
+    const int32_t batch_offset = output_tensor_info.GetElementNum() / batch_num * batch;
+    switch (tensor_type) {
+    case TensorInfo::kTensorTypeFp32:
+        DecodeHeatmapImpl(output_tensor_info, static_cast<const float*>(data) + batch_offset, parameter, channel_keypoint_list);
+        break;
+    case TensorInfo::kTensorTypeUint8:
+        DecodeHeatmapImpl(output_tensor_info, static_cast<const uint8_t*>(data) + batch_offset, parameter, channel_keypoint_list);
+        break;
+    case TensorInfo::kTensorTypeInt8:
+        DecodeHeatmapImpl(output_tensor_info, static_cast<const int8_t*>(data) + batch_offset, parameter, channel_keypoint_list);
+        break;
+    default:
+        return InferenceHelper::kRetErr;
+    }
+
+    for (const auto& channel_keypoint : channel_keypoint_list) {
+        keypoint_list.insert(keypoint_list.end(), channel_keypoint.begin(), channel_keypoint.end());
+    }
+    if (input_tensor_info) {
+        for (auto& keypoint : keypoint_list) {
+            keypoint.x = ConvertToImage(keypoint.x, output_tensor_info.GetWidth(), input_tensor_info->GetWidth(), image_transform->offset_x, image_transform->scale_x, image_info->crop_x);
+            keypoint.y = ConvertToImage(keypoint.y, output_tensor_info.GetHeight(), input_tensor_info->GetHeight(), image_transform->offset_y, image_transform->scale_y, image_info->crop_y);
+        }
+    }
+    return InferenceHelper::kRetOk;
+}
+
+}
@@ -0,0 +1,93 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef INFERENCE_HELPER_POST_PROCESS_
+#define INFERENCE_HELPER_POST_PROCESS_
+
+/* for general */
+#include <cstdint>
+#include <cfloat>
+#include <vector>
+
+/* for My modules */
+#include "inference_helper.h"
+
+/* Common post-process for OutputTensorInfo (fp32, uint8 and int8 (quantized) tensors. Other types (e.g. fp16) are converted to fp32 internally)
+ * The class axis is the channel for 4 dimension tensor (NCHW or NHWC is decided by is_nchw), and the last dimension for others (e.g. [1, 1000])
+ * Quantized values are compared as they are without dequantization (except for per axis quantized tensor)
+ * Returns InferenceHelper::kRetOk or InferenceHelper::kRetErr
+ */
+namespace InferenceHelperPostProcess {
+
+struct IndexScore {
+    int32_t index;
+    float   score;      // dequantized value
+};
+
+/* Softmax along the class axis. dst has GetElementNum() elements in the same layout as the tensor */
+int32_t Softmax(const OutputTensorInfo& output_tensor_info, std::vector<float>& dst);
+
+/* k largest elements of the batch in descending order (the smaller index first for ties). index is the position in the batch */
+int32_t TopK(const OutputTensorInfo& output_tensor_info, int32_t k, std::vector<IndexScore>& result, int32_t batch = 0);
+
+/* Index of the max class for each position (e.g. each pixel of NCHW/NHWC segmentation output, or each batch of [N, class] output)
+ * index_map has GetElementNum() / (number of class) elements. score_map (can be nullptr) receives the dequantized max value
+ */
+int32_t ArgMax(const OutputTensorInfo& output_tensor_info, std::vector<int32_t>& index_map, std::vector<float>* score_map = nullptr);
+
+/* Label map of the original image (image_info.width x image_info.height) for 4 dimension segmentation output (NCHW or NHWC)
+ * Each image pixel is mapped to the output tensor by the transform of PreProcess (crop, resize and letterbox) with nearest neighbor,
+ * and argmax over channels is calculated only for the tensor rows used. Argmax and resize are done in one pass, multithreaded over rows
+ * Pixels out of the crop area, or whose max value (dequantized) is lower than threshold, are set to background
+ */
+int32_t ArgMaxResizeToImage(const OutputTensorInfo& output_tensor_info, const InputTensorInfo& input_tensor_info, std::vector<int32_t>& label_map,
+    int32_t batch = 0, float threshold = -FLT_MAX, int32_t background = 0);
+
+/* Convert a coordinate of 4 dimension output tensor (pixel center is integer. e.g. peak of heatmap) into the original image coordinate
+ * by reverting the transform of PreProcess (crop, resize and letterbox). The output tensor is assumed to cover the whole input tensor (e.g. stride 4 heatmap)
+ */
+int32_t ConvertToImageCoordinate(const OutputTensorInfo& output_tensor_info, const InputTensorInfo& input_tensor_info, float tensor_x, float tensor_y, float& image_x, float& image_y, int32_t batch = 0);
+
+struct Keypoint {
+    int32_t channel;    // heatmap index (e.g. joint id)
+    float   score;      // dequantized value at the peak
+    float   x;          // tensor coordinate, or image coordinate if input_tensor_info is given. Pixel center is integer
+    float   y;
+};
+
+struct HeatmapParameter {
+    HeatmapParameter()
+        : max_peak_num(1)
+        , threshold(-FLT_MAX)
+        , nms_radius(1)
+        , is_subpixel(true)
+    {}
+
+    int32_t max_peak_num;   // peaks per channel. 1: argmax of the channel, >1: local maxima with the highest scores
+    float   threshold;      // peaks whose score is lower than this are not output
+    int32_t nms_radius;     // max_peak_num > 1: a peak must be the max in (2 * nms_radius + 1)^2 window
+    bool    is_subpixel;    // refine the peak by quadratic fit to the neighbors (x and y separately)
+};
+
+/* Peaks of each channel of 4 dimension heatmap output (NCHW or NHWC, e.g. [1, 17, 64, 48] for pose estimation). Multithreaded over channels
+ * Values are compared as they are (quantized values are not dequantized). keypoint_list is sorted by channel, then score (higher first)
+ * With max_peak_num = 1 and the default threshold, keypoint_list[c] is the keypoint of channel c
+ * If input_tensor_info is given, coordinates are converted into the original image by ConvertToImageCoordinate
+ */
+int32_t DecodeHeatmap(const OutputTensorInfo& output_tensor_info, const HeatmapParameter& parameter, std::vector<Keypoint>& keypoint_list,
+    const InputTensorInfo* input_tensor_info = nullptr, int32_t batch = 0);
+
+}
+
+#endif
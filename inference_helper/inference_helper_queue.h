@@ -0,0 +1,219 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef INFERENCE_HELPER_QUEUE_
+#define INFERENCE_HELPER_QUEUE_
+
+/* for general */
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+/* Bounded lock-free queues used to connect stages of InferenceHelperStreamRunner
+ * TryPush / TryPop never block (return false when full / empty). Blocking and drop policies are up to the caller
+ * Capacity is exact (not rounded up to power of two). Elements are moved in and out
+ * Mailbox is a single slot which keeps only the latest element (for real-time input)
+ */
+namespace InferenceHelperQueue {
+
+/* Padding to put the producer side and the consumer side into different cache lines */
+static constexpr size_t kCacheLineSize = 64;
+
+/* Single producer, single consumer. TryPush is called from one thread and TryPop from one (other) thread */
+template<typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(int32_t capacity)
+        : capacity_(capacity > 0 ? static_cast<size_t>(capacity) : 1)
+        , buffer_(new T[capacity_])
+        , head_(0)
+        , tail_(0)
+    {}
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    bool TryPush(T&& value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == capacity_) return false;
+        buffer_[tail % capacity_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        value = std::move(buffer_[head % capacity_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Approximate when called while the other side is running */
+    int32_t Size() const { return static_cast<int32_t>(tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire)); }
+    int32_t Capacity() const { return static_cast<int32_t>(capacity_); }
+
+private:
+    const size_t         capacity_;
+    std::unique_ptr<T[]> buffer_;
+    char                 pad0_[kCacheLineSize];
+    std::atomic<size_t>  head_;     // read position (written by the consumer)
+    char                 pad1_[kCacheLineSize];
+    std::atomic<size_t>  tail_;     // write position (written by the producer)
+    char                 pad2_[kCacheLineSize];
+};
+
+/* Multiple producers, multiple consumers (bounded queue with a sequence number per cell)
+ * A producer can also TryPop (e.g. to drop the oldest element when the queue is full)
+ * The algorithm needs 2 cells at least (with 1 cell, "has element" and "free for the next lap" are the same sequence), so capacity 1 uses 2 cells and the size is limited separately
+ */
+template<typename T>
+class MpmcQueue {
+public:
+    explicit MpmcQueue(int32_t capacity)
+        : capacity_(capacity > 0 ? static_cast<size_t>(capacity) : 1)
+        , cell_num_(capacity_ < 2 ? 2 : capacity_)
+        , cell_list_(new Cell[cell_num_])
+        , enqueue_pos_(0)
+        , dequeue_pos_(0)
+    {
+        for (size_t i = 0; i < cell_num_; i++) {
+            cell_list_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    bool TryPush(T&& value)
+    {
+        Cell* cell;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            if (capacity_ < cell_num_ && static_cast<intptr_t>(pos - dequeue_pos_.load(std::memory_order_acquire)) >= static_cast<intptr_t>(capacity_)) {
+                /* Full by capacity. dequeue_pos_ read here is never newer than the actual one, so the size never exceeds capacity (pos may be old, then the cell check below reloads it) */
+                return false;
+            }
+            cell = &cell_list_[pos % cell_num_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                /* The cell is free for pos */
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                /* The cell still has the element pushed at (pos - cell_num_) */
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value)
+    {
+        Cell* cell;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cell_list_[pos % cell_num_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                /* The cell has the element pushed at pos */
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->data);
+        cell->sequence.store(pos + cell_num_, std::memory_order_release);
+        return true;
+    }
+
+    /* Approximate when called while other threads are running */
+    int32_t Size() const
+    {
+        const size_t enqueue_pos = enqueue_pos_.load(std::memory_order_acquire);
+        const size_t dequeue_pos = dequeue_pos_.load(std::memory_order_acquire);
+        return enqueue_pos > dequeue_pos ? static_cast<int32_t>(enqueue_pos - dequeue_pos) : 0;
+    }
+    int32_t Capacity() const { return static_cast<int32_t>(capacity_); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;   // == pos: free for the push at pos, == pos + 1: has the element pushed at pos
+        T                   data;
+    };
+
+private:
+    const size_t            capacity_;
+    const size_t            cell_num_;
+    std::unique_ptr<Cell[]> cell_list_;
+    char                    pad0_[kCacheLineSize];
+    std::atomic<size_t>     enqueue_pos_;
+    char                    pad1_[kCacheLineSize];
+    std::atomic<size_t>     dequeue_pos_;
+    char                    pad2_[kCacheLineSize];
+};
+
+/* Single slot holding the latest pointer. Post replaces the element not taken yet, so the consumer always takes the newest one
+ * Any number of producers and consumers. The mailbox doesn't own the elements: the replaced one is returned to the producer to recycle
+ */
+template<typename T>
+class Mailbox {
+public:
+    Mailbox() : slot_(nullptr), posted_num_(0), dropped_num_(0) {}
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    /* Returns the element replaced without being taken (dropped), or nullptr */
+    T* Post(T* value)
+    {
+        T* stale = slot_.exchange(value, std::memory_order_acq_rel);
+        posted_num_.fetch_add(1, std::memory_order_relaxed);
+        if (stale) dropped_num_.fetch_add(1, std::memory_order_relaxed);
+        return stale;
+    }
+
+    /* Post only if the slot is empty (nothing is dropped) */
+    bool TryPost(T* value)
+    {
+        T* expected = nullptr;
+        if (!slot_.compare_exchange_strong(expected, value, std::memory_order_acq_rel)) return false;
+        posted_num_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /* Returns nullptr if empty */
+    T* Take() { return slot_.exchange(nullptr, std::memory_order_acq_rel); }
+
+    bool IsEmpty() const { return slot_.load(std::memory_order_acquire) == nullptr; }
+    int64_t GetPostedNum() const { return posted_num_.load(std::memory_order_relaxed); }
+    int64_t GetDroppedNum() const { return dropped_num_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<T*>      slot_;
+    std::atomic<int64_t> posted_num_;
+    std::atomic<int64_t> dropped_num_;  // posted but replaced before taken
+};
+
+}
+
+#endif
@@ -66,9 +66,10 @@ int32_t InferenceHelperSample::SetCustomOps(const std::vector<std::pair<const ch
 int32_t InferenceHelperSample::Initialize(const std::string& model_filename, std::vector<InputTensorInfo>& input_tensor_info_list, std::vector<OutputTensorInfo>& output_tensor_info_list)
 {
 
-    /*** Convert normalize parameter to speed up ***/
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /*** Compile pre-process for each input tensor (normalize parameters are converted to speed up). ***/
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, nullptr);
     }
 
     return kRetOk;
@@ -86,5 +87,9 @@ int32_t InferenceHelperSample::PreProcess(const std::vector<InputTensorInfo>& in
 
 int32_t InferenceHelperSample::Process(std::vector<OutputTensorInfo>& output_tensor_info_list)
 {
+    if (ConvertOutputLayout(num_threads_, true, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
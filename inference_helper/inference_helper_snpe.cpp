@@ -130,9 +130,10 @@ int32_t InferenceHelperSnpe::Initialize(const std::string& model_filename, std::
         return kRetErr;
     }
 
-    /* Convert normalize parameter to speed up */
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /* Compile pre-process for each input tensor (normalize parameters are converted to speed up). Only normalize parameters are used */
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, nullptr);
     }
 
     return kRetOk;
@@ -151,7 +152,17 @@ int32_t InferenceHelperSnpe::PreProcess(const std::vector<InputTensorInfo>& inpu
         return kRetErr;
     }
 
-    for (const auto& input_tensor_info : input_tensor_info_list) {
+    if (input_tensor_info_list.size() != pre_process_plan_list_.size()) {
+        PRINT_E("The number of input tensors is different from Initialize (%zu != %zu)\n", input_tensor_info_list.size(), pre_process_plan_list_.size());
+        return kRetErr;
+    }
+    for (size_t input_tensor_index = 0; input_tensor_index < input_tensor_info_list.size(); input_tensor_index++) {
+        const auto& input_tensor_info = input_tensor_info_list[input_tensor_index];
+        const auto& plan = pre_process_plan_list_[input_tensor_index];
+        if (!input_tensor_info.batch_list.empty()) {
+            PRINT_E("batch_list is not supported\n");
+            return kRetErr;
+        }
         const int32_t img_width = input_tensor_info.GetWidth();
         const int32_t img_height = input_tensor_info.GetHeight();
         const int32_t img_channel = input_tensor_info.GetChannel();
@@ -168,21 +179,30 @@ int32_t InferenceHelperSnpe::PreProcess(const std::vector<InputTensorInfo>& inpu
                 PRINT_E("Color conversion is not supported\n");
                 return  kRetErr;
             }
+            if (input_tensor_info.image_info.letterbox != InputTensorInfo::kLetterboxNone) {
+                PRINT_E("Letterbox is not supported\n");
+                return  kRetErr;
+            }
 
             /* Normalize image (NHWC to NHWC)*/
             uint8_t* src = static_cast<uint8_t*>(input_tensor_info.data);
+            const int32_t src_stride = (input_tensor_info.image_info.stride > 0) ? input_tensor_info.image_info.stride : img_width * img_channel;
             if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8) {
                 PRINT_E("kTensorTypeUint8 is not supported\n");
             } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
                 float* dst = reinterpret_cast<float*> (&application_input_buffers_.at(input_tensor_info.name)[0]);
 #pragma omp parallel for num_threads(num_threads_)
-                for (int32_t i = 0; i < img_width * img_height; i++) {
-                    for (int32_t c = 0; c < img_channel; c++) {
+                for (int32_t y = 0; y < img_height; y++) {
+                    const uint8_t* src_row = src + y * src_stride;
+                    float* dst_row = dst + y * img_width * img_channel;
+                    for (int32_t i = 0; i < img_width; i++) {
+                        for (int32_t c = 0; c < img_channel; c++) {
 #if 1
-                        dst[i * img_channel + c] = (src[i * img_channel + c] - input_tensor_info.normalize.mean[c]) * input_tensor_info.normalize.norm[c];
+                            dst_row[i * img_channel + c] = (src_row[i * img_channel + c] - plan.mean[c]) * plan.norm[c];
 #else
-                        dst[i * img_channel + c] = (src[i * img_channel + c] / 255.0f - input_tensor_info.normalize.mean[c]) / input_tensor_info.normalize.norm[c];
+                            dst_row[i * img_channel + c] = (src_row[i * img_channel + c] / 255.0f - input_tensor_info.normalize.mean[c]) / input_tensor_info.normalize.norm[c];
 #endif
+                        }
                     }
                 }
             } else {
@@ -218,6 +238,10 @@ int32_t InferenceHelperSnpe::Process(std::vector<OutputTensorInfo>& output_tenso
         output_tensor_info.data = application_output_buffers_.at(output_tensor_info.name).data();
     }
 
+    if (ConvertOutputLayout(num_threads_, false, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
 
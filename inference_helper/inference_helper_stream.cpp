@@ -0,0 +1,397 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+/* for My modules */
+#include "inference_helper_log.h"
+#include "inference_helper.h"
+#include "inference_helper_queue.h"
+#include "inference_helper_stream.h"
+
+/*** Macro ***/
+#define TAG "InferenceHelperStreamRunner"
+#define PRINT(...)   INFERENCE_HELPER_LOG_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) INFERENCE_HELPER_LOG_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Setting ***/
+static constexpr int32_t kBackoffYieldNum = 64;     // yield this many times before sleeping while a queue is full / empty
+static constexpr int32_t kBackoffSleepUs = 100;
+
+/*** Function ***/
+namespace {
+/* The number of frames queued in the edge at most */
+int32_t GetEdgeCapacity(const InferenceHelperStreamRunner::EdgeParameter& parameter)
+{
+    return parameter.backpressure == InferenceHelperStreamRunner::kBackpressureLatest ? 1 : parameter.capacity;
+}
+
+/* Wait for the other stage without lock: yield first for low latency, then sleep not to burn the core */
+class Backoff {
+public:
+    Backoff() : count_(0) {}
+    void Wait()
+    {
+        if (count_ < kBackoffYieldNum) {
+            count_++;
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(kBackoffSleepUs));
+        }
+    }
+
+private:
+    int32_t count_;
+};
+}
+
+void InferenceHelperStreamRunner::Edge::Initialize(const EdgeParameter& parameter, bool is_single_producer, bool is_single_consumer)
+{
+    backpressure = parameter.backpressure;
+    pushed_num = 0;
+    dropped_num = 0;
+    spsc_queue_.reset();
+    mpmc_queue_.reset();
+    mailbox_.reset();
+    /* DropOldest pops on the producer side, so the consumer is not single */
+    if (backpressure == kBackpressureLatest) {
+        mailbox_.reset(new InferenceHelperQueue::Mailbox<Frame>());
+    } else if (is_single_producer && is_single_consumer && backpressure != kBackpressureDropOldest) {
+        spsc_queue_.reset(new InferenceHelperQueue::SpscQueue<Frame*>(parameter.capacity));
+    } else {
+        mpmc_queue_.reset(new InferenceHelperQueue::MpmcQueue<Frame*>(parameter.capacity));
+    }
+}
+
+bool InferenceHelperStreamRunner::Edge::TryPush(Frame* frame)
+{
+    if (mailbox_) return mailbox_->TryPost(frame);
+    return spsc_queue_ ? spsc_queue_->TryPush(std::move(frame)) : mpmc_queue_->TryPush(std::move(frame));
+}
+
+bool InferenceHelperStreamRunner::Edge::TryPop(Frame*& frame)
+{
+    if (mailbox_) {
+        frame = mailbox_->Take();
+        return frame != nullptr;
+    }
+    return spsc_queue_ ? spsc_queue_->TryPop(frame) : mpmc_queue_->TryPop(frame);
+}
+
+int32_t InferenceHelperStreamRunner::Edge::Size() const
+{
+    if (mailbox_) return mailbox_->IsEmpty() ? 0 : 1;
+    return spsc_queue_ ? spsc_queue_->Size() : mpmc_queue_->Size();
+}
+
+InferenceHelperStreamRunner::Parameter InferenceHelperStreamRunner::GetRealTimeParameter(int32_t post_process_thread_num)
+{
+    Parameter parameter;
+    for (auto& edge : parameter.edge) {
+        edge.capacity = 1;
+        edge.backpressure = kBackpressureLatest;
+    }
+    parameter.post_process_thread_num = post_process_thread_num;
+    return parameter;
+}
+
+InferenceHelperStreamRunner::InferenceHelperStreamRunner()
+    : inference_helper_(nullptr)
+    , source_num_(0)
+    , post_processed_num_(0)
+    , error_num_(0)
+    , is_exit_(true)
+{
+    end_frame_.id = -1;
+    end_frame_.result = InferenceHelper::kRetOk;
+    end_frame_.slot = -1;
+}
+
+InferenceHelperStreamRunner::~InferenceHelperStreamRunner()
+{
+    Finalize();
+}
+
+int32_t InferenceHelperStreamRunner::Initialize(InferenceHelper* inference_helper, const std::vector<OutputTensorInfo>& output_tensor_info_list, const Parameter& parameter, const SourceFunction& source, const PostProcessFunction& post_process)
+{
+    Finalize();
+    if (inference_helper == nullptr || !source || !post_process || parameter.post_process_thread_num < 1) {
+        PRINT_E("Invalid parameter (post_process_thread_num = %d)\n", parameter.post_process_thread_num);
+        return InferenceHelper::kRetErr;
+    }
+    for (const auto& edge : parameter.edge) {
+        if (edge.capacity < 1 || edge.backpressure < kBackpressureBlock || edge.backpressure > kBackpressureLatest) {
+            PRINT_E("Invalid edge parameter (capacity = %d, backpressure = %d)\n", edge.capacity, edge.backpressure);
+            return InferenceHelper::kRetErr;
+        }
+    }
+
+    /* A slot is used by the frame being pre-processed, the queued frames and the frame being committed */
+    const int32_t slot_num = GetEdgeCapacity(parameter.edge[kEdgePreProcessToInference]) + 2;
+    if (inference_helper->SetPreProcessSlotNum(slot_num) != InferenceHelper::kRetOk) {
+        return InferenceHelper::kRetErr;
+    }
+    free_slot_queue_.reset(new InferenceHelperQueue::MpmcQueue<int32_t>(slot_num));
+    for (int32_t slot = 0; slot < slot_num; slot++) {
+        int32_t value = slot;
+        free_slot_queue_->TryPush(std::move(value));
+    }
+
+    /* Frames queued in the edges and held by each thread. Source never waits for a free frame */
+    int32_t frame_num = 3 + parameter.post_process_thread_num;
+    for (const auto& edge : parameter.edge) frame_num += GetEdgeCapacity(edge);
+    frame_list_.clear();
+    free_frame_queue_.reset(new InferenceHelperQueue::MpmcQueue<Frame*>(frame_num));
+    for (int32_t i = 0; i < frame_num; i++) {
+        std::unique_ptr<Frame> frame(new Frame());
+        frame->id = -1;
+        frame->result = InferenceHelper::kRetOk;
+        frame->slot = -1;
+        Frame* p = frame.get();
+        free_frame_queue_->TryPush(std::move(p));
+        frame_list_.push_back(std::move(frame));
+    }
+
+    edge_list_[kEdgeSourceToPreProcess].Initialize(parameter.edge[kEdgeSourceToPreProcess], true, true);
+    edge_list_[kEdgePreProcessToInference].Initialize(parameter.edge[kEdgePreProcessToInference], true, true);
+    edge_list_[kEdgeInferenceToPostProcess].Initialize(parameter.edge[kEdgeInferenceToPostProcess], true, parameter.post_process_thread_num == 1);
+
+    inference_helper_ = inference_helper;
+    output_tensor_info_list_ = output_tensor_info_list;
+    parameter_ = parameter;
+    source_ = source;
+    post_process_ = post_process;
+    source_num_ = 0;
+    post_processed_num_ = 0;
+    error_num_ = 0;
+    is_exit_ = false;
+
+    thread_post_process_list_.clear();
+    for (int32_t i = 0; i < parameter.post_process_thread_num; i++) {
+        thread_post_process_list_.push_back(std::thread(&InferenceHelperStreamRunner::ThreadPostProcess, this));
+    }
+    thread_inference_ = std::thread(&InferenceHelperStreamRunner::ThreadInference, this);
+    thread_pre_process_ = std::thread(&InferenceHelperStreamRunner::ThreadPreProcess, this);
+    thread_source_ = std::thread(&InferenceHelperStreamRunner::ThreadSource, this);
+    return InferenceHelper::kRetOk;
+}
+
+int32_t InferenceHelperStreamRunner::Join(void)
+{
+    if (thread_source_.joinable()) thread_source_.join();
+    if (thread_pre_process_.joinable()) thread_pre_process_.join();
+    if (thread_inference_.joinable()) thread_inference_.join();
+    for (auto& thread : thread_post_process_list_) {
+        if (thread.joinable()) thread.join();
+    }
+    thread_post_process_list_.clear();
+    is_exit_ = true;
+    return InferenceHelper::kRetOk;
+}
+
+int32_t InferenceHelperStreamRunner::Finalize(void)
+{
+    is_exit_ = true;
+    Join();
+    inference_helper_ = nullptr;
+    return InferenceHelper::kRetOk;
+}
+
+InferenceHelperStreamRunner::Statistics InferenceHelperStreamRunner::GetStatistics(void)
+{
+    Statistics statistics;
+    statistics.source_num = source_num_;
+    statistics.post_processed_num = post_processed_num_;
+    statistics.error_num = error_num_;
+    for (int32_t i = 0; i < kEdgeNum; i++) {
+        statistics.edge[i].pushed_num = edge_list_[i].pushed_num;
+        statistics.edge[i].dropped_num = edge_list_[i].dropped_num;
+        statistics.edge[i].queued_num = is_exit_ ? 0 : edge_list_[i].Size();
+    }
+    return statistics;
+}
+
+void InferenceHelperStreamRunner::PrintStatistics(void)
+{
+    static const char* kEdgeName[kEdgeNum] = { "source -> pre-process", "pre-process -> inference", "inference -> post-process" };
+    const Statistics statistics = GetStatistics();
+    PRINT("source: %lld, post-processed: %lld, error: %lld\n", static_cast<long long>(statistics.source_num), static_cast<long long>(statistics.post_processed_num), static_cast<long long>(statistics.error_num));
+    for (int32_t i = 0; i < kEdgeNum; i++) {
+        PRINT("%s: pushed %lld, dropped %lld, queued %d\n", kEdgeName[i], static_cast<long long>(statistics.edge[i].pushed_num), static_cast<long long>(statistics.edge[i].dropped_num), statistics.edge[i].queued_num);
+    }
+}
+
+bool InferenceHelperStreamRunner::Push(Edge& edge, Frame* frame, bool is_drop_allowed)
+{
+    const int32_t backpressure = is_drop_allowed ? edge.backpressure : static_cast<int32_t>(kBackpressureBlock);
+    if (backpressure == kBackpressureLatest) {
+        /* Replace the frame the consumer hasn't taken yet */
+        Frame* stale = edge.Post(frame);
+        edge.pushed_num++;
+        if (stale) {
+            ReleaseFrame(stale);
+            edge.dropped_num++;
+        }
+        return true;
+    }
+    Backoff backoff;
+    while (!edge.TryPush(frame)) {
+        if (is_exit_) {
+            ReleaseFrame(frame);
+            return false;
+        }
+        if (backpressure == kBackpressureDropNewest) {
+            ReleaseFrame(frame);
+            edge.dropped_num++;
+            return true;
+        } else if (backpressure == kBackpressureDropOldest) {
+            Frame* oldest;
+            if (edge.TryPop(oldest)) {
+                ReleaseFrame(oldest);
+                edge.dropped_num++;
+            }
+        } else {
+            backoff.Wait();
+        }
+    }
+    edge.pushed_num++;
+    return true;
+}
+
+bool InferenceHelperStreamRunner::Pop(Edge& edge, Frame*& frame)
+{
+    Backoff backoff;
+    while (!edge.TryPop(frame)) {
+        if (is_exit_) return false;
+        backoff.Wait();
+    }
+    return true;
+}
+
+void InferenceHelperStreamRunner::ReleaseFrame(Frame* frame)
+{
+    if (frame == &end_frame_) return;
+    if (frame->slot >= 0) {
+        int32_t slot = frame->slot;
+        free_slot_queue_->TryPush(std::move(slot));
+        frame->slot = -1;
+    }
+    free_frame_queue_->TryPush(std::move(frame));
+}
+
+void InferenceHelperStreamRunner::ThreadSource(void)
+{
+    Backoff backoff;
+    while (!is_exit_) {
+        Frame* frame;
+        if (!free_frame_queue_->TryPop(frame)) {
+            backoff.Wait();
+            continue;
+        }
+        frame->id = source_num_;
+        frame->result = InferenceHelper::kRetOk;
+        if (!source_(*frame)) {
+            ReleaseFrame(frame);
+            Push(edge_list_[kEdgeSourceToPreProcess], &end_frame_, false);
+            return;
+        }
+        source_num_++;
+        if (!Push(edge_list_[kEdgeSourceToPreProcess], frame)) return;
+    }
+}
+
+void InferenceHelperStreamRunner::ThreadPreProcess(void)
+{
+    Frame* frame;
+    while (Pop(edge_list_[kEdgeSourceToPreProcess], frame)) {
+        if (frame == &end_frame_) {
+            Push(edge_list_[kEdgePreProcessToInference], frame, false);
+            return;
+        }
+        int32_t slot;
+        Backoff backoff;
+        while (!free_slot_queue_->TryPop(slot)) {
+            if (is_exit_) {
+                ReleaseFrame(frame);
+                return;
+            }
+            backoff.Wait();
+        }
+        frame->slot = slot;
+        frame->result = inference_helper_->PreProcessToSlot(slot, frame->input_tensor_info_list);
+        if (!Push(edge_list_[kEdgePreProcessToInference], frame)) return;
+    }
+}
+
+void InferenceHelperStreamRunner::ThreadInference(void)
+{
+    Frame* frame;
+    while (Pop(edge_list_[kEdgePreProcessToInference], frame)) {
+        if (frame == &end_frame_) {
+            /* Every post-process thread ends at the end frame */
+            for (int32_t i = 0; i < parameter_.post_process_thread_num; i++) {
+                Push(edge_list_[kEdgeInferenceToPostProcess], frame, false);
+            }
+            return;
+        }
+        if (frame->result == InferenceHelper::kRetOk) {
+            frame->result = inference_helper_->CommitPreProcess(frame->slot, frame->input_tensor_info_list);
+        }
+        /* The staging slot is free once committed */
+        int32_t slot = frame->slot;
+        free_slot_queue_->TryPush(std::move(slot));
+        frame->slot = -1;
+
+        if (frame->result == InferenceHelper::kRetOk) {
+            frame->result = inference_helper_->Process(output_tensor_info_list_);
+        }
+        if (frame->result == InferenceHelper::kRetOk) {
+            /* The framework's output buffer is overwritten by the next frame, so the result is copied into the frame */
+            frame->output_tensor_info_list = output_tensor_info_list_;
+            frame->output_buffer_list.resize(output_tensor_info_list_.size());
+            for (size_t i = 0; i < output_tensor_info_list_.size(); i++) {
+                auto& output_tensor_info = frame->output_tensor_info_list[i];
+                if (output_tensor_info.data == nullptr) continue;
+                auto& buffer = frame->output_buffer_list[i];
+                buffer.resize(output_tensor_info.GetByteSize());
+                std::memcpy(buffer.data(), output_tensor_info.data, buffer.size());
+                output_tensor_info.data = buffer.data();
+            }
+        } else {
+            error_num_++;
+        }
+        if (!Push(edge_list_[kEdgeInferenceToPostProcess], frame)) return;
+    }
+}
+
+void InferenceHelperStreamRunner::ThreadPostProcess(void)
+{
+    Frame* frame;
+    while (Pop(edge_list_[kEdgeInferenceToPostProcess], frame)) {
+        if (frame == &end_frame_) return;
+        post_process_(*frame);
+        post_processed_num_++;
+        ReleaseFrame(frame);
+    }
+}
@@ -0,0 +1,181 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef INFERENCE_HELPER_STREAM_
+#define INFERENCE_HELPER_STREAM_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+
+/* for My modules */
+#include "inference_helper.h"
+#include "inference_helper_queue.h"
+
+/* Streaming runner: source -> pre-process -> inference -> post-process, each stage on its own thread (post-process on a thread group)
+ * Stages are connected by bounded lock-free queues (edges). Each edge has its own capacity and backpressure policy for when it's full
+ *   - kBackpressureBlock      : the producer stage waits (nothing is lost, the source is throttled)
+ *   - kBackpressureDropOldest : the oldest queued frame is dropped (keep latency low, e.g. camera)
+ *   - kBackpressureDropNewest : the frame being pushed is dropped
+ *   - kBackpressureLatest     : the edge is a single-slot mailbox (capacity is ignored) which keeps only the newest frame
+ * Real-time mode (GetRealTimeParameter) uses kBackpressureLatest for every edge, so inference always takes the freshest input
+ * and the latency from the source to post-process is bounded by about one inference time (frames arriving meanwhile are dropped)
+ * Pre-process of the next frames is stored into the staging slots of the InferenceHelper (PreProcessToSlot), so it overlaps inference
+ * Frames are allocated at Initialize and recycled, so no allocation happens while streaming (except buffers growing at the first frames)
+ */
+class InferenceHelperStreamRunner {
+public:
+    enum {
+        kBackpressureBlock,
+        kBackpressureDropOldest,
+        kBackpressureDropNewest,
+        kBackpressureLatest,
+    };
+
+    enum {
+        kEdgeSourceToPreProcess,
+        kEdgePreProcessToInference,
+        kEdgeInferenceToPostProcess,
+        kEdgeNum,
+    };
+
+    struct Frame {
+        int64_t id;         // sequential number given when the source is called
+        int32_t result;     // result of PreProcess and Process
+        std::vector<InputTensorInfo>  input_tensor_info_list;   // set by the source (kept from the previous use of the frame). image_transform is set by pre-process
+        std::vector<OutputTensorInfo> output_tensor_info_list;  // set by inference. data is owned by the frame
+        std::vector<uint8_t> source_buffer;     // free to use by the source (e.g. copy of the captured image pointed by input_tensor_info_list)
+
+        /* Used by the runner */
+        int32_t slot;       // staging slot of the pre-processed data (-1: none)
+        std::vector<std::vector<uint8_t>> output_buffer_list;
+    };
+
+    /* Fill input_tensor_info_list of the frame (the data must be kept until the frame is post-processed, e.g. in source_buffer)
+     * Return false at the end of the stream (the frame is not used)
+     */
+    typedef std::function<bool(Frame& frame)> SourceFunction;
+    /* Called for each frame reached post-process (result is kRetErr if PreProcess or Process failed)
+     * Called from post_process_thread_num threads in parallel, so frames can be out of order when the number is > 1
+     */
+    typedef std::function<void(Frame& frame)> PostProcessFunction;
+
+    struct EdgeParameter {
+        EdgeParameter()
+            : capacity(2)
+            , backpressure(kBackpressureBlock)
+        {}
+
+        int32_t capacity;       // the number of frames queued between the stages
+        int32_t backpressure;   // kBackpressureXxx
+    };
+
+    struct Parameter {
+        Parameter()
+            : post_process_thread_num(1)
+        {}
+
+        EdgeParameter edge[kEdgeNum];
+        int32_t post_process_thread_num;
+    };
+
+    /* Latest-frame-only mode for live input (e.g. camera) */
+    static Parameter GetRealTimeParameter(int32_t post_process_thread_num = 1);
+
+    struct EdgeStatistics {
+        int64_t pushed_num;
+        int64_t dropped_num;
+        int32_t queued_num;     // at the time of GetStatistics
+    };
+
+    struct Statistics {
+        int64_t source_num;
+        int64_t post_processed_num;
+        int64_t error_num;
+        EdgeStatistics edge[kEdgeNum];
+    };
+
+public:
+    InferenceHelperStreamRunner();
+    ~InferenceHelperStreamRunner();
+    /* inference_helper must be initialized (not owned). output_tensor_info_list is the one used for Initialize of inference_helper
+     * Threads start here, and the source is called right away
+     */
+    int32_t Initialize(InferenceHelper* inference_helper, const std::vector<OutputTensorInfo>& output_tensor_info_list, const Parameter& parameter, const SourceFunction& source, const PostProcessFunction& post_process);
+    /* Wait until the end of the stream (the source returned false) is post-processed */
+    int32_t Join(void);
+    /* Stop immediately. Queued frames are discarded */
+    int32_t Finalize(void);
+
+    Statistics GetStatistics(void);
+    void PrintStatistics(void);
+
+private:
+    class Edge {
+    public:
+        Edge() : backpressure(kBackpressureBlock), pushed_num(0), dropped_num(0) {}
+        void Initialize(const EdgeParameter& parameter, bool is_single_producer, bool is_single_consumer);
+        bool TryPush(Frame* frame);
+        bool TryPop(Frame*& frame);
+        Frame* Post(Frame* frame) { return mailbox_->Post(frame); }     // kBackpressureLatest only. Returns the dropped frame
+        int32_t Size() const;
+
+    public:
+        int32_t backpressure;
+        std::atomic<int64_t> pushed_num;
+        std::atomic<int64_t> dropped_num;
+
+    private:
+        std::unique_ptr<InferenceHelperQueue::SpscQueue<Frame*>> spsc_queue_;  // used if single producer, single consumer and the producer doesn't pop
+        std::unique_ptr<InferenceHelperQueue::MpmcQueue<Frame*>> mpmc_queue_;
+        std::unique_ptr<InferenceHelperQueue::Mailbox<Frame>>    mailbox_;     // used for kBackpressureLatest
+    };
+
+    void ThreadSource(void);
+    void ThreadPreProcess(void);
+    void ThreadInference(void);
+    void ThreadPostProcess(void);
+    bool Push(Edge& edge, Frame* frame, bool is_drop_allowed = true);
+    bool Pop(Edge& edge, Frame*& frame);
+    void ReleaseFrame(Frame* frame);
+
+private:
+    InferenceHelper* inference_helper_;
+    std::vector<OutputTensorInfo> output_tensor_info_list_;     // used for Process
+    Parameter parameter_;
+    SourceFunction source_;
+    PostProcessFunction post_process_;
+
+    std::vector<std::unique_ptr<Frame>> frame_list_;
+    Frame end_frame_;       // pushed after the last frame (not in frame_list_)
+    std::unique_ptr<InferenceHelperQueue::MpmcQueue<Frame*>> free_frame_queue_;
+    std::unique_ptr<InferenceHelperQueue::MpmcQueue<int32_t>> free_slot_queue_;
+    Edge edge_list_[kEdgeNum];
+
+    std::atomic<int64_t> source_num_;
+    std::atomic<int64_t> post_processed_num_;
+    std::atomic<int64_t> error_num_;
+    std::atomic<bool> is_exit_;
+
+    std::thread thread_source_;
+    std::thread thread_pre_process_;
+    std::thread thread_inference_;
+    std::vector<std::thread> thread_post_process_list_;
+};
+
+#endif
@@ -147,11 +147,15 @@ int32_t InferenceHelperTensorflow::Initialize(const std::string& model_filename,
         output_tensor_list_.emplace_back(nullptr);
     }
 
-    /*** Convert normalize parameter to speed up ***/
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /* Compile pre-process for each input tensor (normalize parameters are converted to speed up) */
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, TF_TensorData(input_tensor_list_[input_tensor_info.id]));
     }
 
+    /* PreProcess runs only the plan, so that it can be pipelined (PreProcessToSlot) */
+    is_pre_process_stageable_ = true;
+
     return kRetOk;
 };
 
@@ -178,58 +182,8 @@ int32_t InferenceHelperTensorflow::Finalize(void)
 
 int32_t InferenceHelperTensorflow::PreProcess(const std::vector<InputTensorInfo>& input_tensor_info_list)
 {
-    for (const auto& input_tensor_info : input_tensor_info_list) {
-        const int32_t img_width = input_tensor_info.GetWidth();
-        const int32_t img_height = input_tensor_info.GetHeight();
-        const int32_t img_channel = input_tensor_info.GetChannel();
-        if (input_tensor_info.data_type == InputTensorInfo::kDataTypeImage) {
-            if ((input_tensor_info.image_info.width != input_tensor_info.image_info.crop_width) || (input_tensor_info.image_info.height != input_tensor_info.image_info.crop_height)) {
-                PRINT_E("Crop is not supported\n");
-                return  kRetErr;
-            }
-            if ((input_tensor_info.image_info.crop_width != img_width) || (input_tensor_info.image_info.crop_height != img_height)) {
-                PRINT_E("Resize is not supported\n");
-                return  kRetErr;
-            }
-            if (input_tensor_info.image_info.channel != img_channel) {
-                PRINT_E("Color conversion is not supported\n");
-                return  kRetErr;
-            }
-
-            /* Normalize image */
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = static_cast<float*>(TF_TensorData(input_tensor_list_[input_tensor_info.id]));
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8) {
-                uint8_t* dst = static_cast<uint8_t*>(TF_TensorData(input_tensor_list_[input_tensor_info.id]));
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                int8_t* dst = static_cast<int8_t*>(TF_TensorData(input_tensor_list_[input_tensor_info.id]));
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else if ((input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) || (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw)) {
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = static_cast<float*>(TF_TensorData(input_tensor_list_[input_tensor_info.id]));
-                PreProcessBlob<float>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8 || input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                uint8_t* dst = static_cast<uint8_t*>(TF_TensorData(input_tensor_list_[input_tensor_info.id]));
-                PreProcessBlob<uint8_t>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt32) {
-                int32_t* dst = static_cast<int32_t*>(TF_TensorData(input_tensor_list_[input_tensor_info.id]));
-                PreProcessBlob<int32_t>(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else {
-            PRINT_E("Unsupported data_type (%d)\n", input_tensor_info.data_type);
-            return kRetErr;
-        }
-    }
-    return kRetOk;
+    /* Crop, resize, color conversion and normalize (image), or copy (blob) by the plan compiled at Initialize */
+    return RunPreProcessPlan(num_threads_, input_tensor_info_list);
 }
 
 int32_t InferenceHelperTensorflow::Process(std::vector<OutputTensorInfo>& output_tensor_info_list)
@@ -297,5 +251,9 @@ int32_t InferenceHelperTensorflow::Process(std::vector<OutputTensorInfo>& output
         output_tensor_info.data = TF_TensorData(output_tensor);
     }
 
+    if (ConvertOutputLayout(num_threads_, false, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
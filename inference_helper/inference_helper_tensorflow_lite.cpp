@@ -84,16 +84,12 @@ int32_t InferenceHelperTensorflowLite::Initialize(const std::string& model_filen
 #if 0
     model_ = tflite::FlatBufferModel::BuildFromFile(model_filename.c_str());
 #else
-    std::ifstream ifs(model_filename, std::ios::binary);
-    if (ifs) {
-        ifs >> std::noskipws;
-        (void)std::copy(std::istream_iterator<char>(ifs), std::istream_iterator<char>(), back_inserter(model_buffer_));
-    } else {
-        PRINT_E("Failed to read model (%s)\n", model_filename.c_str());
+    /* Constant tensors refer to the model bytes, so they are shared by the instances of the same model */
+    model_buffer_ = LoadModelBuffer(model_filename);
+    if (!model_buffer_) {
         return kRetErr;
     }
-    ifs.close();
-    model_ = tflite::FlatBufferModel::BuildFromBuffer(model_buffer_.data(), model_buffer_.size());
+    model_ = tflite::FlatBufferModel::BuildFromBuffer(model_buffer_->data(), model_buffer_->size());
 #endif
 
     if (model_ == nullptr) {
@@ -191,20 +187,25 @@ int32_t InferenceHelperTensorflowLite::Initialize(const std::string& model_filen
         }
     }
 
-    /* Convert normalize parameter to speed up */
-    for (auto& input_tensor_info : input_tensor_info_list) {
-        ConvertNormalizeParameters(input_tensor_info);
+    /* Compile pre-process for each input tensor (normalize parameters are converted to speed up) */
+    pre_process_plan_list_.clear();
+    for (const auto& input_tensor_info : input_tensor_info_list) {
+        CreatePreProcessPlan(input_tensor_info, interpreter_->tensor(input_tensor_info.id)->data.raw);
     }
 
+    /* PreProcess runs only the plan, so that it can be pipelined (PreProcessToSlot) */
+    is_pre_process_stageable_ = true;
+
     return kRetOk;
 };
 
 
 int32_t InferenceHelperTensorflowLite::Finalize(void)
 {
+    interpreter_.reset();
     model_.reset();
+    model_buffer_.reset();
     resolver_.reset();
-    interpreter_.reset();
 
 #ifdef INFERENCE_HELPER_ENABLE_TFLITE_DELEGATE_EDGETPU
     if (helper_type_ == kTensorflowLiteEdgetpu) {
@@ -236,58 +237,8 @@ int32_t InferenceHelperTensorflowLite::PreProcess(const std::vector<InputTensorI
         return kRetErr;
     }
 
-    for (const auto& input_tensor_info : input_tensor_info_list) {
-        const int32_t img_width = input_tensor_info.GetWidth();
-        const int32_t img_height = input_tensor_info.GetHeight();
-        const int32_t img_channel = input_tensor_info.GetChannel();
-        if (input_tensor_info.data_type == InputTensorInfo::kDataTypeImage) {
-            if ((input_tensor_info.image_info.width != input_tensor_info.image_info.crop_width) || (input_tensor_info.image_info.height != input_tensor_info.image_info.crop_height)) {
-                PRINT_E("Crop is not supported\n");
-                return  kRetErr;
-            }
-            if ((input_tensor_info.image_info.crop_width != img_width) || (input_tensor_info.image_info.crop_height != img_height)) {
-                PRINT_E("Resize is not supported\n");
-                return  kRetErr;
-            }
-            if (input_tensor_info.image_info.channel != img_channel) {
-                PRINT_E("Color conversion is not supported\n");
-                return  kRetErr;
-            }
-
-            /* Normalize image */
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = interpreter_->typed_tensor<float>(input_tensor_info.id);
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8) {
-                uint8_t* dst = interpreter_->typed_tensor<uint8_t>(input_tensor_info.id);
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                int8_t* dst = interpreter_->typed_tensor<int8_t>(input_tensor_info.id);
-                PreProcessImage(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else if ((input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNhwc) || (input_tensor_info.data_type == InputTensorInfo::kDataTypeBlobNchw)) {
-            if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeFp32) {
-                float* dst = interpreter_->typed_tensor<float>(input_tensor_info.id);
-                PreProcessBlob<float>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeUint8 || input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt8) {
-                uint8_t* dst = interpreter_->typed_tensor<uint8_t>(input_tensor_info.id);
-                PreProcessBlob<uint8_t>(num_threads_, input_tensor_info, dst);
-            } else if (input_tensor_info.tensor_type == TensorInfo::kTensorTypeInt32) {
-                int32_t* dst = interpreter_->typed_tensor<int32_t>(input_tensor_info.id);
-                PreProcessBlob<int32_t>(num_threads_, input_tensor_info, dst);
-            } else {
-                PRINT_E("Unsupported tensor_type (%d)\n", input_tensor_info.tensor_type);
-                return kRetErr;
-            }
-        } else {
-            PRINT_E("Unsupported data_type (%d)\n", input_tensor_info.data_type);
-            return kRetErr;
-        }
-    }
-    return kRetOk;
+    /* Crop, resize, color conversion and normalize (image), or copy (blob) by the plan compiled at Initialize */
+    return RunPreProcessPlan(num_threads_, input_tensor_info_list);
 }
 
 int32_t InferenceHelperTensorflowLite::Process(std::vector<OutputTensorInfo>& output_tensor_info_list)
@@ -296,6 +247,10 @@ int32_t InferenceHelperTensorflowLite::Process(std::vector<OutputTensorInfo>& ou
         PRINT_E("Failed to invoke\n");
         return kRetErr;
     }
+    if (ConvertOutputLayout(num_threads_, false, output_tensor_info_list) != kRetOk) {
+        return kRetErr;
+    }
+    IncrementOutputGeneration(output_tensor_info_list);
     return kRetOk;
 }
 
@@ -393,6 +348,36 @@ int32_t InferenceHelperTensorflowLite::GetInputTensorInfo(InputTensorInfo& tenso
             if (tensor->type == kTfLiteFloat32) tensor_info.tensor_type = TensorInfo::kTensorTypeFp32;
             if (tensor->type == kTfLiteInt32) tensor_info.tensor_type = TensorInfo::kTensorTypeInt32;
             if (tensor->type == kTfLiteInt64) tensor_info.tensor_type = TensorInfo::kTensorTypeInt64;
+            if (tensor->type == kTfLiteFloat16) tensor_info.tensor_type = TensorInfo::kTensorTypeFp16;
+
+            /* Quantization parameters (per tensor or per channel) */
+            if (tensor->type == kTfLiteUInt8 || tensor->type == kTfLiteInt8) {
+                for (int32_t c = 0; c < 3; c++) {
+                    tensor_info.quant.scale[c] = tensor->params.scale;
+                    tensor_info.quant.zero_point[c] = tensor->params.zero_point;
+                }
+                if (tensor->quantization.type == kTfLiteAffineQuantization && tensor->quantization.params) {
+                    const TfLiteAffineQuantization* quant_params = reinterpret_cast<const TfLiteAffineQuantization*>(tensor->quantization.params);
+                    if (quant_params->scale && quant_params->scale->size > 1 && quant_params->scale->size <= 3 && quant_params->zero_point && quant_params->zero_point->size == quant_params->scale->size) {
+                        /* Per channel table is created only when the tensor is quantized along the channel axis of its layout */
+                        const int32_t channel_axis = tensor_info.is_nchw ? 1 : tensor->dims->size - 1;
+                        if (quant_params->quantized_dimension == channel_axis) {
+                            for (int32_t c = 0; c < quant_params->scale->size; c++) {
+                                tensor_info.quant.scale[c] = quant_params->scale->data[c];
+                                tensor_info.quant.zero_point[c] = quant_params->zero_point->data[c];
+                            }
+                        } else {
+                            PRINT_E("Per axis quantization along a non-channel axis (%d) is not supported for input. Per tensor parameter is used\n", quant_params->quantized_dimension);
+                            if (tensor->params.scale == 0.0f) {
+                                for (int32_t c = 0; c < 3; c++) {
+                                    tensor_info.quant.scale[c] = quant_params->scale->data[0];
+                                    tensor_info.quant.zero_point[c] = quant_params->zero_point->data[0];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
             return kRetOk;
         }
     }
@@ -401,6 +386,22 @@ int32_t InferenceHelperTensorflowLite::GetInputTensorInfo(InputTensorInfo& tenso
     return kRetErr;
 }
 
+/* Set scale and zero point for each channel if the output is quantized per axis */
+static void SetPerAxisQuantization(const TfLiteTensor* tensor, OutputTensorInfo& tensor_info)
+{
+    tensor_info.quant.axis = -1;
+    tensor_info.quant.scale_list.clear();
+    tensor_info.quant.zero_point_list.clear();
+    if (tensor->quantization.type != kTfLiteAffineQuantization || tensor->quantization.params == nullptr) return;
+    const TfLiteAffineQuantization* quant_params = reinterpret_cast<const TfLiteAffineQuantization*>(tensor->quantization.params);
+    if (quant_params->scale == nullptr || quant_params->scale->size <= 1) return;
+    tensor_info.quant.axis = quant_params->quantized_dimension;
+    tensor_info.quant.scale_list.assign(quant_params->scale->data, quant_params->scale->data + quant_params->scale->size);
+    if (quant_params->zero_point && quant_params->zero_point->size == quant_params->scale->size) {
+        tensor_info.quant.zero_point_list.assign(quant_params->zero_point->data, quant_params->zero_point->data + quant_params->zero_point->size);
+    }
+}
+
 int32_t InferenceHelperTensorflowLite::GetOutputTensorInfo(OutputTensorInfo& tensor_info)
 {
     for (auto i : interpreter_->outputs()) {
@@ -418,12 +419,14 @@ int32_t InferenceHelperTensorflowLite::GetOutputTensorInfo(OutputTensorInfo& ten
                 tensor_info.data = interpreter_->typed_tensor<uint8_t>(i);
                 tensor_info.quant.scale = tensor->params.scale;
                 tensor_info.quant.zero_point = tensor->params.zero_point;
+                SetPerAxisQuantization(tensor, tensor_info);
                 break;
             case kTfLiteInt8:
                 tensor_info.tensor_type = TensorInfo::kTensorTypeInt8;
                 tensor_info.data = interpreter_->typed_tensor<int8_t>(i);
                 tensor_info.quant.scale = tensor->params.scale;
                 tensor_info.quant.zero_point = tensor->params.zero_point;
+                SetPerAxisQuantization(tensor, tensor_info);
                 break;
             case kTfLiteFloat32:
                 tensor_info.tensor_type = TensorInfo::kTensorTypeFp32;
@@ -437,6 +440,10 @@ int32_t InferenceHelperTensorflowLite::GetOutputTensorInfo(OutputTensorInfo& ten
                 tensor_info.tensor_type = TensorInfo::kTensorTypeInt64;
                 tensor_info.data = interpreter_->typed_tensor<int64_t>(i);
                 break;
+            case kTfLiteFloat16:
+                tensor_info.tensor_type = TensorInfo::kTensorTypeFp16;
+                tensor_info.data = interpreter_->typed_tensor<TfLiteFloat16>(i);
+                break;
             default:
                 return kRetErr;
             }
@@ -51,7 +51,7 @@ private:
 
 
 private:
-    std::vector<char> model_buffer_;
+    std::shared_ptr<const std::vector<char>> model_buffer_;
     std::unique_ptr<tflite::FlatBufferModel> model_;
     std::unique_ptr<tflite::ops::builtin::BuiltinOpResolver> resolver_;
     std::unique_ptr<tflite::Interpreter> interpreter_;
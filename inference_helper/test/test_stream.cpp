@@ -0,0 +1,285 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+/* for My modules */
+#include "inference_helper.h"
+#include "inference_helper_queue.h"
+#include "inference_helper_stream.h"
+
+/*** Macro ***/
+#define CHECK(cond) do { if (!(cond)) { printf("[FAIL] %s:%d: %s\n", __FILE__, __LINE__, #cond); s_fail_num++; } } while (0)
+
+/*** Global variable ***/
+static int32_t s_fail_num = 0;
+
+/*** Function ***/
+/* Backend for test. Pre-process is staged (blob copy), and Process copies the input to the output after a short sleep */
+class InferenceHelperTest : public InferenceHelper {
+public:
+    int32_t SetNumThreads(const int32_t) override { return kRetOk; }
+    int32_t SetCustomOps(const std::vector<std::pair<const char*, const void*>>&) override { return kRetOk; }
+    int32_t Initialize(const std::string&, std::vector<InputTensorInfo>& input_tensor_info_list, std::vector<OutputTensorInfo>& output_tensor_info_list) override
+    {
+        input_.resize(input_tensor_info_list[0].GetElementNum());
+        output_.resize(input_.size());
+        CreatePreProcessPlan(input_tensor_info_list[0], input_.data());
+        is_pre_process_stageable_ = true;
+        output_tensor_info_list[0].data = output_.data();
+        output_tensor_info_list[0].tensor_dims = input_tensor_info_list[0].tensor_dims;
+        return kRetOk;
+    }
+    int32_t Finalize(void) override { return kRetOk; }
+    int32_t PreProcess(const std::vector<InputTensorInfo>& input_tensor_info_list) override { return RunPreProcessPlan(1, input_tensor_info_list); }
+    int32_t Process(std::vector<OutputTensorInfo>&) override
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        output_ = input_;
+        return kRetOk;
+    }
+
+private:
+    std::vector<float> input_;
+    std::vector<float> output_;
+};
+
+/* Every element pushed by producer_num threads is popped exactly once by consumer_num threads */
+static void TestMpmcQueueStress(int32_t capacity, int32_t producer_num, int32_t consumer_num)
+{
+    static constexpr int64_t kElementNum = 50000;
+    InferenceHelperQueue::MpmcQueue<int64_t> queue(capacity);
+    std::atomic<int64_t> sum(0);
+    std::atomic<int64_t> popped_num(0);
+    std::vector<std::thread> thread_list;
+    for (int32_t p = 0; p < producer_num; p++) {
+        thread_list.push_back(std::thread([&, p] {
+            for (int64_t i = p; i < kElementNum; i += producer_num) {
+                int64_t value = i;
+                while (!queue.TryPush(std::move(value))) std::this_thread::yield();
+            }
+        }));
+    }
+    for (int32_t c = 0; c < consumer_num; c++) {
+        thread_list.push_back(std::thread([&] {
+            int64_t value;
+            while (popped_num < kElementNum) {
+                if (queue.TryPop(value)) {
+                    sum += value;
+                    popped_num++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+    for (auto& thread : thread_list) thread.join();
+    CHECK(popped_num == kElementNum);
+    CHECK(sum == kElementNum * (kElementNum - 1) / 2);
+    CHECK(queue.Size() == 0);
+}
+
+static void TestQueue(void)
+{
+    /* Capacity is exact, including 1 */
+    for (int32_t capacity = 1; capacity <= 2; capacity++) {
+        InferenceHelperQueue::MpmcQueue<int32_t> queue(capacity);
+        int32_t value;
+        for (int32_t lap = 0; lap < 4; lap++) {
+            for (int32_t i = 0; i < capacity; i++) {
+                int32_t v = lap * 10 + i;
+                CHECK(queue.TryPush(std::move(v)));
+            }
+            int32_t extra = -1;
+            CHECK(!queue.TryPush(std::move(extra)));
+            CHECK(queue.Size() == capacity);
+            for (int32_t i = 0; i < capacity; i++) {
+                CHECK(queue.TryPop(value) && value == lap * 10 + i);
+            }
+            CHECK(!queue.TryPop(value));
+        }
+        TestMpmcQueueStress(capacity, 3, 3);
+        TestMpmcQueueStress(capacity, 1, 4);
+        TestMpmcQueueStress(capacity, 4, 1);
+    }
+
+    /* SPSC keeps the order */
+    {
+        static constexpr int32_t kElementNum = 50000;
+        InferenceHelperQueue::SpscQueue<int32_t> queue(1);
+        std::thread producer([&] {
+            for (int32_t i = 0; i < kElementNum; i++) {
+                int32_t value = i;
+                while (!queue.TryPush(std::move(value))) std::this_thread::yield();
+            }
+        });
+        int32_t expected = 0;
+        bool is_in_order = true;
+        while (expected < kElementNum) {
+            int32_t value;
+            if (queue.TryPop(value)) {
+                if (value != expected) is_in_order = false;
+                expected++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        CHECK(is_in_order);
+    }
+
+    /* Mailbox: every posted element is taken or dropped, and taken ones are newer than before */
+    {
+        static constexpr int32_t kElementNum = 50000;
+        InferenceHelperQueue::Mailbox<int32_t> mailbox;
+        std::vector<int32_t> value_list(kElementNum);
+        std::atomic<bool> is_done(false);
+        int64_t returned_num = 0;
+        std::thread producer([&] {
+            for (int32_t i = 0; i < kElementNum; i++) {
+                value_list[i] = i;
+                if (mailbox.Post(&value_list[i])) returned_num++;
+            }
+            is_done = true;
+        });
+        int64_t taken_num = 0;
+        int32_t last = -1;
+        bool is_in_order = true;
+        for (;;) {
+            const int32_t* value = mailbox.Take();
+            if (value) {
+                if (*value <= last) is_in_order = false;
+                last = *value;
+                taken_num++;
+            } else if (is_done && mailbox.IsEmpty()) {
+                break;
+            }
+        }
+        producer.join();
+        CHECK(is_in_order);
+        CHECK(last == kElementNum - 1);
+        CHECK(mailbox.GetPostedNum() == kElementNum);
+        CHECK(taken_num + mailbox.GetDroppedNum() == kElementNum);
+        CHECK(returned_num == mailbox.GetDroppedNum());
+    }
+}
+
+/* Every frame of the source is post-processed with its own output, or counted as dropped */
+static void TestStreamRunner(const char* name, const InferenceHelperStreamRunner::Parameter& parameter)
+{
+    static constexpr int32_t kFrameNum = 300;
+    InferenceHelperTest inference_helper;
+    std::vector<InputTensorInfo> input_tensor_info_list(1, InputTensorInfo("input", TensorInfo::kTensorTypeFp32, true));
+    input_tensor_info_list[0].tensor_dims = { 1, 4 };
+    input_tensor_info_list[0].data_type = InputTensorInfo::kDataTypeBlobNchw;
+    std::vector<OutputTensorInfo> output_tensor_info_list(1, OutputTensorInfo("output", TensorInfo::kTensorTypeFp32));
+    inference_helper.Initialize("", input_tensor_info_list, output_tensor_info_list);
+
+    std::atomic<int32_t> post_processed_num(0);
+    std::atomic<int32_t> mismatch_num(0);
+    std::atomic<int32_t> out_of_order_num(0);
+    std::atomic<int64_t> last_id(-1);
+    std::vector<std::atomic<int32_t>> count_list(kFrameNum);
+    for (auto& count : count_list) count = 0;
+
+    InferenceHelperStreamRunner runner;
+    const int32_t ret = runner.Initialize(&inference_helper, output_tensor_info_list, parameter,
+        [&](InferenceHelperStreamRunner::Frame& frame) {
+            if (frame.id >= kFrameNum) return false;
+            /* Source is a bit faster than Process, so that drop policies drop some frames but not all */
+            std::this_thread::sleep_for(std::chrono::microseconds(150));
+            const float value[4] = { static_cast<float>(frame.id), 1.0f, 2.0f, 3.0f };
+            frame.source_buffer.resize(sizeof(value));
+            std::memcpy(frame.source_buffer.data(), value, sizeof(value));
+            frame.input_tensor_info_list = input_tensor_info_list;
+            frame.input_tensor_info_list[0].data = frame.source_buffer.data();
+            return true;
+        },
+        [&](InferenceHelperStreamRunner::Frame& frame) {
+            const float* output = static_cast<const float*>(frame.output_tensor_info_list[0].data);
+            if (frame.result != InferenceHelper::kRetOk || output[0] != static_cast<float>(frame.id) || output[3] != 3.0f) mismatch_num++;
+            if (frame.id <= last_id) out_of_order_num++;
+            last_id = frame.id;
+            count_list[frame.id]++;
+            post_processed_num++;
+        });
+    CHECK(ret == InferenceHelper::kRetOk);
+    runner.Join();
+
+    const InferenceHelperStreamRunner::Statistics statistics = runner.GetStatistics();
+    int64_t dropped_num = 0;
+    for (const auto& edge : statistics.edge) dropped_num += edge.dropped_num;
+    bool is_once = true;
+    for (const auto& count : count_list) {
+        if (count > 1) is_once = false;
+    }
+    CHECK(statistics.source_num == kFrameNum);
+    CHECK(statistics.post_processed_num == post_processed_num);
+    CHECK(post_processed_num + dropped_num == kFrameNum);
+    CHECK(mismatch_num == 0);
+    CHECK(is_once);
+    if (parameter.post_process_thread_num == 1) CHECK(out_of_order_num == 0);
+    if (parameter.edge[0].backpressure == InferenceHelperStreamRunner::kBackpressureBlock && parameter.edge[1].backpressure == InferenceHelperStreamRunner::kBackpressureBlock
+        && parameter.edge[2].backpressure == InferenceHelperStreamRunner::kBackpressureBlock) {
+        CHECK(dropped_num == 0);
+    }
+    printf("%s: post-processed %d, dropped %lld\n", name, post_processed_num.load(), static_cast<long long>(dropped_num));
+}
+
+static void TestStreamRunner(void)
+{
+    typedef InferenceHelperStreamRunner Runner;
+    static const struct {
+        const char* name;
+        int32_t backpressure;
+    } kPolicyList[] = {
+        { "block", Runner::kBackpressureBlock },
+        { "drop oldest", Runner::kBackpressureDropOldest },
+        { "drop newest", Runner::kBackpressureDropNewest },
+        { "latest", Runner::kBackpressureLatest },
+    };
+    for (const auto& policy : kPolicyList) {
+        for (int32_t capacity = 1; capacity <= 2; capacity++) {
+            for (int32_t post_process_thread_num = 1; post_process_thread_num <= 2; post_process_thread_num++) {
+                Runner::Parameter parameter;
+                for (auto& edge : parameter.edge) {
+                    edge.capacity = capacity;
+                    edge.backpressure = policy.backpressure;
+                }
+                parameter.post_process_thread_num = post_process_thread_num;
+                char name[128];
+                snprintf(name, sizeof(name), "%s (capacity %d, post-process x%d)", policy.name, capacity, post_process_thread_num);
+                TestStreamRunner(name, parameter);
+            }
+        }
+    }
+    TestStreamRunner("real-time", Runner::GetRealTimeParameter());
+}
+
+int main(void)
+{
+    TestQueue();
+    TestStreamRunner();
+    printf("%s (%d failures)\n", s_fail_num == 0 ? "PASSED" : "FAILED", s_fail_num);
+    return s_fail_num == 0 ? 0 : 1;
+}